@@ -0,0 +1,66 @@
+#ifndef API_RECORDER_H
+#define API_RECORDER_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+// Captures Web API traffic (api.spotify.com only: token requests carry
+// secrets) to a LittleFS file, so field sessions can be replayed on the host
+// (src/native/replay_main.cpp). Enabled by building with -DAPI_RECORD.
+//
+// The file is a sequence of records, each a header line followed by the raw
+// response body and a newline:
+//
+//   REQ <start ms> <method> <path> <status> <latency ms> <retry-after s>
+//       <body bytes>[ cut]\n<body>\n
+//
+// (one line; latency is up to the response headers; "cut" marks a body
+// that went over BODY_MAX and was stored only up to it). HttpPool feeds it: the
+// body is teed into a PSRAM buffer while the client reads it and written
+// out once the request is closed, from the network task.
+class ApiRecorder : public Print {
+public:
+  static const size_t BODY_MAX = 64 * 1024;   // longer bodies are cut
+  static const size_t FILE_MAX = 1024 * 1024; // recording stops here
+
+  ApiRecorder();
+  // Opens the file for appending; LittleFS must be mounted.
+  bool begin();
+
+  // HttpPool side, one request at a time
+  void start(const char *path);
+  void response(const char *method, int status, unsigned long latencyMs,
+                long retryAfterSec);
+  void finish();
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+
+  // Serial console: prints the file between marker lines / deletes it.
+  // Requests finishing meanwhile are dropped, never waited for.
+  void dump(Print &out);
+  void clear();
+
+private:
+  SemaphoreHandle_t _lock; // file access
+  File _file;
+  uint8_t *_body;
+  size_t _bodyLen;
+  bool _cut; // body longer than BODY_MAX
+
+  char _path[128];
+  char _method[8];
+  int _status;
+  unsigned long _startedAt;
+  unsigned long _latencyMs;
+  long _retryAfterSec;
+
+  size_t _fileBytes;
+  bool _active; // between response() and finish()
+
+  uint32_t _recorded;
+  uint32_t _dropped;
+  bool _full;
+};
+
+#endif
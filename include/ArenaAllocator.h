@@ -0,0 +1,47 @@
+#ifndef ARENA_ALLOCATOR_H
+#define ARENA_ALLOCATOR_H
+
+#include <ArduinoJson.h>
+
+// ArduinoJson allocator over a caller-provided buffer, so parsing a reply
+// does not touch (or fragment) the heap.
+//
+// Blocks are bumped off the front of the buffer; the buffer is reused once
+// every block has been released, i.e. when the JsonDocument is destroyed.
+// The most recent block can grow and shrink in place, which covers how
+// ArduinoJson builds strings and trims its pools. If the arena runs out the
+// request falls back to malloc() and is counted in fallbacks().
+//
+// Not thread-safe: one arena per task.
+class ArenaAllocator : public ArduinoJson::Allocator {
+public:
+  ArenaAllocator(void *buffer, size_t size);
+
+  void *allocate(size_t size) override;
+  void deallocate(void *ptr) override;
+  void *reallocate(void *ptr, size_t newSize) override;
+
+  size_t highWater() const { return _highWater; }
+  uint32_t fallbacks() const { return _fallbacks; }
+
+private:
+  struct Header {
+    size_t size;
+  };
+  static const size_t ALIGN = 8;
+
+  uint8_t *_buf;
+  size_t _size;
+  size_t _used;
+  uint8_t *_last; // most recent live block, or nullptr
+  int _live;
+  size_t _highWater;
+  uint32_t _fallbacks;
+
+  bool owns(void *ptr) const {
+    return (uint8_t *)ptr >= _buf && (uint8_t *)ptr < _buf + _size;
+  }
+  static size_t round(size_t n) { return (n + ALIGN - 1) & ~(ALIGN - 1); }
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef ART_CACHE_H
+#define ART_CACHE_H
+
+#include <Arduino.h>
+
+#include "NowPlaying.h"
+#include "UrlLru.h"
+
+// Byte budget for decoded album art. Each tile is 180x180 RGB565 (~63 KB), so
+// the default keeps the last 32 covers. Override with -DART_CACHE_BUDGET_BYTES.
+#ifndef ART_CACHE_BUDGET_BYTES
+#define ART_CACHE_BUDGET_BYTES (32 * 180 * 180 * 2)
+#endif
+
+// LRU cache of already-scaled album art tiles, keyed by image URL and stored
+// in PSRAM. Pixels are kept in the display's byte order (as produced by an
+// M5Canvas) so a hit is a single pushImage.
+class ArtCache {
+public:
+  static const int TILE_SIZE = 180;
+  static const size_t TILE_BYTES = TILE_SIZE * TILE_SIZE * sizeof(uint16_t);
+
+  explicit ArtCache(size_t budgetBytes = ART_CACHE_BUDGET_BYTES);
+  ~ArtCache();
+
+  // Returns the cached tile and marks it most recently used, or nullptr.
+  const uint16_t *find(const char *url);
+  // find() without touching the LRU order or the hit counters.
+  const uint16_t *peek(const char *url);
+  // Copies a TILE_SIZE x TILE_SIZE tile in, evicting the LRU entry if full.
+  bool insert(const char *url, const uint16_t *pixels);
+
+  size_t capacity() const { return _capacity; }
+  uint32_t hits() const { return _hits; }
+  uint32_t misses() const { return _misses; }
+  uint32_t evictions() const { return _evictions; }
+
+private:
+  UrlLru _slots;
+  uint16_t **_pixels; // per slot, allocated on first use
+  size_t _capacity;
+  uint32_t _hits;
+  uint32_t _misses;
+  uint32_t _evictions;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef ART_PREFETCHER_H
+#define ART_PREFETCHER_H
+
+#include <HTTPClient.h>
+#include <M5Unified.h>
+#include <atomic>
+
+#include "HttpPool.h"
+#include "NowPlaying.h"
+
+// Downloads and decodes album art on its own task into a single PSRAM
+// staging tile, so neither the UI nor the network task waits on the CDN.
+//
+// Three kinds of request, all non-blocking:
+//  - show(): the track on screen has no cached art. Its 64px thumbnail is
+//    staged first, upscaled, as a preview; then the full image replaces it.
+//    A newer show() cancels the one in flight.
+//  - prefetch(): the next track's art, so a track change can be drawn
+//    without waiting. Runs when no show() is pending; a show() interrupts it
+//    and it is resumed afterwards.
+//  - thumbnail(): a 64px cover for the list screen, decoded at `size` px
+//    into the tile's top-left corner. Runs after a pending show() and
+//    before a prefetch(); a newer thumbnail() replaces it.
+// Downloads have connect/read timeouts and each request a deadline.
+//
+// The UI task claims a staged tile with take(). Ownership of the tile moves
+// between the tasks through an atomic state, so the UI never waits.
+class ArtPrefetcher {
+public:
+  explicit ArtPrefetcher(HttpPool &pool);
+  // Allocates the tile and starts the art task pinned to `core`.
+  bool begin(BaseType_t core = 0);
+
+  // Any task. An empty `url` just cancels the current show().
+  void show(const char *url, const char *thumbUrl);
+  void prefetch(const char *url);
+  void thumbnail(const char *url, int size);
+
+  // UI task: if art for `url` is staged, returns its pixels (display byte
+  // order) and keeps the tile locked until release(); `preview` tells the
+  // upscaled thumbnail from the full image. Returns nullptr otherwise.
+  const uint16_t *take(const char *url, bool &preview);
+  void release();
+
+  uint32_t cancelled() const { return _cancelled; }
+  uint32_t failures() const { return _failures; }
+  // True while art is being downloaded or decoded
+  bool busy() const { return _busy.load(std::memory_order_relaxed); }
+
+private:
+  enum State : uint8_t { Empty, Loading, Ready, Reading };
+  enum JobKind : uint8_t { NoJob, ShowJob, ThumbJob, PrefetchJob };
+
+  struct Job {
+    JobKind kind;
+    uint32_t gen; // request generation it was started for
+    int size;     // ThumbJob: px
+    FixedString<TrackInfo::URL_SIZE> url;
+    FixedString<TrackInfo::URL_SIZE> thumbUrl;
+    unsigned long startedAt; // millis()
+  };
+
+  static const uint32_t CONNECT_TIMEOUT_MS = 3000;
+  static const uint16_t READ_TIMEOUT_MS = 2000;
+  static const unsigned long DEADLINE_MS = 10000; // per request, incl. decode
+  static const int THUMB_SIZE = 64;
+  static const uint32_t CLAIM_POLL_MS = 5;
+  static const uint32_t STACK_SIZE = 8 * 1024;
+
+  HttpPool *_pool;
+  M5Canvas _canvas;
+  TaskHandle_t _task;
+
+  // Pending requests; urls under _lock, generations bumped with them
+  portMUX_TYPE _lock;
+  FixedString<TrackInfo::URL_SIZE> _showUrl;
+  FixedString<TrackInfo::URL_SIZE> _showThumbUrl;
+  FixedString<TrackInfo::URL_SIZE> _prefetchUrl;
+  FixedString<TrackInfo::URL_SIZE> _thumbUrl;
+  int _thumbSize;
+  std::atomic<uint32_t> _showGen;
+  std::atomic<uint32_t> _prefetchGen;
+  std::atomic<uint32_t> _thumbGen;
+  std::atomic<bool> _busy;
+
+  // Art task only
+  uint32_t _showDone;     // last show generation started
+  uint32_t _prefetchDone; // last prefetch generation finished
+  uint32_t _thumbDone;    // last thumbnail generation started
+  const Job *_job;        // job being downloaded, for the abort check
+  uint32_t _cancelled;
+  uint32_t _failures;
+
+  // Tile; _url, _preview, _tileKind and _tileGen are written only while the
+  // art task holds Loading
+  std::atomic<uint8_t> _state;
+  FixedString<TrackInfo::URL_SIZE> _url;
+  bool _preview;
+  JobKind _tileKind;
+  uint32_t _tileGen;
+
+  static void taskEntry(void *arg);
+  void run();
+  bool nextJob(Job &job);
+  void runShow(const Job &job);
+  void runPrefetch(const Job &job);
+  void runThumb(const Job &job);
+  bool superseded(const Job &job) const;
+  static bool abortCheck(void *ctx);
+  bool claim(const Job &job);
+  bool download(const Job &job, const char *url, float scale);
+  void publish(const Job &job, bool ok, bool preview);
+  static const char *jobName(JobKind kind);
+};
+
+#endif
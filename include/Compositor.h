@@ -0,0 +1,60 @@
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include <M5Unified.h>
+
+// Off-screen region of the screen (art, text, progress, controls).
+// Drawing happens on the layer's canvas in layer-local coordinates; every
+// draw marks the area it touched so only that part is sent to the panel.
+class Layer {
+public:
+  Layer(int x, int y, int w, int h);
+  bool begin(bool psram);
+
+  M5Canvas &canvas() { return _canvas; }
+  int width() const { return _w; }
+  int height() const { return _h; }
+
+  void markDirty(int x, int y, int w, int h);
+  void markAllDirty() { markDirty(0, 0, _w, _h); }
+
+private:
+  friend class Compositor;
+
+  M5Canvas _canvas;
+  int16_t _x, _y, _w, _h; // position on screen
+  // Bounding box of everything drawn since the last flush (empty if w == 0)
+  int16_t _dirtyX, _dirtyY, _dirtyW, _dirtyH;
+  uint32_t _drawnPixels; // sum of marked areas, i.e. what direct draw costs
+  unsigned long *_frameStart;
+};
+
+// Collects dirty rectangles from its layers and flushes them to the panel in
+// one SPI transaction per frame using DMA, so a frame costs time
+// proportional to what changed and nothing half-drawn is ever visible.
+class Compositor {
+public:
+  static const int MAX_LAYERS = 4;
+
+  Compositor();
+  void addLayer(Layer &layer);
+  void invalidate(); // everything dirty, e.g. after a full-screen message
+
+  // Pushes all dirty regions (call once per loop iteration).
+  void flush();
+
+private:
+  static const uint32_t STATS_INTERVAL = 100; // frames between reports
+
+  Layer *_layers[MAX_LAYERS];
+  int _layerCount;
+  unsigned long _frameStart; // micros() of the first draw this frame, 0 = idle
+
+  uint32_t _frames;
+  unsigned long _frameUsTotal;
+  unsigned long _frameUsMax;
+  uint32_t _bytesPushed;
+  uint32_t _bytesDrawn;
+};
+
+#endif
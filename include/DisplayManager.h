@@ -4,28 +4,113 @@
 #include <HTTPClient.h>
 #include <M5Unified.h>
 
+#include "ArtCache.h"
+#include "ArtPrefetcher.h"
+#include "Compositor.h"
+#include "IconAtlas.h"
+#include "Marquee.h"
+#include "NowPlaying.h"
+#include "PlayerStore.h"
+#include "Telemetry.h"
+#include "TextLayout.h"
+
 class DisplayManager {
 public:
   DisplayManager();
   void begin();
-  void updateNowPlaying(String title, String artist, String albumName,
-                        String albumArtUrl);
-  void updatePlaybackState(bool isPlaying, int progress, int duration);
+  // Optional: album art that is not cached is loaded through it; without
+  // one, only cached art is drawn.
+  void setPrefetcher(ArtPrefetcher *prefetcher) { _prefetcher = prefetcher; }
+  // Subscribes each screen region to the store fields it draws; from then
+  // on a commit redraws exactly the regions whose fields changed.
+  void attach(PlayerStore &store);
+  // Per-frame progress update (the position is extrapolated locally while
+  // playing): only repaints the bar columns that moved.
+  void tickProgress();
+  // The bar shows `ms` instead of the position while a seek is dragged.
+  void previewSeek(int ms);
+  // Per-frame scroll of a title or artist too long for two lines. `paused`
+  // holds it in place (while the network or art task is busy, so they get
+  // the CPU and the PSRAM bus to themselves).
+  void tickMarquee(bool paused);
+  void endSeekPreview();
+  // Volume level shown in place of the track text while it is being
+  // dragged; repaints only when the value changes. hideVolume() brings the
+  // text back.
+  void showVolume(int percent);
+  void hideVolume();
+  // Picks up art loaded since the last call and sends everything drawn to
+  // the panel; call once per loop iteration.
+  void render();
+  // Another screen (the list) has the panel: layers are still drawn and art
+  // still picked up, but nothing is sent until it is uncovered, which
+  // repaints everything.
+  void setCovered(bool covered);
+  // Caches the art saved by the last run (see LastState), so the splash
+  // state committed next draws it at once.
+  void seedArt(const char *url, const uint16_t *artTile);
+  // The cached art tile for `url` (no badge), or nullptr if not loaded.
+  const uint16_t *artTile(const char *url) { return _artCache.peek(url); }
   void showLoading(const char *message);
   void showError(const char *message);
 
-  // Call this if button state changes to redraw specific icons
-  void updateControlState(bool shuffle, const char *repeatMode, bool isLiked);
+#ifdef TEXT_LAYOUT_BENCH
+  // Times the old String-based wrap loop against TextLayout on the device.
+  void benchmarkTextLayout();
+#endif
 
 private:
-  String _lastArtUrl;
-  String _lastTitle;
-  String _lastArtist;
-  bool _lastIsPlaying;
-  bool _lastIsLiked;
-
-  void drawAlbumArt(String url);
-  void drawTextInfo(String title, String artist);
+  PlayerStore *_store;
+  bool _transportDrawn; // prev/next icons drawn
+  int _drawnFillW; // progress bar fill currently on screen, -1 = not drawn
+  int _shownVolume; // volume covering the text layer, -1 = not shown
+  int _seekPreviewMs; // -1: none
+
+  bool _messageShown; // a full-screen message covers the layers
+  bool _covered;      // see setCovered()
+
+  Compositor _compositor;
+  Layer _art;
+  Layer _text;
+  Layer _progress;
+  Layer _controls;
+
+  ArtCache _artCache;
+  ArtPrefetcher *_prefetcher;
+  // Art requested from the prefetcher and not fully shown yet ("" if none)
+  FixedString<TrackInfo::URL_SIZE> _pendingArtUrl;
+  unsigned long _artRequestedAt; // micros()
+  bool _previewShown;
+  uint32_t _prefetchHits;
+  uint32_t _prefetchMisses;
+
+  // Used instead of wrapping when the text doesn't fit in two lines
+  Marquee _titleMarquee;
+  Marquee _artistMarquee;
+
+  GlyphWidthCache _titleWidths;
+  GlyphWidthCache _artistWidths;
+  TextLayout _layout;
+
+  void claimScreen();
+  // Store listeners, one per region
+  static void renderArt(void *ctx, const PlayerState &state, uint16_t changed);
+  static void renderText(void *ctx, const PlayerState &state,
+                         uint16_t changed);
+  static void renderControls(void *ctx, const PlayerState &state,
+                             uint16_t changed);
+  static void renderProgress(void *ctx, const PlayerState &state,
+                             uint16_t changed);
+  void updateProgress(int progress, int duration);
+  void drawAlbumArt(const TrackInfo &track);
+  void pollArt();
+  void showArtTile(const uint16_t *tile);
+  void logArtSource(const char *source, Stage stage, unsigned long start);
+  void drawTextInfo(const char *title, const char *artist);
+  int drawLines(M5Canvas &g, const char *text, int y);
+  bool startMarquee(Marquee &marquee, const char *text,
+                    const lgfx::IFont *font, uint16_t color);
+  void drawIcon(Layer &layer, IconId id, int x, int y);
   void drawControls(bool isPlaying);
   void drawLikeButton(bool isLiked);
 
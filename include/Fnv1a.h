@@ -0,0 +1,31 @@
+#ifndef FNV1A_H
+#define FNV1A_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 32-bit FNV-1a, for cache keys and change detection (not for anything an
+// attacker controls). Start from FNV1A_SEED and feed data in any pieces.
+static const uint32_t FNV1A_SEED = 2166136261u;
+
+inline uint32_t fnv1aByte(uint32_t h, uint8_t byte) {
+  return (h ^ byte) * 16777619u;
+}
+
+inline uint32_t fnv1a(uint32_t h, const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  for (size_t i = 0; i < len; i++) {
+    h = fnv1aByte(h, p[i]);
+  }
+  return h;
+}
+
+// Up to (not including) the NUL
+inline uint32_t fnv1aString(uint32_t h, const char *s) {
+  for (; *s != '\0'; s++) {
+    h = fnv1aByte(h, (uint8_t)*s);
+  }
+  return h;
+}
+
+#endif
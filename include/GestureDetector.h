@@ -0,0 +1,58 @@
+#ifndef GESTURE_DETECTOR_H
+#define GESTURE_DETECTOR_H
+
+#include <stdint.h>
+
+enum class GestureType : uint8_t {
+  None,
+  Tap,       // released quickly without moving
+  LongPress, // held still for LONG_PRESS_MS (the release then reports nothing)
+  DragStart, // moved past SLOP_PX; the drag is locked to one axis from here
+  DragMove,  // position changed during a drag
+  DragEnd,   // released after a slow drag
+  Swipe,     // released after a quick flick; ends the drag like DragEnd
+};
+
+enum class DragAxis : uint8_t { None, Horizontal, Vertical };
+
+struct Gesture {
+  GestureType type = GestureType::None;
+  DragAxis axis = DragAxis::None;
+  int16_t startX = 0, startY = 0; // where the touch went down
+  int16_t x = 0, y = 0;           // latest sample
+  // Swipe: -1 left/up, +1 right/down (along `axis`)
+  int8_t direction = 0;
+};
+
+// Turns raw touch samples into gestures. Samples are taken every
+// SAMPLE_INTERVAL_MS however often update() is called, so thresholds and
+// velocities don't depend on the loop rate, and a drag produces at most one
+// DragMove per sample.
+class GestureDetector {
+public:
+  static const uint32_t SAMPLE_INTERVAL_MS = 16; // ~60 Hz
+  static const int SLOP_PX = 10;                 // movement still a tap
+  static const uint32_t LONG_PRESS_MS = 600;
+  // A drag released within SWIPE_MAX_MS of its start after covering at
+  // least SWIPE_MIN_PX is a swipe.
+  static const uint32_t SWIPE_MAX_MS = 300;
+  static const int SWIPE_MIN_PX = 40;
+
+  GestureDetector();
+
+  // Call every loop iteration with the current touch state. Returns true
+  // and fills `out` when a gesture event happened at this sample.
+  bool update(bool pressed, int x, int y, unsigned long now, Gesture &out);
+
+  bool active() const { return _state != Idle; }
+
+private:
+  enum State : uint8_t { Idle, Pressed, Held, Dragging };
+
+  State _state;
+  unsigned long _lastSampleAt;
+  unsigned long _downAt;
+  Gesture _current;
+};
+
+#endif
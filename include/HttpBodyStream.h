@@ -0,0 +1,52 @@
+#ifndef HTTP_BODY_STREAM_H
+#define HTTP_BODY_STREAM_H
+
+#include <HTTPClient.h>
+
+// Reads exactly one HTTP response body from a kept-alive connection,
+// decoding chunked transfer encoding on the fly. Consumers (ArduinoJson,
+// the JPEG decoder) see only the payload, and drain() leaves the socket
+// positioned at the start of the next response.
+class HttpBodyStream : public Stream {
+public:
+  HttpBodyStream();
+
+  // Binds to the response `http` just received. `hasBody` is false for
+  // 204/304 replies and transport errors.
+  void begin(HTTPClient &http, bool hasBody);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t readBytes(char *buffer, size_t length);
+  size_t write(uint8_t) override { return 0; }
+  void flush() override {}
+
+  // Optional, reset by begin(): polled before each read; returning true ends
+  // the body early, as truncated (so the connection is not reused).
+  void setAbortCheck(bool (*check)(void *ctx), void *ctx);
+  // Optional, reset by begin(): every body byte read (drain() included) is
+  // copied to `tee` as well.
+  void setTee(Print *tee) { _tee = tee; }
+
+  // Discards the rest of the body. Returns false if it could not be read to
+  // the end (the connection must then be closed rather than reused).
+  bool drain();
+
+private:
+  WiFiClient *_client;
+  bool _chunked;
+  bool _untilClose; // no length and not chunked: body ends with the socket
+  bool _done;
+  bool _truncated; // ended early (timeout / disconnect)
+  bool _inChunk;
+  long _remaining; // bytes left in the current chunk / body
+  bool (*_abortCheck)(void *ctx);
+  void *_abortCtx;
+  Print *_tee;
+
+  bool nextChunk();
+  int waitRead();
+};
+
+#endif
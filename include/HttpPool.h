@@ -0,0 +1,73 @@
+#ifndef HTTP_POOL_H
+#define HTTP_POOL_H
+
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+
+#include "ApiRecorder.h"
+#include "HttpBodyStream.h"
+
+// One request's claim on a pooled connection.
+struct HttpLease {
+  bool active = false; // between open() and close()
+  int slot = -1;       // -1: one-off connection owned by the HTTPClient
+  bool reused = false;
+  bool recorded = false; // captured by the ApiRecorder
+  unsigned long startedAt = 0; // micros()
+  HttpBodyStream body; // response payload, valid after HttpPool::send()
+};
+
+// Keeps one long-lived TLS connection per Spotify host so requests reuse it
+// with HTTP/1.1 keep-alive instead of paying a TCP + TLS handshake each time.
+//
+// Usage: open() -> add headers -> send() -> read lease.body -> close().
+// A connection is used by one request at a time; if another task holds it
+// the second request falls back to a one-off connection rather than waiting.
+class HttpPool {
+public:
+  HttpPool();
+  void begin();
+  // Optional: Web API requests are captured from here on.
+  void setRecorder(ApiRecorder *recorder) { _recorder = recorder; }
+
+  // Points `http` at `url`, on the host's pooled connection if it is free.
+  void open(HTTPClient &http, const String &url, HttpLease &lease);
+  // Sends the request and binds lease.body to the response.
+  int send(HTTPClient &http, HttpLease &lease, const char *method,
+           const String &payload = String());
+  // Drains the body, records timing and returns the connection. Connections
+  // that errored or could not be drained are closed so the next request
+  // reconnects. A no-op for leases that were never opened.
+  void close(HTTPClient &http, HttpLease &lease, int httpCode);
+
+  void printStats();
+
+private:
+  struct Connection {
+    const char *host;
+    unsigned long idleTimeout; // close before reuse if idle longer (ms)
+    WiFiClientSecure client;
+    SemaphoreHandle_t lock;
+    unsigned long lastUsed;
+
+    uint32_t handshakes;
+    uint32_t reuses;
+    uint32_t errors;
+    unsigned long handshakeMs; // total request time on fresh connections
+    unsigned long reuseMs;     // total request time on kept-alive ones
+  };
+
+  static const int POOL_SIZE = 3;
+  static const int API_SLOT = 0;
+  static const uint32_t STATS_INTERVAL = 50; // requests between reports
+
+  Connection _conns[POOL_SIZE];
+  uint32_t _oneOffRequests;
+  uint32_t _oneOffMs;
+  uint32_t _requests;
+  ApiRecorder *_recorder;
+
+  int findSlot(const String &url);
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef ICON_ATLAS_H
+#define ICON_ATLAS_H
+
+#include <stdint.h>
+
+enum class IconId : uint8_t {
+  Prev,     // 30x30, on black
+  Next,     // 30x30, on black
+  Play,     // 50x50 white button, on black
+  Pause,    // 50x50 white button, on black
+  Liked,    // 35x35 badge drawn over the album art
+  NotLiked, // 35x35 badge drawn over the album art
+  Count
+};
+
+struct Icon {
+  int16_t width;
+  int16_t height;
+  const uint16_t *pixels; // RGB565, native byte order, row-major
+  bool keyed;             // TRANSPARENT pixels must not be drawn
+};
+
+// UI icons, rasterized at compile time (4x4 supersampled, so edges are
+// anti-aliased against their background) and stored in flash, so drawing
+// one is a single pushImage.
+class IconAtlas {
+public:
+  // Never produced by the icons' own colors
+  static const uint16_t TRANSPARENT = 0xF81F;
+
+  static const Icon &get(IconId id);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef LAST_STATE_H
+#define LAST_STATE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include "NowPlaying.h"
+
+// The last track shown and its album art tile, kept in flash so the next
+// boot can draw it while Wi-Fi is still coming up.
+//
+// Flash writes stall both cores, so save() only copies the tile; step()
+// then writes it CHUNK_BYTES at a time from loop(). The file is written
+// under a temporary name and renamed at the end, so a reset mid-save keeps
+// the previous state.
+class LastState {
+public:
+  LastState();
+  // Mounts the filesystem (formatting it on first use) and allocates the
+  // PSRAM tile buffer.
+  bool begin();
+
+  // The saved track and its art (ArtCache::TILE_SIZE square, display byte
+  // order, valid until the next save()), or nullptr if nothing usable.
+  const uint16_t *load(TrackInfo &track);
+
+  // Starts saving `track` with its art unless a save is already running.
+  bool save(const TrackInfo &track, const uint16_t *tile);
+  // Writes the next chunk of a pending save; cheap when idle.
+  void step();
+
+  bool saving() const { return _file; }
+  // TrackInfo::hash of the last track saved or loaded (0: none)
+  uint32_t savedHash() const { return _savedHash; }
+
+private:
+  static const uint32_t MAGIC = 0x4c535431; // "LST1"
+  static const size_t CHUNK_BYTES = 4096;   // one flash sector
+
+  struct Header {
+    uint32_t magic;
+    uint32_t size; // sizeof(Header), catches layout changes
+    TrackInfo track;
+  };
+
+  uint16_t *_tile;
+  Header _header;
+  File _file;
+  size_t _written; // file bytes written so far
+  unsigned long _saveStartedAt;
+  uint32_t _savedHash;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef LIBRARY_INDEX_H
+#define LIBRARY_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Type-ahead search over the user's saved tracks and playlists, answered
+// from memory without a request.
+//
+// Entries are records (kind, id, title, artist), playlists first, then
+// saved tracks newest first. Text is normalized before it is indexed or
+// compared: case and Latin accents are folded, full-width ASCII and
+// half-width katakana map to their usual forms, katakana folds to
+// hiragana and voiced or small kana to the plain one, so "ｽﾋﾟｯﾂ",
+// "スピッツ" and "すひつつ" all match. Punctuation and spaces separate
+// words.
+//
+// The index hashes every adjacent pair of normalized characters, and the
+// first character of every word, into one of BUCKETS posting lists of
+// entry numbers (delta-coded varints). A query walks the MAX_LISTS
+// shortest lists among its keys together and checks each entry on all of
+// them against the whole query, so collisions cost time, never wrong
+// results. Nothing but the
+// records and these tables is stored, and both are flat byte blocks
+// (built on the device, saved to and loaded from flash as they are).
+class LibraryIndex {
+public:
+  enum Kind : uint8_t { Track, Playlist };
+
+  static const int ID_LEN = 22; // base62 Spotify id
+  // Longer titles and names are cut (at a character boundary) when stored
+  static const size_t TITLE_MAX = 48;
+  static const size_t NAME_MAX = 32;
+  static const size_t RECORD_MAX = 1 + ID_LEN + TITLE_MAX + 1 + NAME_MAX + 1;
+  static const int BUCKETS = 16384; // power of two
+  static const size_t SCRATCH_BYTES =
+      BUCKETS * (sizeof(uint32_t) + sizeof(uint16_t));
+  static const int MAX_ENTRIES = 65534;
+  static const int MAX_QUERY = 32; // normalized characters
+
+  struct Header {
+    uint32_t magic;
+    uint32_t size;         // sizeof(Header), catches layout changes
+    uint32_t entries;      // records
+    uint32_t playlists;    // entries [0, playlists) are playlists
+    uint32_t recordBytes;
+    uint32_t tableBytes;
+    uint32_t trackTotal;   // saved tracks the API reported at the sync
+    uint32_t newestAddedAt; // unix time the newest saved track was added
+    uint32_t fullSyncAt;    // time() when the last full sync finished fetching
+  };
+  static const uint32_t MAGIC = 0x4c495831; // "LIX1"
+
+  LibraryIndex();
+
+  // Writes one record to `out` (RECORD_MAX bytes free); returns its size.
+  static size_t encode(uint8_t *out, Kind kind, const char *id,
+                       const char *title, const char *artist);
+
+  // Building, over `recordBytes` of records: tableBytes() counts entries
+  // and postings into `header` (trackTotal and the times are left alone)
+  // and returns the size of the tables, which buildTables() then fills.
+  // Both take the same SCRATCH_BYTES of scratch, untouched in between (it
+  // carries the posting counts).
+  static size_t tableBytes(const uint8_t *records, size_t recordBytes,
+                           Header &header, void *scratch);
+  static void buildTables(const uint8_t *records, const Header &header,
+                          uint8_t *tables, void *scratch);
+
+  // Checks records and tables read back from flash before they are
+  // attached: every offset and posting list within its block, every entry
+  // number in range. One pass over the tables.
+  static bool valid(const Header &header, const uint8_t *records,
+                    const uint8_t *tables);
+
+  // Serves queries over records and tables built or loaded earlier; neither
+  // is copied. detach() forgets them.
+  void attach(const Header &header, const uint8_t *records,
+              const uint8_t *tables);
+  void detach();
+  bool ready() const { return _records != nullptr; }
+  const Header &header() const { return _header; }
+
+  // Up to `max` entries matching every word of `query` as a prefix (one
+  // character) or substring (more), in entry order. Returns how many;
+  // `checked`, if given, gets the number of entries compared.
+  int search(const char *query, uint16_t *results, int max,
+             uint32_t *checked = nullptr) const;
+
+  int entryCount() const { return _header.entries; }
+  Kind kind(int entry) const;
+  const char *title(int entry) const;
+  const char *artist(int entry) const; // playlists: the owner
+  // Copies the id and a NUL into `out` (ID_LEN + 1 bytes)
+  void id(int entry, char *out) const;
+  uint32_t recordOffset(int entry) const { return _offsets[entry]; }
+  // Bytes of records before the first saved track
+  size_t playlistBytes() const;
+
+  // Folds UTF-8 text as described above into at most `max` characters;
+  // words are separated by a single ' '. Returns the length.
+  static int normalize(const char *utf8, uint16_t *out, int max);
+
+private:
+  Header _header;
+  const uint8_t *_records;
+  const uint32_t *_offsets; // per entry, into _records
+  const uint32_t *_buckets; // BUCKETS + 1 offsets into _postings
+  const uint8_t *_postings;
+
+  static const int MAX_LISTS = 3; // posting lists intersected per query
+
+  bool matches(int entry, const uint16_t *query, int length) const;
+};
+
+#endif
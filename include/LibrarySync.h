@@ -0,0 +1,110 @@
+#ifndef LIBRARY_SYNC_H
+#define LIBRARY_SYNC_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <atomic>
+
+#include "LibraryIndex.h"
+#include "SpotifyClient.h"
+
+// Keeps a LibraryIndex of the user's saved tracks and playlists, synced in
+// the background and kept in flash (/library.idx), so search works from
+// boot without a request.
+//
+// The network task runs it one step at a time between polls (step()): a
+// page of playlists or saved tracks per request, appended as records to
+// /library.new. Saved tracks come newest first (by added_at), so a sync
+// with an index already loaded stops at the newest track it knows and
+// copies the rest over from the index; if the counts then disagree
+// (tracks were removed), and once FULL_SYNC_SEC have passed since the
+// last full sync (dated in the index header, so reboots don't reset it),
+// it fetches everything instead. A sync that found nothing new writes
+// nothing. Otherwise the index is rebuilt in PSRAM and saved CHUNK_BYTES per step,
+// as flash writes stall both cores.
+//
+// The UI holds the index with acquire() while the search screen is open;
+// a rebuild waits for release(), and acquire() fails while one runs.
+class LibrarySync {
+public:
+  explicit LibrarySync(SpotifyClient &client);
+
+  // Before the network task starts, with the filesystem mounted
+  // (LastState::begin()). The saved index is loaded by the first steps.
+  bool begin();
+
+  // Network task: ms until step() has work to do, and that work.
+  uint32_t msUntilStep() const;
+  void step();
+
+  // UI task: the index, or nullptr while there is none or it is being
+  // rebuilt; held until release().
+  const LibraryIndex *acquire();
+  void release();
+  // A sync is fetching or saving
+  bool syncing() const { return _syncing.load(std::memory_order_relaxed); }
+
+private:
+  static const int PAGE_ITEMS = 40; // fits the JSON arena with long titles
+  static const size_t CHUNK_BYTES = 4096;    // one flash sector
+  static const size_t READ_BYTES = 32 * 1024; // per step, loading
+  static const unsigned long SAVE_GAP_MS = 30; // between flash writes
+  static const unsigned long FIRST_SYNC_MS = 30 * 1000UL; // after boot
+  static const unsigned long SYNC_INTERVAL_MS = 6 * 60 * 60 * 1000UL;
+  static const uint32_t FULL_SYNC_SEC = 7 * 24 * 60 * 60;
+  static const unsigned long RETRY_MS = 10 * 1000UL; // a failed page
+  static const int MAX_FAILURES = 3; // in a row, then the sync gives up
+  static const unsigned long ABORT_RETRY_MS = 30 * 60 * 1000UL;
+  static const unsigned long HELD_RETRY_MS = 1000; // rebuild, index held
+
+  enum Phase : uint8_t { Load, Idle, Playlists, Tracks, CopyOld, Build, Save };
+  // Who may touch the index, moved between the tasks like ArtPrefetcher's
+  // tile
+  enum IndexState : uint8_t { IndexNone, IndexReady, IndexReading,
+                              IndexBuilding };
+
+  SpotifyClient *_client;
+  LibraryIndex _index;
+  uint8_t *_records; // PSRAM, as LibraryIndex uses them
+  uint8_t *_tables;
+  std::atomic<uint8_t> _indexState;
+  std::atomic<bool> _syncing;
+
+  // Network task only
+  Phase _phase;
+  unsigned long _nextStepAt;
+  unsigned long _startedAt;
+  File _file;
+  size_t _fileDone; // bytes read or written so far by this phase
+  LibraryIndex::Header _header; // of the index being loaded or built
+  bool _full;
+  int _offset;
+  int _total;
+  int _failures;
+  // Incremental sync: the newest saved track known, and the saved tracks
+  // seen before reaching it
+  char _knownId[LibraryIndex::ID_LEN + 1];
+  uint32_t _knownAddedAt;
+  bool _caughtUp;
+  int _newSeen;
+  uint32_t _newestAddedAt;
+  size_t _playlistBytes; // playlist records written
+  bool _playlistsSame;   // ... identical to the index's so far
+  uint8_t *_page;        // a page of records, PSRAM
+  size_t _pageBytes;
+
+  static void onItem(void *ctx, const LibraryItem &item);
+  bool fullSyncDue() const;
+  void startSync(bool full);
+  void finishFetch();
+  void finish(unsigned long nextSyncMs);
+  void abort(const char *why);
+  void stepLoad();
+  void stepFetch();
+  void stepCopy();
+  void stepBuild();
+  void stepSave();
+  void freeIndex();
+};
+
+#endif
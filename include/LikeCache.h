@@ -0,0 +1,46 @@
+#ifndef LIKE_CACHE_H
+#define LIKE_CACHE_H
+
+#include <stdint.h>
+
+#include "NowPlaying.h"
+
+// Saved ("liked") state per track id, so the heart is right as soon as a
+// track starts instead of after a /me/tracks/contains round trip.
+//
+// Entries expire after TTL_MS because tracks can be saved from other
+// devices; when full, the oldest entry is replaced. Fixed size, no heap,
+// no Arduino dependencies (callers pass the time in).
+class LikeCache {
+public:
+  static const int CAPACITY = 64;
+  static const int ID_SIZE = TrackInfo::ID_SIZE;
+  static const unsigned long TTL_MS = 10 * 60 * 1000UL;
+
+  LikeCache();
+
+  // True and sets `liked` if the id has a fresh entry (counted as a hit).
+  bool lookup(const char *trackId, unsigned long now, bool &liked);
+  // Same without touching the hit/miss counters
+  bool contains(const char *trackId, unsigned long now) const;
+  void store(const char *trackId, bool liked, unsigned long now);
+  void clear();
+
+  uint32_t hits() const { return _hits; }
+  uint32_t misses() const { return _misses; }
+
+private:
+  struct Entry {
+    char id[ID_SIZE]; // empty = unused
+    bool liked;
+    unsigned long storedAt;
+  };
+
+  Entry _entries[CAPACITY];
+  uint32_t _hits;
+  uint32_t _misses;
+
+  int find(const char *trackId) const;
+};
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef LIST_BROWSER_H
+#define LIST_BROWSER_H
+
+#include <M5Unified.h>
+
+#include "ArtPrefetcher.h"
+#include "Compositor.h"
+#include "NetworkTask.h"
+#include "TextLayout.h"
+#include "TrackList.h"
+#include "UrlLru.h"
+
+// LRU cache of list covers, SIZE px square RGB565 in display byte order,
+// keyed by image URL; one PSRAM block.
+class ThumbCache {
+public:
+  static const int SIZE = 40;
+  static const size_t BYTES = SIZE * SIZE * sizeof(uint16_t);
+  static const int SLOTS = 32;
+
+  ThumbCache();
+  bool begin();
+
+  // Marks it most recently used; nullptr if not cached.
+  const uint16_t *find(const char *url);
+  // Copies the SIZE x SIZE top-left corner of an image `stride` px wide,
+  // evicting the LRU entry if full. nullptr caches a placeholder (for
+  // covers that failed to load, so they aren't asked for again).
+  void insert(const char *url, const uint16_t *pixels, int stride);
+
+  size_t bytes() const { return _pixels != nullptr ? SLOTS * BYTES : 0; }
+
+private:
+  UrlLru _slots;
+  uint16_t *_pixels;
+};
+
+// The text of recently shown rows, each drawn once into a 2 bpp sprite
+// (4 palette colors) and kept by row index, LRU.
+class RowCache {
+public:
+  static const int SLOTS = 12; // two screens of rows
+
+  RowCache();
+  bool begin(int w, int h);
+  void clear();
+
+  // Marks it most recently used; nullptr if not cached.
+  M5Canvas *find(int index);
+  // The LRU sprite, now holding `index`, to draw the row into.
+  M5Canvas *claim(int index);
+
+  size_t bytes() const { return _ready ? SLOTS * (size_t)_w * _h / 4 : 0; }
+
+private:
+  M5Canvas _sprites[SLOTS];
+  int _index[SLOTS]; // -1 = free
+  uint32_t _lastUsed[SLOTS];
+  uint32_t _useClock;
+  int _w, _h;
+  bool _ready;
+};
+
+// Full-screen, scrollable list of the queue or of the playlist playing.
+//
+// Only a window of WINDOW_PAGES pages is held (TrackWindow), fetched by the
+// network task a page at a time as the view nears them, so a list of any
+// length costs the same fixed memory. Each row's text is drawn once into a
+// RowCache sprite and blitted from there while scrolling, at most
+// MAX_ROW_RENDERS new rows per frame. Covers load one at a time through the
+// art task once scrolling settles, into a ThumbCache.
+class ListBrowser {
+public:
+  // What a tap does
+  enum Action : uint8_t { NoAction, Close, Switch, Play };
+
+  ListBrowser(NetworkTask &net, ArtPrefetcher &art);
+  bool begin();
+
+  void open(ListSource source);
+  void close() { _open = false; }
+  bool isOpen() const { return _open; }
+  ListSource source() const { return _source; }
+
+  // Touch, in screen coordinates. drag() follows a vertical drag (the first
+  // call starts it); release() lets go, keeping its momentum.
+  void drag(int y);
+  void release();
+  // Header: Close (left) or Switch to the other list (right). A row: Play,
+  // with `row` set. A tap during a fling only stops it.
+  Action tap(int x, int y, int &row);
+
+  // Once per UI frame (FRAME_MS): picks up pages and covers, requests the
+  // next ones, moves a fling on and redraws what scrolled.
+  void tick();
+  // Sends what changed to the panel; call once per loop iteration.
+  void render();
+
+private:
+  static const int FRAME_MS = 33; // tick() rate (main.cpp PROGRESS_FRAME_MS)
+  static const int HEADER_H = 28;
+  static const int ROW_H = 44;
+  static const int THUMB_X = 4;
+  static const int TEXT_X = 50; // row text sprite, on to the screen edge
+  static const int WINDOW_PAGES = 5;
+  static const int MAX_ROW_RENDERS = 2;
+  static const unsigned long PAGE_TIMEOUT_MS = 5000;
+  static const unsigned long PAGE_RETRY_MS = 2000;
+  static const unsigned long THUMB_TIMEOUT_MS = 3000;
+  // px/frame: momentum kept per frame, and the speed below which a fling
+  // stops and covers start loading
+  static constexpr float FLING_DECAY = 0.93f;
+  static constexpr float SETTLED_SPEED = 2.0f;
+
+  NetworkTask *_net;
+  ArtPrefetcher *_art;
+  Compositor _compositor;
+  Layer _header;
+  Layer _list;
+
+  TrackWindow _window;
+  RowCache _rows;
+  ThumbCache _thumbs;
+  GlyphWidthCache _titleWidths;
+  GlyphWidthCache _artistWidths;
+  TextLayout _layout;
+
+  bool _open;
+  ListSource _source;
+  int _status; // of the last page; 204: nothing to list
+  float _scrollY;
+  float _velocity; // px/frame
+  bool _dragging;
+  int _dragLastY;
+  unsigned long _dragLastAt;
+  int _pendingOffset; // page requested, -1 if none
+  unsigned long _pendingAt;
+  unsigned long _retryAt;
+  FixedString<TrackInfo::URL_SIZE> _thumbPending; // "" if none
+  unsigned long _thumbRequestedAt;
+  bool _dirty; // redraw even if nothing scrolled
+  int _drawnTotal;
+
+  int listHeight() const { return _list.height(); }
+  void scrollTo(float y);
+  void takePage();
+  void takeThumb();
+  void requestPage(int first, int last);
+  void requestThumb(int first, int last);
+  void drawHeader();
+  void drawList(int first, int last);
+  void drawMessage(const char *message);
+  bool drawRow(M5Canvas &g, int index, int y, int &renders);
+  M5Canvas *renderRow(int index, const ListRow &row);
+};
+
+#endif
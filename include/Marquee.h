@@ -0,0 +1,51 @@
+#ifndef MARQUEE_H
+#define MARQUEE_H
+
+#include <M5Unified.h>
+
+#include "Compositor.h"
+
+// One line of text too long for its box, scrolled sideways through it.
+//
+// The text is rasterized once, by set(), into a 1-bit strip sprite (the text,
+// then GAP px of background). Each frame copies a window of the strip into
+// the layer, wrapping around, so scrolling never renders a glyph. Every
+// pass starts by holding still for HOLD_FRAMES.
+class Marquee {
+public:
+  static const int MAX_WIDTH = 2048; // strip px; longer text is cut off
+  static const int MAX_HEIGHT = 24;  // fits the 20px font
+  static const int GAP = 40;         // blank px before the text comes round
+  static const int HOLD_FRAMES = 45; // ~1.5 s at the UI's 30 fps
+  static const int STEP_PX = 1;      // per frame
+
+  Marquee();
+  // Allocates the strip (PSRAM). Without it set() always fails.
+  bool begin();
+
+  // Rasterizes `text` for a window `w` px wide and rewinds. False, and
+  // stopped, if the strip is missing or too small for the font.
+  bool set(const char *text, const lgfx::IFont *font, uint16_t fg,
+           uint16_t bg, int w);
+  void stop() { _active = false; }
+  bool active() const { return _active; }
+  int height() const { return _h; }
+
+  // Draws the current window into `layer` at (x, y), which later frames
+  // reuse.
+  void draw(Layer &layer, int x, int y);
+  // Advances one frame and redraws; false (nothing drawn) while holding.
+  bool tick(Layer &layer);
+
+private:
+  M5Canvas _strip;
+  bool _allocated;
+  bool _active;
+  int _period; // text width + GAP
+  int _w, _h;  // window
+  int _x, _y;  // in the layer
+  int _offset; // strip column at the window's left edge
+  int _hold;   // frames left before scrolling on
+};
+
+#endif
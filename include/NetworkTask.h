@@ -0,0 +1,182 @@
+#ifndef NETWORK_TASK_H
+#define NETWORK_TASK_H
+
+#include <Arduino.h>
+#include <atomic>
+
+#include "ArtPrefetcher.h"
+#include "LibrarySync.h"
+#include "PollScheduler.h"
+#include "SnapshotBuffer.h"
+#include "SpotifyClient.h"
+#include "TrackList.h"
+
+// Everything the UI needs to render, as last seen by the network task.
+// Fixed-size and heap-free, so publishing and reading it is a plain copy.
+struct PlayerSnapshot {
+  int status = 0; // HTTP status of the last now-playing poll
+  TrackInfo track;
+  bool isPlaying = false;
+  int progressMs = 0;
+  int volumePercent = -1; // active device, -1 if unknown or not settable
+  bool isLiked = false;
+  bool likeKnown = false; // false until the like state is known
+  // First track in the queue (next.id empty if unknown)
+  TrackInfo next;
+  bool nextIsLiked = false;
+  bool nextLikeKnown = false;
+  uint32_t commandsApplied = 0; // number of commands executed so far
+  uint32_t commandsFailed = 0;  // of those, API calls that failed
+  unsigned long fetchedAt = 0;  // millis() when the poll completed
+};
+
+enum class NetCommandType : uint8_t {
+  Play,
+  Pause,
+  Next,
+  Previous,
+  Like,
+  Unlike,
+  Seek,
+  Volume,
+  Refresh,
+  PlayQueued,     // value: position in the queue
+  PlayInPlaylist, // value: position in the playlist last listed
+  PlayTrack,      // trackId: a saved track (search)
+  PlayPlaylist,   // trackId: a playlist id, from its first track
+  QueuePage,      // value: offset (requestPage() only)
+  PlaylistPage,
+};
+
+struct NetCommand {
+  NetCommandType type;
+  char trackId[32];       // Like/Unlike/PlayTrack/PlayPlaylist only
+  int value;              // Seek: position in ms, Volume: percent, ...
+  unsigned long postedAt; // micros()
+};
+
+// Worker task that owns all Spotify API traffic.
+// The UI task posts commands and picks up state snapshots; it never waits on
+// the network.
+//
+// Commands arriving within COALESCE_MS of each other are merged into the
+// fewest API calls with the same end result: play/pause and like/unlike
+// keep only the final state (nothing is sent if that is the current one),
+// a previous right after a next cancels it, seek and volume keep only the
+// latest value (a skip drops a pending seek, which was meant for the track
+// skipped), playing a listed or searched track replaces any pending skip
+// or seek.
+// The UI applies commands optimistically; a failed call leaves _state
+// unchanged, so the snapshot published afterwards rolls the UI back.
+//
+// List pages for the list screen are fetched on request too, the latest
+// request winning, and handed over through a single staging page. They are
+// not player commands: they don't count in commandsPosted() or trigger a
+// re-poll.
+//
+// Between polls, with time to spare before the next one, the task also runs
+// the library sync (LibrarySync) a step at a time.
+class NetworkTask {
+public:
+  NetworkTask(SpotifyClient &client, ArtPrefetcher &prefetcher);
+
+  // Creates the queue and starts the task pinned to the given core.
+  bool begin(BaseType_t core = 0);
+  // Before begin(); the sync's steps then run on this task
+  void setLibrary(LibrarySync *library) { _library = library; }
+
+  // UI side. post() never blocks; returns false if the queue is full.
+  bool post(NetCommandType type, const char *trackId = nullptr);
+  bool post(NetCommandType type, int value);
+  // Returns true and fills `out` if a new snapshot is available.
+  bool poll(PlayerSnapshot &out);
+
+  // Number of commands successfully posted (compare with
+  // PlayerSnapshot::commandsApplied to tell if a snapshot is stale).
+  uint32_t commandsPosted() const { return _commandsPosted; }
+  // micros() of the latest successful post()
+  unsigned long lastPostedAt() const { return _lastPostedAt; }
+  // True while a poll or a command batch is on the network
+  bool busy() const { return _busy.load(std::memory_order_relaxed); }
+
+  // UI side. Asks for the ListPage::ROWS rows of `source` from `offset` on;
+  // a playlist is the one playing when its first page is requested.
+  bool requestPage(ListSource source, int offset);
+  // The fetched page if one is staged, held until releasePage()
+  const ListPage *takePage();
+  void releasePage();
+private:
+  static const unsigned long COMMAND_SETTLE_MS = 300;
+  static const unsigned long COALESCE_MS = 150;
+  static const unsigned long POLL_REPORT_INTERVAL = 10 * 60 * 1000UL;
+  static const int QUEUE_LENGTH = 8;
+  static const int MAX_UPCOMING = 10; // queued tracks to pre-check likes for
+  static const uint32_t STACK_SIZE = 12 * 1024;
+  // How long a fetched page waits for the UI to take the previous one
+  static const unsigned long PAGE_CLAIM_MS = 500;
+  // Slack a library step needs before the next poll (one page request)
+  static const uint32_t LIBRARY_STEP_MS = 1500;
+
+  SpotifyClient *_client;
+  ArtPrefetcher *_prefetcher;
+  LibrarySync *_library;
+  QueueHandle_t _queue;
+  TaskHandle_t _task;
+  SnapshotBuffer<PlayerSnapshot> _snapshots;
+  uint32_t _commandsPosted;
+  unsigned long _lastPostedAt;
+  std::atomic<bool> _busy;
+
+  // Network-task-only state
+  PlayerSnapshot _state;
+  FixedString<TrackInfo::ID_SIZE> _lastTrackId;
+  bool _likeCheckNeeded;
+  bool _queueCheckNeeded;
+  char _upcoming[MAX_UPCOMING][LikeCache::ID_SIZE];
+  int _upcomingCount;
+  unsigned long _nextPollAt;
+  PollScheduler _scheduler;
+  uint32_t _pollCount;
+  unsigned long _pollReportAt;
+  FixedString<64> _listContext; // playlist being listed
+
+  // Staging page (PSRAM), moved between the tasks like ArtPrefetcher's tile
+  enum PageState : uint8_t { PageEmpty, PageLoading, PageReady, PageReading };
+  ListPage *_page;
+  std::atomic<uint8_t> _pageState;
+
+  // Net effect of a burst of commands
+  struct CommandBatch {
+    uint32_t count = 0;          // commands merged
+    unsigned long firstPostedAt = 0;
+    int8_t playing = -1;         // -1: unchanged, 0: pause, 1: play
+    int previous = 0;            // previous() calls before any skip
+    int skips = 0;               // next() calls
+    int8_t liked = -1;           // -1: unchanged, 0: unlike, 1: like
+    char likeTrackId[32] = "";
+    int seekMs = -1;             // -1: none
+    int volume = -1;             // -1: unchanged
+    int playlistPosition = -1;   // -1: none
+    int8_t playUri = -1;         // -1: none, else a NetCommandType
+    char playId[32] = "";        // ... of this track or playlist
+    int pageSource = -1;         // ListSource of the page to fetch, -1: none
+    int pageOffset = 0;
+  };
+
+  bool send(NetCommand &cmd);
+  static void taskEntry(void *arg);
+  void run();
+  void collect(const NetCommand &first, CommandBatch &batch);
+  void merge(const NetCommand &cmd, CommandBatch &batch);
+  void execute(const CommandBatch &batch);
+  void fetchPage(ListSource source, int offset);
+  bool setLiked(const char *trackId, bool liked);
+  void refreshNowPlaying();
+  void schedulePoll();
+  void refreshQueue();
+  void refreshLikes();
+  void advanceToNext();
+  void publish();
+};
+
+#endif
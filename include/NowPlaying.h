@@ -0,0 +1,79 @@
+#ifndef NOW_PLAYING_H
+#define NOW_PLAYING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// NUL-terminated string with inline storage. Assignment truncates at a
+// UTF-8 character boundary and never allocates, so structs made of these
+// can be copied between tasks with a plain memberwise copy.
+template <size_t N> class FixedString {
+public:
+  FixedString() { clear(); }
+  FixedString(const char *s) { set(s); }
+
+  void clear() {
+    _len = 0;
+    _buf[0] = '\0';
+  }
+  void set(const char *s) {
+    size_t n = s != nullptr ? strnlen(s, N) : 0;
+    if (n > N - 1) {
+      n = N - 1;
+      // Don't cut a multi-byte sequence in half
+      while (n > 0 && ((uint8_t)s[n] & 0xC0) == 0x80) {
+        n--;
+      }
+    }
+    memcpy(_buf, s, n);
+    _buf[n] = '\0';
+    _len = n;
+  }
+  FixedString &operator=(const char *s) {
+    set(s);
+    return *this;
+  }
+
+  const char *c_str() const { return _buf; }
+  size_t length() const { return _len; }
+  bool isEmpty() const { return _len == 0; }
+
+  bool operator==(const char *s) const { return strcmp(_buf, s) == 0; }
+  bool operator!=(const char *s) const { return strcmp(_buf, s) != 0; }
+  template <size_t M> bool operator==(const FixedString<M> &o) const {
+    return _len == o.length() && memcmp(_buf, o.c_str(), _len) == 0;
+  }
+  template <size_t M> bool operator!=(const FixedString<M> &o) const {
+    return !(*this == o);
+  }
+
+private:
+  char _buf[N];
+  uint16_t _len;
+};
+
+// One track as rendered: everything the UI shows about it, in fixed
+// buffers (long titles are cut, never reallocated).
+struct TrackInfo {
+  static const size_t TITLE_SIZE = 192; // ~60 Japanese characters
+  static const size_t NAME_SIZE = 128;
+  static const size_t URL_SIZE = 96; // i.scdn.co URLs are 64 bytes
+  static const size_t ID_SIZE = 23;  // 22-char base62 id + NUL
+
+  FixedString<TITLE_SIZE> title;
+  FixedString<NAME_SIZE> artist;
+  FixedString<NAME_SIZE> albumName;
+  FixedString<URL_SIZE> artUrl;   // ~300px, drawn scaled to 180px
+  FixedString<URL_SIZE> thumbUrl; // 64px, shown upscaled until artUrl loads
+  FixedString<ID_SIZE> id; // empty: no track
+  int durationMs = 0;
+  // FNV-1a of all of the above, kept current by updateHash(); equal hashes
+  // mean nothing to redraw.
+  uint32_t hash = 0;
+
+  void clear();
+  void updateHash();
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef PLAYER_STORE_H
+#define PLAYER_STORE_H
+
+#include <Arduino.h>
+
+#include "NowPlaying.h"
+
+// Everything the UI shows about the player, as one value.
+struct PlayerState {
+  TrackInfo track;
+  bool isPlaying = false;
+  int progressMs = 0;           // at progressAt
+  unsigned long progressAt = 0; // millis()
+  bool isLiked = false;
+  int volumePercent = -1; // -1: can't be set
+  // First track in the queue (next.id empty if unknown)
+  TrackInfo next;
+  bool nextIsLiked = false;
+
+  // Progress extrapolated to `now` while playing
+  int position(unsigned long now) const;
+};
+
+// Versioned store of the UI task's PlayerState, the single place where
+// player state changes.
+//
+// Every update (a server poll, an optimistic command, the boot splash)
+// edits a draft and commits it. commit() diffs the draft against the current
+// state field by field and calls only the listeners subscribed to a field
+// that changed, once, with the whole set of changes. Renderers subscribe to
+// the fields they draw and keep no shadow copies of their own.
+class PlayerStore {
+public:
+  enum Field : uint16_t {
+    Art = 1 << 0,      // track.artUrl, track.thumbUrl
+    Text = 1 << 1,     // track.title, track.artist
+    Track = 1 << 2,    // the rest of track: id, albumName, durationMs
+    Playing = 1 << 3,  // isPlaying
+    Progress = 1 << 4, // position jumped (see PROGRESS_TOLERANCE_MS)
+    Liked = 1 << 5,    // isLiked
+    Volume = 1 << 6,   // volumePercent
+    Next = 1 << 7,     // next, nextIsLiked
+    AllFields = (1 << 8) - 1
+  };
+  static const int FIELD_COUNT = 8;
+
+  enum Source : uint8_t { Poll, Command, Splash, SOURCE_COUNT };
+
+  // `changed` holds only fields the listener subscribed to.
+  typedef void (*Listener)(void *ctx, const PlayerState &state,
+                           uint16_t changed);
+
+  // A poll whose position is within this of the extrapolated one just
+  // re-anchors progress; it isn't reported as a change.
+  static const int PROGRESS_TOLERANCE_MS = 1000;
+
+  PlayerStore();
+
+  // Listeners run in subscription order. False if the table is full.
+  bool subscribe(uint16_t fields, Listener listener, void *ctx);
+
+  const PlayerState &state() const { return _state; }
+  // Incremented by every commit that changed something
+  uint32_t version() const { return _version; }
+
+  // The draft of the next state; the first call after a commit starts it
+  // from state().
+  PlayerState &edit();
+  // Publishes the draft and returns the fields that changed. The first
+  // commit reports every field, as nothing has been drawn yet.
+  uint16_t commit(Source source);
+
+  // Counters since the last report, per hour: commits per source, how many
+  // changed nothing, and changes and listener calls per field.
+  void report(Print &out);
+  // Reports every REPORT_INTERVAL; call from loop().
+  void maybeReport(Print &out);
+
+private:
+  static const int MAX_LISTENERS = 8;
+  static const unsigned long REPORT_INTERVAL = 60 * 60 * 1000UL;
+
+  struct Subscription {
+    uint16_t fields;
+    Listener listener;
+    void *ctx;
+  };
+
+  PlayerState _state;
+  PlayerState _draft;
+  bool _editing;
+  bool _published; // a first commit happened
+  uint32_t _version;
+  Subscription _subs[MAX_LISTENERS];
+  int _subCount;
+
+  uint32_t _commits[SOURCE_COUNT];
+  uint32_t _noopCommits;
+  uint32_t _changes[FIELD_COUNT];
+  uint32_t _calls[FIELD_COUNT]; // listener calls that included the field
+  unsigned long _countersSince;
+
+  uint16_t diff(const PlayerState &from, const PlayerState &to) const;
+};
+
+#endif
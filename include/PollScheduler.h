@@ -0,0 +1,44 @@
+#ifndef POLL_SCHEDULER_H
+#define POLL_SCHEDULER_H
+
+#include <stdint.h>
+
+// Decides when to poll currently_playing next.
+//
+// - Playing: a steady interval, shortened so the poll lands just after the
+//   expected end of the track.
+// - Paused / nothing playing (204) / errors: exponential back-off.
+// - 429: wait at least as long as the server's Retry-After.
+// - A user command resets the back-off (NetworkTask then polls right away).
+//
+// Pure logic with no Arduino dependencies.
+class PollScheduler {
+public:
+  enum Mode : uint8_t { Playing, Paused, Idle, Error, RateLimited };
+
+  PollScheduler();
+
+  // Records a poll result and returns the delay until the next poll (ms).
+  uint32_t onPoll(int status, bool isPlaying, int progressMs, int durationMs,
+                  uint32_t retryAfterMs);
+  void onCommand();
+
+  Mode mode() const { return _mode; }
+  static const char *modeName(Mode mode);
+
+private:
+  static const uint32_t PLAYING_INTERVAL = 5000;
+  static const uint32_t TRACK_END_SLACK = 800; // let Spotify switch tracks
+  static const uint32_t MIN_INTERVAL = 1000;
+  static const uint32_t BACKOFF_BASE = 3000;
+  static const uint32_t PAUSED_MAX = 60000;
+  static const uint32_t IDLE_MAX = 120000;
+  static const uint32_t ERROR_MAX = 60000;
+
+  Mode _mode;
+  uint8_t _streak; // consecutive polls in the current back-off mode
+
+  uint32_t backoff(Mode mode, uint32_t maxDelay);
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef SCREEN_STYLE_H
+#define SCREEN_STYLE_H
+
+#include <M5Unified.h>
+
+// Colors shared by the full-screen views (ListBrowser, SearchScreen)
+static const uint16_t SCREEN_HEADER_BG = 0x18E3;
+static const uint16_t SCREEN_DIM = 0x2104; // rules between rows, placeholders
+
+// GlyphMeasureFn over a LovyanGFX canvas (ctx), in its current font
+inline int measureCanvasGlyph(void *ctx, const char *utf8) {
+  return static_cast<LovyanGFX *>(ctx)->textWidth(utf8);
+}
+
+#endif
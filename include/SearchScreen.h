@@ -0,0 +1,97 @@
+#ifndef SEARCH_SCREEN_H
+#define SEARCH_SCREEN_H
+
+#include <M5Unified.h>
+
+#include "Compositor.h"
+#include "LibrarySync.h"
+#include "TextLayout.h"
+
+// Full-screen type-ahead search over the saved tracks and playlists, with
+// an on-screen keyboard (Latin, digits, kana).
+//
+// Every keystroke queries the LibraryIndex in memory, so results follow
+// the typing without a request. There is no kana-kanji conversion: kanji
+// titles are found by their other words or their artist. The kana page
+// picks a column (あかさ...), then its kana; voiced and small kana need no
+// keys of their own, as the index folds them to the plain one.
+//
+// The index is held (LibrarySync::acquire()) while the screen is open, so
+// a library rebuild waits until it closes.
+class SearchScreen {
+public:
+  // What a tap does
+  enum Action : uint8_t { NoAction, Close, Play };
+
+  explicit SearchScreen(LibrarySync &library);
+  bool begin();
+
+  void open();
+  void close();
+  bool isOpen() const { return _open; }
+
+  // Touch, in screen coordinates. A key types, Back closes, a result is
+  // Play with `id` (LibraryIndex::ID_LEN + 1 bytes) and `playlist` set.
+  Action tap(int x, int y, char *id, bool &playlist);
+  // Held on the delete key: clears the query
+  void longPress(int x, int y);
+  // Vertical drag over the results scrolls them; drag() follows it (the
+  // first call starts it), release() ends it.
+  void drag(int y);
+  void release() { _dragging = false; }
+
+  // Once per UI frame: picks up the index if it wasn't available and
+  // redraws what changed.
+  void tick();
+  // Sends what changed to the panel; call once per loop iteration.
+  void render();
+
+private:
+  static const int HEADER_H = 28;
+  static const int ROW_H = 30;
+  static const int ROWS = 3; // results on screen
+  static const int KEY_H = 30;
+  static const int KEY_W = 32;
+  static const int KEY_ROWS = 3; // above the bottom row
+  static const int KEYS_Y = 240 - (KEY_ROWS + 1) * KEY_H;
+  static const int MAX_RESULTS = 60;
+  static const int QUERY_BYTES = 96;
+
+  enum Page : uint8_t { Latin, Digits, Kana };
+
+  LibrarySync *_library;
+  const LibraryIndex *_index; // held while open, nullptr if unavailable
+  Compositor _compositor;
+  Layer _header;
+  Layer _results;
+  Layer _keys;
+  GlyphWidthCache _titleWidths;
+  GlyphWidthCache _artistWidths;
+  TextLayout _layout;
+
+  bool _open;
+  Page _page;
+  int _kanaColumn;
+  char _query[QUERY_BYTES];
+  size_t _queryLen;
+  uint16_t _hits[MAX_RESULTS];
+  int _hitCount;
+  uint32_t _queryUs; // the last lookup
+  int _scroll;       // first result on screen
+  bool _dragging;
+  int _dragStartY;
+  int _dragStartScroll;
+  bool _resultsDirty;
+  bool _keysDirty;
+
+  const char *keyRow(int row) const;
+  int keyAt(int row, int x, char *label, size_t size) const;
+  void type(const char *text);
+  void erase();
+  void runQuery();
+  void drawHeader();
+  void drawResults();
+  void drawKeys();
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SNAPSHOT_BUFFER_H
+#define SNAPSHOT_BUFFER_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Lock-free single-producer / single-consumer "latest value" channel.
+//
+// Triple buffering: the writer owns one slot, the reader owns another and the
+// third is the hand-off slot exchanged atomically. Neither side ever blocks,
+// and the reader always gets the most recent complete value (intermediate
+// values may be skipped, which is what we want for UI state).
+//
+// The writer must fully overwrite writeSlot() before each publish(); the slot
+// it gets back may hold a value from two generations ago.
+template <typename T> class SnapshotBuffer {
+public:
+  SnapshotBuffer() : _write(0), _read(2), _middle(1) {}
+
+  // Producer side
+  T &writeSlot() { return _slots[_write]; }
+  void publish() {
+    uint8_t prev =
+        _middle.exchange(_write | FRESH_BIT, std::memory_order_acq_rel);
+    _write = prev & INDEX_MASK;
+  }
+
+  // Consumer side. Returns true (and exposes the new value via readSlot())
+  // only if something was published since the last call.
+  bool consume() {
+    if ((_middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0)
+      return false;
+    uint8_t prev = _middle.exchange(_read, std::memory_order_acq_rel);
+    _read = prev & INDEX_MASK;
+    return true;
+  }
+  const T &readSlot() const { return _slots[_read]; }
+
+private:
+  static const uint8_t INDEX_MASK = 0x03;
+  static const uint8_t FRESH_BIT = 0x04;
+
+  T _slots[3];
+  uint8_t _write;               // touched by producer only
+  uint8_t _read;                // touched by consumer only
+  std::atomic<uint8_t> _middle; // hand-off slot index + fresh flag
+};
+
+#endif
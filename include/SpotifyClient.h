@@ -2,38 +2,173 @@
 #define SPOTIFY_CLIENT_H
 
 #include <ArduinoJson.h>
-#include <SpotifyEsp32.h>
+#include <HTTPClient.h>
+
+#include "ArenaAllocator.h"
+#include "HttpPool.h"
+#include "LikeCache.h"
+#include "SpotifyJson.h"
 
 class SpotifyClient {
 public:
-  SpotifyClient(Spotify &spotify, const char *refreshToken);
+  SpotifyClient(HttpPool &pool, const char *clientId,
+                const char *clientSecret, const char *refreshToken);
+
+  // Returned when a response body could not be parsed
+  static const int STATUS_PARSE_ERROR = -100;
+
+  // Restores the access token saved in NVS by a previous run, so a reboot
+  // doesn't cost a refresh before the first request.
+  void begin();
 
   // Auth
+  // Exchanges the refresh token for a short-lived access token and saves it
   bool refreshAccessToken();
+  // Network task, between requests: renews the token in the background
+  // TOKEN_REFRESH_AHEAD_MS before it expires. Returns the ms until it next
+  // has work to do.
+  uint32_t maintainToken();
+
+  // Time left (ms) before the Retry-After of the last 429 expires. Requests
+  // made before then fail locally with 429 instead of hitting the API.
+  uint32_t retryAfterMs() const;
 
   // Player Control
   bool play();
   bool pause();
   bool next();
   bool previous();
+  bool seek(int positionMs);
+  bool setVolume(int percent);
   bool toggleShuffle(bool state);
   bool setRepeatMode(const char *mode); // "track", "context", "off"
+  // Plays `contextUri` (a playlist) from the track at `position`
+  bool playInContext(const char *contextUri, int position);
+  // Plays one track on its own
+  bool playTrack(const char *trackId);
+  // Both update the like cache on success
   bool likeTrack(const char *trackId);
   bool unlikeTrack(const char *trackId);
-  bool getLikeState(const char *trackId, bool &isLiked);
+
+  // Saved state from the like cache; no request is made.
+  bool cachedLikeState(const char *trackId, bool &isLiked);
+  // Looks up every id not already cached in one request (up to
+  // MAX_LIKE_IDS) and caches the results. False if the request failed.
+  bool fetchLikeStates(const char *const *trackIds, int count);
 
   // Data Code
-  // Returns true if data was successfully fetched and parsed
-  int getNowPlaying(String &title, String &artist, String &albumName,
-                    String &albumArtUrl, String &trackId, bool &isPlaying,
-                    int &progressMs, int &durationMs);
+  // Returns 200 if data was successfully fetched and parsed. `track` is
+  // left as is if nothing track-like is playing. `volumePercent` is -1 if
+  // the device's volume can't be controlled. A reply that differs from the
+  // last one only in its position isn't parsed again (see PlayerDigest).
+  int getNowPlaying(TrackInfo &track, bool &isPlaying, int &progressMs,
+                    int &volumePercent);
+  // First track in the upcoming queue. Returns 200, 204 if nothing usable is
+  // queued, or the HTTP error code. The ids of up to `maxUpcoming` queued
+  // tracks go to `upcoming` (for fetchLikeStates()).
+  int getNextInQueue(TrackInfo &next,
+                     char (*upcoming)[LikeCache::ID_SIZE] = nullptr,
+                     int maxUpcoming = 0, int *upcomingCount = nullptr);
+
+  // Lists (see TrackList.h). Fill `page` from `offset` on and return 200,
+  // 204 if there is nothing to list (not playing from a playlist), or the
+  // HTTP error code. The queue is a single page.
+  int getQueuePage(ListPage &page);
+  int getPlaylistPage(const char *playlistUri, int offset, ListPage &page);
+  // The playing context's URI ("spotify:playlist:...") as of the last
+  // now-playing reply; "" if there is none.
+  const char *contextUri() const { return _contextUri.c_str(); }
+
+  // Library (see LibrarySync.h). Calls `fn` for every item of the page of
+  // `limit` items at `offset` (`item.id` null for ones that can't be
+  // played) and sets `total`. Returns 200 or the HTTP error code.
+  typedef void (*LibraryItemFn)(void *ctx, const LibraryItem &item);
+  int getSavedTracksPage(int offset, int limit, int &total, LibraryItemFn fn,
+                         void *ctx);
+  int getPlaylistsPage(int offset, int limit, int &total, LibraryItemFn fn,
+                       void *ctx);
+
+  static const int MAX_LIKE_IDS = 50; // /me/tracks/contains limit
 
 private:
-  Spotify *_spotify;
+  HttpPool *_pool;
+  const char *_clientId;
+  const char *_clientSecret;
   const char *_refreshToken;
 
-  // parsing helper
-  String getLargestImage(JsonArray images, int minWidth);
+  // Tokens last an hour. Renewed well ahead in the background; requests
+  // never go out with less than TOKEN_MIN_VALIDITY_MS left (refreshed
+  // inline instead, which should only happen if the background refresh
+  // kept failing).
+  static const unsigned long TOKEN_REFRESH_AHEAD_MS = 5 * 60 * 1000UL;
+  static const unsigned long TOKEN_MIN_VALIDITY_MS = 60 * 1000UL;
+  static const unsigned long TOKEN_RETRY_MS = 30 * 1000UL;
+  // A saved token whose expiry can't be checked yet (clock not synced)
+  static const unsigned long TOKEN_PROVISIONAL_MS = 2 * 60 * 1000UL;
+
+  String _accessToken;
+  unsigned long _tokenExpiresAt; // millis()
+  unsigned long _tokenRetryAt;   // millis(); after a failed refresh
+  uint32_t _savedExpiry;         // unix time, until the clock is synced
+  unsigned long _rateLimitedUntil;
+  bool ensureAccessToken();
+  void saveToken(unsigned long lifetimeSec);
+  uint32_t tokenOwner() const;
+
+  // Sends an authorized request on the pooled api.spotify.com connection,
+  // retrying once if a kept-alive connection turned out to be dead. The
+  // caller reads lease.body and must call _pool->close().
+  int apiRequest(HTTPClient &http, HttpLease &lease, const char *method,
+                 const String &path, const String &payload = String());
+  // apiRequest() for calls whose body we don't need
+  int apiCommand(const char *method, const String &path,
+                 const String &payload = String());
+
+  // Replies are parsed straight off the socket through these filters, so
+  // only the fields we render are ever allocated, and into _jsonArena
+  // rather than the heap (network task only).
+  static const size_t JSON_ARENA_BYTES = 12 * 1024; // fits a filtered queue
+  uint8_t _jsonArenaBuf[JSON_ARENA_BYTES];
+  ArenaAllocator _jsonArena;
+  JsonDocument _nowPlayingFilter;
+  JsonDocument _queueFilter;
+  JsonDocument _playlistPageFilter;
+  JsonDocument _savedTracksFilter;
+  JsonDocument _playlistsFilter;
+  int getLibraryPage(const String &path, const JsonDocument &filter,
+                     bool savedTracks, int &total, LibraryItemFn fn,
+                     void *ctx);
+
+  // /me/player replies are read whole into _body (PSRAM) while _digest
+  // hashes them. One that digests like the last parsed reply only moved the
+  // position: the _parsed* values are returned with its progress_ms, and
+  // the parse is skipped. Replies that don't fit are parsed as before.
+  static const size_t BODY_BYTES = 24 * 1024;
+  char *_body;
+  PlayerDigest _digest;
+  bool _parsedHasTrack;
+  TrackInfo _parsedTrack;
+  bool _parsedPlaying;
+  int _parsedVolume;
+  FixedString<64> _contextUri;
+
+  LikeCache _likes;
+  uint32_t _likeCalls;      // /me/tracks/contains requests
+  uint32_t _likeIdsFetched; // ids resolved by those requests
+
+  // Parse cost, reported every PARSE_REPORT_INTERVAL polls
+  static const uint32_t PARSE_REPORT_INTERVAL = 20;
+  uint32_t _parseCount;
+  unsigned long _parseTotalUs;
+  unsigned long _parseMaxUs;
+  uint32_t _parseMaxHeap;
+  unsigned long _parseAvgUs; // of the last report, while every poll skips
+  uint32_t _skipCount;       // polls whose parse was skipped
+  unsigned long _digestTotalUs;
+  void recordParse(unsigned long digestUs, unsigned long us,
+                   uint32_t heapBytes);
+  void recordSkip(unsigned long digestUs);
+  void reportParse();
 };
 
 #endif
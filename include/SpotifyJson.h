@@ -0,0 +1,113 @@
+#ifndef SPOTIFY_JSON_H
+#define SPOTIFY_JSON_H
+
+#include <ArduinoJson.h>
+
+#include "NowPlaying.h"
+#include "TrackList.h"
+
+// The parts of the Spotify Web API schema we read, kept free of Arduino and
+// network code so the native benchmark parses exactly what the device does.
+
+// A track object's rendered fields. Strings point into the JsonDocument they
+// were read from (never null) and are valid as long as it is.
+struct TrackFields {
+  const char *title;
+  const char *artist;
+  const char *albumName;
+  const char *albumArtUrl;
+  const char *thumbUrl; // smallest image, "" if there is only one
+  const char *trackId;
+  int durationMs;
+};
+
+// A saved track or playlist as the library index stores it (see
+// LibraryIndex.h). Strings point into the JsonDocument, like TrackFields.
+struct LibraryItem {
+  const char *id;
+  const char *title;
+  const char *artist;  // playlists: the owner's name
+  uint32_t addedAt;    // saved tracks: unix time, 0 for playlists
+};
+
+// Deserialization filters for /me/player, /me/player/queue and a page of
+// /playlists/{id}/tracks: only the fields in TrackFields (and the device
+// volume and playing context) are ever allocated. The library ones, for a
+// page of /me/tracks and of /me/playlists, keep only LibraryItem's.
+void buildNowPlayingFilter(JsonDocument &filter);
+void buildQueueFilter(JsonDocument &filter);
+void buildPlaylistPageFilter(JsonDocument &filter);
+void buildSavedTracksFilter(JsonDocument &filter);
+void buildPlaylistsFilter(JsonDocument &filter);
+
+// False for episodes and other items without usable album art.
+bool isTrack(JsonObjectConst item);
+void readTrack(JsonObjectConst item, TrackFields &out);
+// Copies the fields into fixed buffers and updates the hash.
+void readTrack(JsonObjectConst item, TrackInfo &out);
+// The device's volume_percent, or -1 if it is missing or not settable.
+int readVolume(JsonObjectConst device);
+// A track object (null for unavailable tracks) as a list row.
+void readRow(JsonObjectConst item, ListRow &out);
+// Items of the library pages; false (id null, addedAt still read) for ones
+// that can't be played: local files, tracks gone from the catalog.
+bool readSavedTrack(JsonObjectConst item, LibraryItem &out);
+bool readPlaylist(JsonObjectConst item, LibraryItem &out);
+// An API timestamp ("2024-05-01T12:34:56Z") as unix time; 0 if malformed.
+uint32_t parseIsoTime(const char *s);
+
+// FNV-1a over a /me/player reply, fed in chunks of any size as it arrives,
+// that leaves out the values of the fields which advance on every poll
+// (progress_ms, timestamp). Two replies digest equal exactly when nothing
+// but the position moved, so the second one needn't be parsed: its
+// progress_ms is picked up on the way.
+//
+// It also remembers the digest of the last reply parsed, so SpotifyClient
+// and the host replay make the same skip decision: reset(), update() with
+// the reply, then unchanged() says whether the last parse still holds;
+// after parsing, parsed() records the reply (or a failed parse).
+class PlayerDigest {
+public:
+  PlayerDigest() {
+    _parsedValid = false;
+    _parsedHash = 0;
+    reset();
+  }
+
+  // Starts a new reply; the last parsed one is kept
+  void reset();
+  void update(const char *data, size_t len);
+
+  uint32_t hash() const { return _hash; }
+  // The top-level progress_ms, -1 if the reply had none
+  long progressMs() const { return _progressMs; }
+
+  // The reply digested like the last one parsed and has a position: only
+  // that moved
+  bool unchanged() const {
+    return _parsedValid && _hash == _parsedHash && _progressMs >= 0;
+  }
+  // After parsing this reply; `valid` false (a parse error, or a reply not
+  // read whole) makes the next one parse again
+  void parsed(bool valid) {
+    _parsedValid = valid;
+    _parsedHash = _hash;
+  }
+
+private:
+  static const size_t KEY_SIZE = 12; // longest skipped key + NUL
+
+  bool _parsedValid;
+  uint32_t _parsedHash;
+  uint32_t _hash;
+  long _progressMs;
+  int _depth; // object/array nesting
+  bool _inString;
+  bool _escaped;
+  char _key[KEY_SIZE]; // last string, if short enough to be a skipped key
+  size_t _keyLen;
+  uint8_t _skipping; // 0, or which value (SKIP_*) is being left out
+  bool _valueStarted;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+
+// Timed stages of a poll cycle, art/text rendering and user commands.
+enum class Stage : uint8_t {
+  Poll,         // whole now-playing refresh incl. like check
+  HttpFresh,    // request until response headers, new TLS connection
+  HttpReused,   // same, on a kept-alive connection
+  Parse,        // currently_playing JSON parse
+  ArtPreview,   // album art miss -> upscaled thumbnail on screen
+  ArtDownload,  // album art miss -> full image on screen
+  ArtLocal,     // album art from the cache or the prefetcher
+  TextLayout,   // title/artist layout and drawing
+  Marquee,      // one scrolled frame of the long title/artist
+  ListFrame,    // one frame of the list screen
+  SearchQuery,  // one type-ahead lookup in the library index
+  Frame,        // first draw to end of the compositor flush
+  CommandAck,   // command posted -> Spotify API replied
+  CommandShown, // command posted -> confirmed state pushed to the panel
+  Count
+};
+
+// Always-on tracing: fixed-size log2 histograms of stage durations plus
+// heap and stack watermarks, dumped on request over serial.
+//
+// record() is safe from any task and costs a short critical section; all
+// storage is static so nothing is allocated at runtime.
+class Telemetry {
+public:
+  static void record(Stage stage, uint32_t us);
+  // Includes the task in the stack high-water report (up to MAX_TASKS).
+  static void registerTask(const char *name, TaskHandle_t task);
+
+  // Writes one "[telemetry] key=value ..." line per stage, heap and task.
+  static void dump(Print &out);
+  static void reset();
+
+  static const char *stageName(Stage stage);
+
+private:
+  static const int BUCKETS = 24; // bucket i: < 2^i us; the last one is open
+  static const int MAX_TASKS = 4;
+
+  struct Histogram {
+    uint32_t count;
+    uint32_t maxUs;
+    uint64_t totalUs;
+    uint32_t buckets[BUCKETS];
+  };
+
+  static portMUX_TYPE _lock;
+  static Histogram _stages[(int)Stage::Count];
+  static const char *_taskNames[MAX_TASKS];
+  static TaskHandle_t _tasks[MAX_TASKS];
+  static int _taskCount;
+
+  static uint32_t percentile(const Histogram &h, uint32_t permille);
+};
+
+// Records the lifetime of a scope as one sample of `stage`.
+class StageTimer {
+public:
+  explicit StageTimer(Stage stage) {
+    _stage = stage;
+    _start = micros();
+  }
+  ~StageTimer() { Telemetry::record(_stage, micros() - _start); }
+
+private:
+  Stage _stage;
+  unsigned long _start;
+};
+
+#endif
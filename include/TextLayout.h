@@ -0,0 +1,84 @@
+#ifndef TEXT_LAYOUT_H
+#define TEXT_LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Measures one glyph given as a NUL-terminated UTF-8 sequence (e.g. a
+// wrapper around LovyanGFX::textWidth()).
+typedef int (*GlyphMeasureFn)(void *ctx, const char *utf8);
+
+// Per-font table of glyph advances, filled lazily. Fixed size, no heap.
+class GlyphWidthCache {
+public:
+  GlyphWidthCache();
+  void begin(GlyphMeasureFn measure, void *ctx);
+
+  int width(uint32_t codepoint, const char *utf8, uint8_t len);
+
+  uint32_t hits() const { return _hits; }
+  uint32_t misses() const { return _misses; }
+
+private:
+  static const int SLOTS = 256; // power of two
+
+  GlyphMeasureFn _measure;
+  void *_ctx;
+  uint32_t _keys[SLOTS]; // codepoint, 0 = empty
+  uint8_t _widths[SLOTS];
+  uint32_t _hits;
+  uint32_t _misses;
+};
+
+struct TextLine {
+  uint16_t start;  // byte offset into the source string
+  uint16_t length; // bytes
+  uint16_t width;  // pixels, including the ellipsis
+  bool ellipsis;   // text continues; draw "…" after this line
+};
+
+// Wraps a UTF-8 string into at most N lines of a given pixel width.
+//
+// The string is decoded once and every glyph advance comes from the width
+// cache, so layout is linear in the string length and allocates nothing.
+// Latin words are kept whole where possible; Japanese text breaks between
+// any two characters except where kinsoku rules forbid it (no closing
+// brackets / small kana / punctuation at line start, no opening bracket at
+// line end). Overflow on the last line is cut with an ellipsis.
+class TextLayout {
+public:
+  static const int MAX_LINES = 4;
+  static const int MAX_GLYPHS = 192;
+  static const char *ELLIPSIS; // "…"
+  // A line of text with its ellipsis and NUL, at most
+  static const size_t LINE_BYTES = MAX_GLYPHS * 4 + 4;
+
+  int layout(const char *text, GlyphWidthCache &widths, int maxWidth,
+             int maxLines);
+
+  int lineCount() const { return _lineCount; }
+  const TextLine &line(int i) const { return _lines[i]; }
+  // Line i of the last layout() of `text`, ellipsis included, into `out`
+  // (LINE_BYTES)
+  void copyLine(const char *text, int i, char *out) const;
+  // `text` laid out on one line and copied into `out` (LINE_BYTES), cut
+  // with an ellipsis if it doesn't fit; returns `out`.
+  const char *fitLine(const char *text, GlyphWidthCache &widths, int maxWidth,
+                      char *out);
+
+  static bool noLineStart(uint32_t cp);
+  static bool noLineEnd(uint32_t cp);
+
+private:
+  uint32_t _cps[MAX_GLYPHS];
+  uint16_t _offsets[MAX_GLYPHS + 1];
+  uint8_t _adv[MAX_GLYPHS];
+  TextLine _lines[MAX_LINES];
+  int _lineCount;
+
+  int decode(const char *text, GlyphWidthCache &widths);
+  int spanWidth(int from, int to) const;
+  void addLine(int from, int to, bool ellipsis, int ellipsisWidth);
+};
+
+#endif
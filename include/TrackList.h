@@ -0,0 +1,67 @@
+#ifndef TRACK_LIST_H
+#define TRACK_LIST_H
+
+#include "NowPlaying.h"
+
+// What the list screen browses
+enum class ListSource : uint8_t { Queue, Playlist };
+
+// One track as a list row: a single line of title and of artist.
+struct ListRow {
+  static const size_t TITLE_SIZE = 96; // more than a 16px line holds
+  static const size_t NAME_SIZE = 64;
+
+  FixedString<TITLE_SIZE> title;
+  FixedString<NAME_SIZE> artist;
+  FixedString<TrackInfo::URL_SIZE> thumbUrl; // 64px cover, "" if none
+};
+
+// ROWS consecutive rows of a list, as fetched in one request.
+struct ListPage {
+  static const int ROWS = 20;
+
+  ListSource source = ListSource::Queue;
+  int status = 0; // HTTP status; rows are only valid with 200
+  int offset = 0; // index of rows[0] in the whole list
+  int count = 0;  // rows filled
+  int total = 0;  // rows in the whole list
+  ListRow rows[ROWS];
+};
+
+// A bounded window onto a list of any length: up to `count` pages, the one
+// farthest from where the user is looking evicted to make room. Storage is
+// the caller's (PSRAM on the device), so the memory used doesn't depend on
+// the list's length.
+class TrackWindow {
+public:
+  TrackWindow();
+  void begin(ListPage *slots, int count);
+
+  // Forgets every page (another list, or the same one reopened)
+  void reset();
+  // Rows in the whole list; -1 until the first page arrives
+  int total() const { return _total; }
+
+  // Copies `page` in; `focus` is the row the user is looking at.
+  void insert(const ListPage &page, int focus);
+  // The row, or nullptr if its page isn't in the window
+  const ListRow *row(int index) const;
+  // Offset of the page to fetch next for a view of rows [first, last]:
+  // the visible pages, then a page of margin below and above. -1 if they
+  // are all in the window.
+  int wanted(int first, int last) const;
+
+  size_t bytes() const { return _count * sizeof(ListPage); }
+
+private:
+  ListPage *_slots; // offset -1: free
+  int _count;
+  int _total;
+
+  // The slot holding the page at `offset`, -1 if none
+  int indexOf(int offset) const;
+  const ListPage *find(int offset) const;
+  ListPage *find(int offset);
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef URL_LRU_H
+#define URL_LRU_H
+
+#include "NowPlaying.h"
+
+// Slot bookkeeping for caches keyed by image URL (ArtCache, ThumbCache):
+// which slot holds a URL, and which one to reuse when all are taken (the
+// least recently used). The caches keep their data per slot number.
+class UrlLru {
+public:
+  UrlLru();
+  ~UrlLru();
+  bool begin(int slots);
+  int slots() const { return _slots; }
+
+  // The slot holding `url`, marked most recently used; -1 if none.
+  int find(const char *url);
+  // find() without touching the LRU order
+  int peek(const char *url) const;
+  // The slot for `url`: its own, else a free one, else the least recently
+  // used one (`evicted` set). Keyed by `url` and marked most recently used.
+  int claim(const char *url, bool &evicted);
+  // Frees the slot; its URL is no longer found.
+  void drop(int slot) { _entries[slot].lastUsed = 0; }
+
+private:
+  struct Entry {
+    FixedString<TrackInfo::URL_SIZE> url;
+    uint32_t urlHash;
+    uint32_t lastUsed; // 0 = free slot
+  };
+
+  Entry *_entries;
+  int _slots;
+  uint32_t _useClock;
+
+  int lookup(const char *url, uint32_t hash) const;
+};
+
+#endif
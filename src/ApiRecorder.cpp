@@ -0,0 +1,150 @@
+#include "ApiRecorder.h"
+
+#include <esp_heap_caps.h>
+
+static const char *PATH = "/rec.log";
+static const uint32_t REPORT_INTERVAL = 100; // records between log lines
+
+ApiRecorder::ApiRecorder() {
+  _lock = nullptr;
+  _body = nullptr;
+  _bodyLen = 0;
+  _cut = false;
+  _path[0] = '\0';
+  _method[0] = '\0';
+  _status = 0;
+  _startedAt = 0;
+  _latencyMs = 0;
+  _retryAfterSec = 0;
+  _fileBytes = 0;
+  _active = false;
+  _recorded = 0;
+  _dropped = 0;
+  _full = false;
+}
+
+bool ApiRecorder::begin() {
+  _lock = xSemaphoreCreateMutex();
+  _body = (uint8_t *)heap_caps_malloc(BODY_MAX,
+                                      MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  _file = LittleFS.open(PATH, "a");
+  if (_lock == nullptr || _body == nullptr || !_file) {
+    Serial.println("[rec] unavailable");
+    return false;
+  }
+  _fileBytes = _file.size();
+  Serial.printf("[rec] recording API traffic to %s (%u B so far)\n", PATH,
+                _fileBytes);
+  return true;
+}
+
+void ApiRecorder::start(const char *path) {
+  strlcpy(_path, path, sizeof(_path));
+  _startedAt = millis();
+  _active = false;
+}
+
+void ApiRecorder::response(const char *method, int status,
+                           unsigned long latencyMs, long retryAfterSec) {
+  strlcpy(_method, method, sizeof(_method));
+  _status = status;
+  _latencyMs = latencyMs;
+  _retryAfterSec = retryAfterSec;
+  _bodyLen = 0;
+  _cut = false;
+  _active = _body != nullptr;
+}
+
+size_t ApiRecorder::write(uint8_t c) { return write(&c, 1); }
+
+size_t ApiRecorder::write(const uint8_t *buffer, size_t size) {
+  if (!_active) {
+    return size;
+  }
+  size_t n = size;
+  if (n > BODY_MAX - _bodyLen) {
+    n = BODY_MAX - _bodyLen;
+    _cut = true;
+  }
+  memcpy(_body + _bodyLen, buffer, n);
+  _bodyLen += n;
+  return size;
+}
+
+void ApiRecorder::finish() {
+  if (!_active) {
+    return;
+  }
+  _active = false;
+  if (_full) {
+    return;
+  }
+  // Dumping: skip this one rather than stall the network task
+  if (xSemaphoreTake(_lock, 0) != pdTRUE) {
+    _dropped++;
+    return;
+  }
+
+  char header[200];
+  int len = snprintf(header, sizeof(header), "REQ %lu %s %s %d %lu %ld %u%s\n",
+                     _startedAt, _method, _path, _status, _latencyMs,
+                     _retryAfterSec, (unsigned)_bodyLen, _cut ? " cut" : "");
+  size_t recordBytes = len + _bodyLen + 1;
+  if (_fileBytes + recordBytes > FILE_MAX) {
+    _full = true;
+    xSemaphoreGive(_lock);
+    Serial.printf("[rec] %s full after %u requests, recording stopped\n",
+                  PATH, _recorded);
+    return;
+  }
+  _file.write((const uint8_t *)header, len);
+  _file.write(_body, _bodyLen);
+  _file.write('\n');
+  _file.flush();
+  _fileBytes += recordBytes;
+  _recorded++;
+  xSemaphoreGive(_lock);
+
+  if (_cut) {
+    Serial.printf("[rec] %s body cut at %u B\n", _path, BODY_MAX);
+  }
+  if (_recorded % REPORT_INTERVAL == 0) {
+    Serial.printf("[rec] %u requests, %u B (%u dropped)\n", _recorded,
+                  _fileBytes, _dropped);
+  }
+}
+
+void ApiRecorder::dump(Print &out) {
+  if (_lock == nullptr) {
+    return;
+  }
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  _file.close();
+  out.println("--- rec begin ---");
+  File f = LittleFS.open(PATH, "r");
+  if (f) {
+    uint8_t buf[256];
+    size_t n;
+    while ((n = f.read(buf, sizeof(buf))) > 0) {
+      out.write(buf, n);
+    }
+    f.close();
+  }
+  out.println("--- rec end ---");
+  _file = LittleFS.open(PATH, "a");
+  xSemaphoreGive(_lock);
+}
+
+void ApiRecorder::clear() {
+  if (_lock == nullptr) {
+    return;
+  }
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  _file.close();
+  LittleFS.remove(PATH);
+  _file = LittleFS.open(PATH, "a");
+  _fileBytes = 0;
+  _full = false;
+  xSemaphoreGive(_lock);
+  Serial.println("[rec] cleared");
+}
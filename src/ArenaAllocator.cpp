@@ -0,0 +1,87 @@
+#include "ArenaAllocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+ArenaAllocator::ArenaAllocator(void *buffer, size_t size) {
+  // Align the start; everything after stays aligned via round()
+  uintptr_t start = ((uintptr_t)buffer + ALIGN - 1) & ~(uintptr_t)(ALIGN - 1);
+  _buf = (uint8_t *)start;
+  _size = size > start - (uintptr_t)buffer ? size - (start - (uintptr_t)buffer)
+                                           : 0;
+  _used = 0;
+  _last = nullptr;
+  _live = 0;
+  _highWater = 0;
+  _fallbacks = 0;
+}
+
+void *ArenaAllocator::allocate(size_t size) {
+  size_t need = round(sizeof(Header)) + round(size);
+  if (_used + need > _size) {
+    _fallbacks++;
+    return malloc(size);
+  }
+
+  uint8_t *block = _buf + _used + round(sizeof(Header));
+  ((Header *)(block - round(sizeof(Header))))->size = size;
+  _used += need;
+  if (_used > _highWater) {
+    _highWater = _used;
+  }
+  _last = block;
+  _live++;
+  return block;
+}
+
+void ArenaAllocator::deallocate(void *ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  if (!owns(ptr)) {
+    free(ptr);
+    return;
+  }
+
+  _live--;
+  if (_live == 0) {
+    _used = 0;
+    _last = nullptr;
+  } else if (ptr == _last) {
+    // Give the tail back (earlier blocks are only freed with the arena)
+    _used = (uint8_t *)ptr - round(sizeof(Header)) - _buf;
+    _last = nullptr;
+  }
+}
+
+void *ArenaAllocator::reallocate(void *ptr, size_t newSize) {
+  if (ptr == nullptr) {
+    return allocate(newSize);
+  }
+  if (!owns(ptr)) {
+    return realloc(ptr, newSize);
+  }
+
+  Header *h = (Header *)((uint8_t *)ptr - round(sizeof(Header)));
+  if (ptr == _last) {
+    size_t start = (uint8_t *)ptr - _buf;
+    if (start + round(newSize) <= _size) {
+      h->size = newSize;
+      _used = start + round(newSize);
+      if (_used > _highWater) {
+        _highWater = _used;
+      }
+      return ptr;
+    }
+  } else if (newSize <= h->size) {
+    h->size = newSize; // shrink in place, the slack stays until reset
+    return ptr;
+  }
+
+  void *moved = allocate(newSize);
+  if (moved != nullptr) {
+    memcpy(moved, ptr, h->size < newSize ? h->size : newSize);
+    deallocate(ptr);
+  }
+  return moved;
+}
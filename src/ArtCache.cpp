@@ -0,0 +1,62 @@
+#include "ArtCache.h"
+
+ArtCache::ArtCache(size_t budgetBytes) {
+  _capacity = budgetBytes / TILE_BYTES;
+  _pixels = nullptr;
+  if (_slots.begin(_capacity)) {
+    _pixels = new uint16_t *[_capacity];
+    for (size_t i = 0; i < _capacity; i++) {
+      _pixels[i] = nullptr; // allocated on first use
+    }
+  }
+  _hits = 0;
+  _misses = 0;
+  _evictions = 0;
+}
+
+ArtCache::~ArtCache() {
+  for (size_t i = 0; i < _capacity; i++) {
+    free(_pixels[i]);
+  }
+  delete[] _pixels;
+}
+
+const uint16_t *ArtCache::find(const char *url) {
+  int slot = _slots.find(url);
+  if (slot < 0) {
+    _misses++;
+    return nullptr;
+  }
+  _hits++;
+  return _pixels[slot];
+}
+
+const uint16_t *ArtCache::peek(const char *url) {
+  int slot = _slots.peek(url);
+  return slot >= 0 ? _pixels[slot] : nullptr;
+}
+
+bool ArtCache::insert(const char *url, const uint16_t *pixels) {
+  if (_capacity == 0 || url[0] == '\0' ||
+      strlen(url) >= TrackInfo::URL_SIZE) {
+    return false;
+  }
+
+  bool evicted;
+  int slot = _slots.claim(url, evicted);
+  if (evicted) {
+    _evictions++;
+  }
+  if (_pixels[slot] == nullptr) {
+    _pixels[slot] = (uint16_t *)heap_caps_malloc(
+        TILE_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (_pixels[slot] == nullptr) {
+      // PSRAM exhausted or absent: caller falls back to the streaming path.
+      _slots.drop(slot);
+      return false;
+    }
+  }
+
+  memcpy(_pixels[slot], pixels, TILE_BYTES);
+  return true;
+}
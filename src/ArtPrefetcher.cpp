@@ -0,0 +1,300 @@
+#include "ArtPrefetcher.h"
+
+#include "ArtCache.h"
+#include "Telemetry.h"
+
+ArtPrefetcher::ArtPrefetcher(HttpPool &pool)
+    : _showGen(0), _prefetchGen(0), _thumbGen(0), _busy(false),
+      _state(Empty) {
+  _pool = &pool;
+  _task = nullptr;
+  portMUX_INITIALIZE(&_lock);
+  _showDone = 0;
+  _prefetchDone = 0;
+  _thumbDone = 0;
+  _thumbSize = 0;
+  _job = nullptr;
+  _cancelled = 0;
+  _failures = 0;
+  _preview = false;
+  _tileKind = NoJob;
+  _tileGen = 0;
+}
+
+bool ArtPrefetcher::begin(BaseType_t core) {
+  _canvas.setColorDepth(16);
+  _canvas.setPsram(true);
+  if (_canvas.createSprite(ArtCache::TILE_SIZE, ArtCache::TILE_SIZE) ==
+      nullptr) {
+    return false;
+  }
+  if (xTaskCreatePinnedToCore(taskEntry, "art", STACK_SIZE, this, 1, &_task,
+                              core) != pdPASS) {
+    return false;
+  }
+  Telemetry::registerTask("art", _task);
+  return true;
+}
+
+void ArtPrefetcher::show(const char *url, const char *thumbUrl) {
+  portENTER_CRITICAL(&_lock);
+  _showUrl = url;
+  _showThumbUrl = thumbUrl;
+  _showGen.fetch_add(1, std::memory_order_release);
+  portEXIT_CRITICAL(&_lock);
+  if (_task != nullptr) {
+    xTaskNotifyGive(_task);
+  }
+}
+
+void ArtPrefetcher::prefetch(const char *url) {
+  if (url[0] == '\0') {
+    return;
+  }
+  portENTER_CRITICAL(&_lock);
+  _prefetchUrl = url;
+  _prefetchGen.fetch_add(1, std::memory_order_release);
+  portEXIT_CRITICAL(&_lock);
+  if (_task != nullptr) {
+    xTaskNotifyGive(_task);
+  }
+}
+
+void ArtPrefetcher::thumbnail(const char *url, int size) {
+  if (url[0] == '\0') {
+    return;
+  }
+  portENTER_CRITICAL(&_lock);
+  _thumbUrl = url;
+  _thumbSize = size;
+  _thumbGen.fetch_add(1, std::memory_order_release);
+  portEXIT_CRITICAL(&_lock);
+  if (_task != nullptr) {
+    xTaskNotifyGive(_task);
+  }
+}
+
+const uint16_t *ArtPrefetcher::take(const char *url, bool &preview) {
+  uint8_t expected = Ready;
+  if (!_state.compare_exchange_strong(expected, Reading,
+                                      std::memory_order_acq_rel)) {
+    return nullptr;
+  }
+  if (_url != url) {
+    _state.store(Ready, std::memory_order_release);
+    return nullptr;
+  }
+  preview = _preview;
+  return (const uint16_t *)_canvas.getBuffer();
+}
+
+void ArtPrefetcher::release() {
+  // The tile has been drawn (and cached); free it for the next image.
+  _state.store(Empty, std::memory_order_release);
+}
+
+void ArtPrefetcher::taskEntry(void *arg) {
+  static_cast<ArtPrefetcher *>(arg)->run();
+}
+
+void ArtPrefetcher::run() {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    Job job;
+    while (nextJob(job)) {
+      if (job.kind == ShowJob) {
+        runShow(job);
+      } else if (job.kind == ThumbJob) {
+        runThumb(job);
+      } else {
+        runPrefetch(job);
+      }
+    }
+  }
+}
+
+// Latest show() first, then the latest thumbnail(), then the latest
+// prefetch(); older requests of the same kind are simply skipped.
+bool ArtPrefetcher::nextJob(Job &job) {
+  job.kind = NoJob;
+  portENTER_CRITICAL(&_lock);
+  uint32_t showGen = _showGen.load(std::memory_order_relaxed);
+  uint32_t prefetchGen = _prefetchGen.load(std::memory_order_relaxed);
+  uint32_t thumbGen = _thumbGen.load(std::memory_order_relaxed);
+  if (showGen != _showDone) {
+    job.kind = ShowJob;
+    job.gen = showGen;
+    job.url = _showUrl;
+    job.thumbUrl = _showThumbUrl;
+    _showDone = showGen;
+  } else if (thumbGen != _thumbDone) {
+    job.kind = ThumbJob;
+    job.gen = thumbGen;
+    job.url = _thumbUrl;
+    job.thumbUrl.clear();
+    job.size = _thumbSize;
+    _thumbDone = thumbGen;
+  } else if (prefetchGen != _prefetchDone) {
+    job.kind = PrefetchJob;
+    job.gen = prefetchGen;
+    job.url = _prefetchUrl;
+    job.thumbUrl.clear();
+  }
+  portEXIT_CRITICAL(&_lock);
+  job.startedAt = millis();
+  return job.kind != NoJob;
+}
+
+void ArtPrefetcher::runShow(const Job &job) {
+  if (job.url.isEmpty()) {
+    return; // cancel only
+  }
+  // Already staged by a prefetch; the UI picks it up from there.
+  if (_state.load(std::memory_order_acquire) == Ready && !_preview &&
+      _url == job.url) {
+    return;
+  }
+
+  // A failed thumbnail is not fatal: the full image follows anyway.
+  if (!job.thumbUrl.isEmpty() && claim(job)) {
+    float scale = (float)ArtCache::TILE_SIZE / THUMB_SIZE;
+    publish(job, download(job, job.thumbUrl.c_str(), scale), true);
+  }
+  if (claim(job)) {
+    // Scale 300x300 -> 180x180 (scale 0.6)
+    publish(job, download(job, job.url.c_str(), 0.6f), false);
+  }
+}
+
+void ArtPrefetcher::runThumb(const Job &job) {
+  if (claim(job)) {
+    publish(job, download(job, job.url.c_str(), (float)job.size / THUMB_SIZE),
+            false);
+  }
+}
+
+void ArtPrefetcher::runPrefetch(const Job &job) {
+  bool staged = _state.load(std::memory_order_acquire) == Ready &&
+                !_preview && _url == job.url;
+  if (!staged && claim(job)) {
+    publish(job, download(job, job.url.c_str(), 0.6f), false);
+  }
+  // Interrupted by a show(): leave it pending so it runs again afterwards.
+  if (_showGen.load(std::memory_order_acquire) == _showDone) {
+    _prefetchDone = job.gen;
+  }
+}
+
+bool ArtPrefetcher::superseded(const Job &job) const {
+  if (millis() - job.startedAt > DEADLINE_MS) {
+    return true;
+  }
+  uint32_t showGen = _showGen.load(std::memory_order_acquire);
+  if (job.kind == ShowJob) {
+    return showGen != job.gen;
+  }
+  if (job.kind == ThumbJob) {
+    return showGen != _showDone ||
+           _thumbGen.load(std::memory_order_acquire) != job.gen;
+  }
+  return showGen != _showDone ||
+         _prefetchGen.load(std::memory_order_acquire) != job.gen;
+}
+
+// Polled by the body stream while the JPEG decoder reads it.
+bool ArtPrefetcher::abortCheck(void *ctx) {
+  ArtPrefetcher *self = static_cast<ArtPrefetcher *>(ctx);
+  return self->_job != nullptr && self->superseded(*self->_job);
+}
+
+// Waits until the tile may be overwritten and moves it to Loading. A tile
+// staged for the current show() is kept until the UI has taken it.
+bool ArtPrefetcher::claim(const Job &job) {
+  for (;;) {
+    if (superseded(job)) {
+      _cancelled++;
+      return false;
+    }
+    uint8_t state = _state.load(std::memory_order_acquire);
+    bool busy = state == Reading ||
+                (state == Ready && _tileKind == ShowJob &&
+                 _tileGen == _showGen.load(std::memory_order_acquire));
+    if (!busy && _state.compare_exchange_strong(state, Loading,
+                                                std::memory_order_acq_rel)) {
+      return true;
+    }
+    vTaskDelay(pdMS_TO_TICKS(CLAIM_POLL_MS));
+  }
+}
+
+// Downloads `url` and decodes it into the tile. The tile must be claimed.
+bool ArtPrefetcher::download(const Job &job, const char *url, float scale) {
+  HTTPClient http;
+  HttpLease lease;
+  _busy.store(true, std::memory_order_relaxed);
+  _pool->open(http, url, lease);
+  http.setConnectTimeout(CONNECT_TIMEOUT_MS);
+  http.setTimeout(READ_TIMEOUT_MS);
+  int httpCode = _pool->send(http, lease, "GET");
+  if (httpCode < 0 && lease.reused && !superseded(job)) {
+    // Kept-alive connection was closed by the CDN; retry on a fresh one.
+    _pool->close(http, lease, httpCode);
+    _pool->open(http, url, lease);
+    http.setConnectTimeout(CONNECT_TIMEOUT_MS);
+    http.setTimeout(READ_TIMEOUT_MS);
+    httpCode = _pool->send(http, lease, "GET");
+  }
+
+  bool ok = false;
+  if (httpCode == HTTP_CODE_OK && !superseded(job)) {
+    // A newer request ends the body early, so the decoder gives up at its
+    // next read instead of finishing an image nobody will see.
+    _job = &job;
+    lease.body.setTimeout(READ_TIMEOUT_MS);
+    lease.body.setAbortCheck(abortCheck, this);
+    _canvas.fillScreen(TFT_BLACK);
+    ok = _canvas.drawJpg(&lease.body, 0, 0, 0, 0, 0, 0, scale);
+    _job = nullptr;
+  }
+  _pool->close(http, lease, httpCode);
+  _busy.store(false, std::memory_order_relaxed);
+  return ok;
+}
+
+const char *ArtPrefetcher::jobName(JobKind kind) {
+  switch (kind) {
+  case ShowJob:
+    return "download";
+  case ThumbJob:
+    return "list thumbnail";
+  default:
+    return "prefetch";
+  }
+}
+
+// Hands a claimed tile to the UI (or back to Empty on failure).
+void ArtPrefetcher::publish(const Job &job, bool ok, bool preview) {
+  unsigned long ms = millis() - job.startedAt;
+  if (ok && !superseded(job)) {
+    _url = job.url;
+    _preview = preview;
+    _tileKind = job.kind;
+    _tileGen = job.gen;
+    _state.store(Ready, std::memory_order_release);
+    if (job.kind == PrefetchJob) {
+      Serial.printf("[prefetch] staged in %lu ms\n", ms);
+    }
+    return;
+  }
+
+  _state.store(Empty, std::memory_order_release);
+  if (superseded(job) && ms <= DEADLINE_MS) {
+    _cancelled++;
+    Serial.printf("[art] %s cancelled after %lu ms\n", jobName(job.kind),
+                  ms);
+  } else {
+    _failures++;
+    Serial.printf("[art] %s %s failed after %lu ms\n", jobName(job.kind),
+                  preview ? "thumbnail" : "image", ms);
+  }
+}
@@ -0,0 +1,144 @@
+#include "Compositor.h"
+
+#include "Telemetry.h"
+
+Layer::Layer(int x, int y, int w, int h) : _canvas(&M5.Display) {
+  _x = x;
+  _y = y;
+  _w = w;
+  _h = h;
+  _dirtyX = 0;
+  _dirtyY = 0;
+  _dirtyW = 0;
+  _dirtyH = 0;
+  _drawnPixels = 0;
+  _frameStart = nullptr;
+}
+
+bool Layer::begin(bool psram) {
+  _canvas.setColorDepth(16);
+  _canvas.setPsram(psram);
+  if (_canvas.createSprite(_w, _h) == nullptr) {
+    Serial.printf("Layer %dx%d allocation failed\n", _w, _h);
+    return false;
+  }
+  _canvas.fillScreen(TFT_BLACK);
+  return true;
+}
+
+void Layer::markDirty(int x, int y, int w, int h) {
+  // Clip to the layer
+  if (x < 0) {
+    w += x;
+    x = 0;
+  }
+  if (y < 0) {
+    h += y;
+    y = 0;
+  }
+  if (x + w > _w) {
+    w = _w - x;
+  }
+  if (y + h > _h) {
+    h = _h - y;
+  }
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+
+  _drawnPixels += w * h;
+  if (_frameStart != nullptr && *_frameStart == 0) {
+    *_frameStart = micros();
+  }
+
+  if (_dirtyW == 0) {
+    _dirtyX = x;
+    _dirtyY = y;
+    _dirtyW = w;
+    _dirtyH = h;
+    return;
+  }
+  int x2 = max(_dirtyX + _dirtyW, x + w);
+  int y2 = max(_dirtyY + _dirtyH, y + h);
+  _dirtyX = min((int)_dirtyX, x);
+  _dirtyY = min((int)_dirtyY, y);
+  _dirtyW = x2 - _dirtyX;
+  _dirtyH = y2 - _dirtyY;
+}
+
+Compositor::Compositor() {
+  _layerCount = 0;
+  _frameStart = 0;
+  _frames = 0;
+  _frameUsTotal = 0;
+  _frameUsMax = 0;
+  _bytesPushed = 0;
+  _bytesDrawn = 0;
+}
+
+void Compositor::addLayer(Layer &layer) {
+  if (_layerCount < MAX_LAYERS) {
+    layer._frameStart = &_frameStart;
+    _layers[_layerCount++] = &layer;
+  }
+}
+
+void Compositor::invalidate() {
+  for (int i = 0; i < _layerCount; i++) {
+    _layers[i]->markAllDirty();
+  }
+}
+
+void Compositor::flush() {
+  if (_frameStart == 0) {
+    return; // nothing drawn since the last flush
+  }
+
+  M5.Display.startWrite();
+  for (int i = 0; i < _layerCount; i++) {
+    Layer &l = *_layers[i];
+    const uint16_t *buf = (const uint16_t *)l._canvas.getBuffer();
+    if (l._dirtyW == 0 || buf == nullptr) {
+      continue;
+    }
+
+    // Rows of the dirty rect are contiguous in the address window, so they
+    // stream back to back. The canvas is already in panel byte order.
+    M5.Display.setAddrWindow(l._x + l._dirtyX, l._y + l._dirtyY, l._dirtyW,
+                             l._dirtyH);
+    for (int row = 0; row < l._dirtyH; row++) {
+      M5.Display.pushPixelsDMA(buf + (l._dirtyY + row) * l._w + l._dirtyX,
+                               l._dirtyW, false);
+    }
+
+    _bytesPushed += l._dirtyW * l._dirtyH * sizeof(uint16_t);
+    _bytesDrawn += l._drawnPixels * sizeof(uint16_t);
+    l._dirtyW = 0;
+    l._drawnPixels = 0;
+  }
+  // Canvases may be drawn on again right after we return
+  M5.Display.waitDMA();
+  M5.Display.endWrite();
+
+  unsigned long frameUs = micros() - _frameStart;
+  _frameStart = 0;
+  Telemetry::record(Stage::Frame, frameUs);
+  _frames++;
+  _frameUsTotal += frameUs;
+  if (frameUs > _frameUsMax) {
+    _frameUsMax = frameUs;
+  }
+
+  if (_frames >= STATS_INTERVAL) {
+    // "drawn" is what drawing straight to the panel would have sent
+    Serial.printf("[frame] %u frames: avg %lu us, max %lu us, pushed %u B "
+                  "(drawn %u B)\n",
+                  _frames, _frameUsTotal / _frames, _frameUsMax, _bytesPushed,
+                  _bytesDrawn);
+    _frames = 0;
+    _frameUsTotal = 0;
+    _frameUsMax = 0;
+    _bytesPushed = 0;
+    _bytesDrawn = 0;
+  }
+}
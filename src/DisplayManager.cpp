@@ -1,5 +1,8 @@
 #include "DisplayManager.h"
 
+#include "ScreenStyle.h"
+#include "Telemetry.h"
+
 // Approximate Spotify Green (RGB 29, 185, 84) -> RGB565 conversion
 // 29>>3 = 3 (00011)
 // 185>>2 = 46 (101110)
@@ -7,7 +10,40 @@
 // 0001 1101 1100 1010 -> 0x1DCA
 #define SPOTIFY_GREEN 0x1DCA
 
-DisplayManager::DisplayManager() { _lastIsPlaying = false; }
+// Screen regions, each backed by an off-screen layer (see Compositor)
+static const int ART_SIZE = 180;
+static const int PROGRESS_Y = 180;
+static const int PROGRESS_H = 10;
+static const int CONTROLS_Y = PROGRESS_Y + PROGRESS_H;
+
+// Track text, in text-layer coordinates
+static const int TEXT_X = 6; // +6px margin (186 on screen)
+static const int TEXT_MAX_WIDTH = 135;
+
+// Volume overlay, in text-layer coordinates
+static const int VOLUME_BAR_X = 10;
+static const int VOLUME_BAR_Y = 110;
+static const int VOLUME_BAR_W = 120;
+static const int VOLUME_BAR_H = 8;
+
+DisplayManager::DisplayManager()
+    : _art(0, 0, ART_SIZE, ART_SIZE),
+      _text(ART_SIZE, 0, 320 - ART_SIZE, ART_SIZE),
+      _progress(0, PROGRESS_Y, 320, PROGRESS_H),
+      _controls(0, CONTROLS_Y, 320, 240 - CONTROLS_Y) {
+  _store = nullptr;
+  _transportDrawn = false;
+  _messageShown = false;
+  _covered = false;
+  _prefetcher = nullptr;
+  _artRequestedAt = 0;
+  _previewShown = false;
+  _prefetchHits = 0;
+  _prefetchMisses = 0;
+  _drawnFillW = -1;
+  _shownVolume = -1;
+  _seekPreviewMs = -1;
+}
 
 void DisplayManager::begin() {
   M5.Display.fillScreen(TFT_BLACK);
@@ -17,15 +53,71 @@ void DisplayManager::begin() {
   // fonts::efontJA_16 is a good candidate for standard Japanese text.
   M5.Display.setFont(&fonts::efontJA_16);
   M5.Display.setTextColor(TFT_WHITE, TFT_BLACK);
+
+  // Big, rarely changing layers live in PSRAM; the small ones that change
+  // every few frames stay in internal RAM so DMA can read them directly.
+  _art.begin(true);
+  _text.begin(true);
+  _progress.begin(false);
+  _controls.begin(false);
+  _compositor.addLayer(_art);
+  _compositor.addLayer(_text);
+  _compositor.addLayer(_progress);
+  _compositor.addLayer(_controls);
+
+  // One width table per text font; the font is selected before each layout
+  _titleMarquee.begin();
+  _artistMarquee.begin();
+  _titleWidths.begin(measureCanvasGlyph, &_text.canvas());
+  _artistWidths.begin(measureCanvasGlyph, &_text.canvas());
+}
+
+void DisplayManager::render() {
+  pollArt();
+  if (!_covered) {
+    _compositor.flush();
+  }
 }
 
+void DisplayManager::setCovered(bool covered) {
+  if (_covered && !covered) {
+    _compositor.invalidate();
+  }
+  _covered = covered;
+}
+
+void DisplayManager::claimScreen() {
+  // A full-screen message was drawn directly; repaint every layer over it.
+  if (_messageShown) {
+    _messageShown = false;
+    _compositor.invalidate();
+  }
+}
+
+void DisplayManager::seedArt(const char *url, const uint16_t *artTile) {
+  _artCache.insert(url, artTile);
+}
+
+void DisplayManager::attach(PlayerStore &store) {
+  _store = &store;
+  store.subscribe(PlayerStore::Art | PlayerStore::Liked, renderArt, this);
+  store.subscribe(PlayerStore::Text, renderText, this);
+  store.subscribe(PlayerStore::Playing, renderControls, this);
+  store.subscribe(PlayerStore::Progress | PlayerStore::Playing |
+                      PlayerStore::Track,
+                  renderProgress, this);
+}
+
+// Full-screen messages bypass the layers (only used around setup()).
 void DisplayManager::showLoading(const char *message) {
+  _messageShown = true;
   M5.Display.fillScreen(TFT_BLACK);
   M5.Display.setCursor(10, 100);
   M5.Display.println(message);
 }
 
 void DisplayManager::showError(const char *message) {
+  _messageShown = true;
   M5.Display.fillScreen(TFT_RED);
   M5.Display.setTextColor(TFT_WHITE, TFT_RED);
   M5.Display.setCursor(10, 100);
@@ -33,288 +125,403 @@ void DisplayManager::showError(const char *message) {
   M5.Display.setTextColor(TFT_WHITE, TFT_BLACK); // Reset
 }
 
-void DisplayManager::updateNowPlaying(String title, String artist,
-                                      String albumName, String albumArtUrl) {
-  bool artChanged = (albumArtUrl != _lastArtUrl);
-  bool textChanged = (title != _lastTitle || artist != _lastArtist);
+void DisplayManager::renderArt(void *ctx, const PlayerState &state,
+                               uint16_t changed) {
+  DisplayManager *self = static_cast<DisplayManager *>(ctx);
+  self->claimScreen();
+  // New art comes with its badge; otherwise only the badge changed.
+  if ((changed & PlayerStore::Art) && !state.track.artUrl.isEmpty()) {
+    self->drawAlbumArt(state.track);
+  } else if (changed & PlayerStore::Liked) {
+    self->drawLikeButton(state.isLiked);
+  }
+}
 
-  if (artChanged && !albumArtUrl.isEmpty()) {
-    drawAlbumArt(albumArtUrl);
-    _lastArtUrl = albumArtUrl;
+void DisplayManager::renderText(void *ctx, const PlayerState &state,
+                                uint16_t changed) {
+  DisplayManager *self = static_cast<DisplayManager *>(ctx);
+  self->claimScreen();
+  if (self->_shownVolume < 0) { // else hideVolume() draws it
+    self->drawTextInfo(state.track.title.c_str(), state.track.artist.c_str());
   }
+}
+
+void DisplayManager::renderControls(void *ctx, const PlayerState &state,
+                                    uint16_t changed) {
+  DisplayManager *self = static_cast<DisplayManager *>(ctx);
+  self->claimScreen();
+  self->drawControls(state.isPlaying);
+}
 
-  if (textChanged) {
-    drawTextInfo(title, artist);
-    _lastTitle = title;
-    _lastArtist = artist;
+void DisplayManager::renderProgress(void *ctx, const PlayerState &state,
+                                    uint16_t changed) {
+  DisplayManager *self = static_cast<DisplayManager *>(ctx);
+  self->claimScreen();
+  self->tickProgress();
+}
+
+void DisplayManager::tickProgress() {
+  if (_store == nullptr) {
+    return;
   }
+  const PlayerState &state = _store->state();
+  int progress =
+      _seekPreviewMs >= 0 ? _seekPreviewMs : state.position(millis());
+  updateProgress(progress, state.track.durationMs);
 }
 
-void DisplayManager::updatePlaybackState(bool isPlaying, int progress,
-                                         int duration) {
-  // Redraw play/pause button if changed
-  if (isPlaying != _lastIsPlaying) {
-    drawControls(isPlaying);
-    _lastIsPlaying = isPlaying;
+void DisplayManager::tickMarquee(bool paused) {
+  if (paused || _shownVolume >= 0 || _messageShown || _covered ||
+      !(_titleMarquee.active() || _artistMarquee.active())) {
+    return;
+  }
+  unsigned long start = micros();
+  bool drawn = _titleMarquee.tick(_text);
+  drawn |= _artistMarquee.tick(_text);
+  if (drawn) {
+    Telemetry::record(Stage::Marquee, micros() - start);
   }
+}
+
+void DisplayManager::previewSeek(int ms) {
+  _seekPreviewMs = ms;
+  tickProgress();
+}
+
+void DisplayManager::endSeekPreview() {
+  _seekPreviewMs = -1;
+  tickProgress();
+}
 
+void DisplayManager::updateProgress(int progress, int duration) {
   // Draw Progress Bar
-  int barY = 186; // Below 180px artwork + padding
+  M5Canvas &g = _progress.canvas();
+  int barY = 6; // 186 on screen: below 180px artwork + padding
   int barHeight = 4;
-  int screenW = M5.Display.width();
+  int screenW = _progress.width();
+
+  int fillW = 0;
+  if (duration > 0 && progress > 0) {
+    fillW = progress >= duration
+                ? screenW
+                : (int)((int64_t)screenW * progress / duration);
+  }
 
-  float pct = (float)progress / (float)duration;
-  if (pct > 1.0)
-    pct = 1.0;
+  if (_drawnFillW < 0) {
+    // First frame: background then progress
+    g.fillRect(0, barY, screenW, barHeight, TFT_DARKGREY);
+    g.fillRect(0, barY, fillW, barHeight, SPOTIFY_GREEN);
+    _progress.markDirty(0, barY, screenW, barHeight);
+  } else if (fillW > _drawnFillW) {
+    // Only the columns that changed (usually a single pixel)
+    g.fillRect(_drawnFillW, barY, fillW - _drawnFillW, barHeight,
+               SPOTIFY_GREEN);
+    _progress.markDirty(_drawnFillW, barY, fillW - _drawnFillW, barHeight);
+  } else if (fillW < _drawnFillW) {
+    g.fillRect(fillW, barY, _drawnFillW - fillW, barHeight, TFT_DARKGREY);
+    _progress.markDirty(fillW, barY, _drawnFillW - fillW, barHeight);
+  }
+  _drawnFillW = fillW;
+}
 
-  int fillW = (int)(screenW * pct);
+void DisplayManager::showVolume(int percent) {
+  claimScreen();
+  if (percent == _shownVolume) {
+    return;
+  }
+  M5Canvas &g = _text.canvas();
+  g.setTextSize(1.0);
+  if (_shownVolume < 0) {
+    g.fillScreen(TFT_BLACK);
+    g.setFont(&fonts::lgfxJapanGothicP_16);
+    g.setTextColor(TFT_LIGHTGREY, TFT_BLACK);
+    g.drawString("Volume", (_text.width() - g.textWidth("Volume")) / 2, 40);
+    _text.markAllDirty();
+  }
+  _shownVolume = percent;
+
+  char label[8];
+  snprintf(label, sizeof(label), "%d%%", percent);
+  g.setFont(&fonts::lgfxJapanGothicP_20);
+  g.setTextColor(TFT_WHITE, TFT_BLACK);
+  int labelY = 70;
+  g.fillRect(0, labelY, _text.width(), g.fontHeight(), TFT_BLACK);
+  g.drawString(label, (_text.width() - g.textWidth(label)) / 2, labelY);
+  _text.markDirty(0, labelY, _text.width(), g.fontHeight());
+
+  int fillW = VOLUME_BAR_W * percent / 100;
+  g.fillRect(VOLUME_BAR_X, VOLUME_BAR_Y, fillW, VOLUME_BAR_H, SPOTIFY_GREEN);
+  g.fillRect(VOLUME_BAR_X + fillW, VOLUME_BAR_Y, VOLUME_BAR_W - fillW,
+             VOLUME_BAR_H, TFT_DARKGREY);
+  _text.markDirty(VOLUME_BAR_X, VOLUME_BAR_Y, VOLUME_BAR_W, VOLUME_BAR_H);
+}
 
-  // Draw background bar
-  M5.Display.fillRect(0, barY, screenW, barHeight, TFT_DARKGREY);
-  // Draw progress
-  M5.Display.fillRect(0, barY, fillW, barHeight, SPOTIFY_GREEN);
+void DisplayManager::hideVolume() {
+  if (_shownVolume < 0) {
+    return;
+  }
+  _shownVolume = -1;
+  const TrackInfo &track = _store->state().track;
+  drawTextInfo(track.title.c_str(), track.artist.c_str());
 }
 
 void DisplayManager::drawLikeButton(bool isLiked) {
-  // Region: Overlay on Artwork (Bottom-Right)
-  // Artwork is 180x180 at (0,0).
-  // Center X = 180 - 13 - 8 = 159 (give some margin from edge)
-  // Center Y = 180 - 13 - 8 = 159.
-
-  int r = 13;
-  int cx = 159;
-  int cy = 159;
-
-  // Draw Black Background Circle (Badge style)
-  // Radius + padding (User requested slightly larger border)
-  M5.Display.fillCircle(cx, cy, r + 4, TFT_BLACK);
-
-  if (isLiked) {
-    // Green Filled Circle
-    M5.Display.fillCircle(cx, cy, r, SPOTIFY_GREEN);
-
-    // Black Checkmark
-    M5.Display.setColor(TFT_BLACK);
-
-    int x1 = cx - 4;
-    int y1 = cy;
-    int x2 = cx - 1;
-    int y2 = cy + 4;
-    int x3 = cx + 5;
-    int y3 = cy - 4;
-
-    for (int i = 0; i < 2; i++) {
-      M5.Display.drawLine(x1, y1 + i, x2, y2 + i, TFT_BLACK);
-      M5.Display.drawLine(x1 + 1, y1 + i, x2 + 1, y2 + i, TFT_BLACK);
-
-      M5.Display.drawLine(x2, y2 + i, x3, y3 + i, TFT_BLACK);
-      M5.Display.drawLine(x2 + 1, y2 + i, x3 + 1, y3 + i, TFT_BLACK);
-    }
-    M5.Display.fillCircle(x2, y2, 1, TFT_BLACK);
+  // Badge over the artwork's bottom-right corner, centered at (159, 159);
+  // the art shows through around the disc
+  drawIcon(_art, isLiked ? IconId::Liked : IconId::NotLiked, 142, 142);
+}
 
-  } else {
-    // White Outline Circle + Plus
-    M5.Display.drawCircle(cx, cy, r, TFT_WHITE);
-    M5.Display.drawCircle(cx, cy, r - 1, TFT_WHITE);
+void DisplayManager::drawAlbumArt(const TrackInfo &track) {
+  unsigned long start = micros();
+  const char *url = track.artUrl.c_str();
+  if (!_pendingArtUrl.isEmpty()) {
+    // Still loading the previous track's art; stop that download.
+    _pendingArtUrl.clear();
+    _prefetcher->show("", "");
+  }
 
-    int s = 5;
-    M5.Display.fillRect(cx - s, cy - 1, s * 2 + 1, 3, TFT_WHITE); // Horz
-    M5.Display.fillRect(cx - 1, cy - s, 3, s * 2 + 1, TFT_WHITE); // Vert
+  // Cache hit: one copy of the already-scaled tile, no network or decode.
+  const uint16_t *tile = _artCache.find(url);
+  if (tile != nullptr) {
+    showArtTile(tile);
+    logArtSource("cache", Stage::ArtLocal, start);
+    return;
+  }
+  if (_prefetcher == nullptr) {
+    return;
   }
-}
 
-void DisplayManager::drawAlbumArt(String url) {
-  HTTPClient http;
-  http.begin(url);
-  int httpCode = http.GET();
-  if (httpCode == HTTP_CODE_OK) {
-    // Clear the artwork area
-    M5.Display.fillRect(0, 0, 180, 180, TFT_BLACK);
+  // Prefetch hit: the art task already decoded the next track's art.
+  bool preview = false;
+  tile = _prefetcher->take(url, preview);
+  if (tile != nullptr && !preview) {
+    _prefetchHits++;
+    showArtTile(tile);
+    _artCache.insert(url, tile);
+    _prefetcher->release();
+    logArtSource("prefetch", Stage::ArtLocal, start);
+    return;
+  }
+  if (tile != nullptr) {
+    _prefetcher->release();
+  }
+  _prefetchMisses++;
+
+  // Blank the old cover right away; pollArt() shows the thumbnail, then the
+  // full image, as the art task stages them.
+  _art.canvas().fillScreen(TFT_BLACK);
+  drawLikeButton(_store->state().isLiked);
+  _art.markAllDirty();
+  _pendingArtUrl = track.artUrl;
+  _artRequestedAt = start;
+  _previewShown = false;
+  _prefetcher->show(url, track.thumbUrl.c_str());
+}
 
-    WiFiClient *stream = http.getStreamPtr();
-    // Scale 300x300 -> 180x180 (scale 0.6)
-    M5.Display.drawJpg(stream, 0, 0, 0, 0, 0, 0, 0.6f);
+void DisplayManager::pollArt() {
+  if (_pendingArtUrl.isEmpty()) {
+    return;
+  }
+  bool preview = false;
+  const uint16_t *tile = _prefetcher->take(_pendingArtUrl.c_str(), preview);
+  if (tile == nullptr) {
+    return;
   }
-  http.end();
-}
-
-// Helper to draw icons
-void drawIcon(int x, int y, int type, uint16_t color) {
-  // type: 0=Prev, 1=Play, 2=Pause, 3=Next
-  M5.Display.setColor(color);
-  int size = 9; // Reduced size (3/4 of 12)
-
-  if (type == 0) { // Prev (|<< like, but simplified to |<)
-    // Bar
-    M5.Display.fillRect(x - size, y - size, 4, size * 2, color);
-    // Triangle pointing left
-    M5.Display.fillTriangle(x - size + 4, y, x + size, y - size, x + size,
-                            y + size, color);
-  } else if (type == 1) { // Play (Triangle)
-    // Adjust center for visual balance
-    int off = 2;
-    M5.Display.fillTriangle(x - size + off, y - size, x - size + off, y + size,
-                            x + size + off, y, color);
-  } else if (type == 2) { // Pause (||)
-    M5.Display.fillRect(x - 8, y - size, 6, size * 2, color);
-    M5.Display.fillRect(x + 2, y - size, 6, size * 2, color);
-  } else if (type == 3) { // Next (>|)
-    // Triangle pointing right
-    M5.Display.fillTriangle(x - size, y - size, x - size, y + size,
-                            x + size - 4, y, color);
-    // Bar
-    M5.Display.fillRect(x + size - 4, y - size, 4, size * 2, color);
+  claimScreen();
+  showArtTile(tile);
+  if (preview) {
+    _prefetcher->release();
+    _previewShown = true;
+    logArtSource("preview", Stage::ArtPreview, _artRequestedAt);
+    return;
   }
+  _artCache.insert(_pendingArtUrl.c_str(), tile);
+  _prefetcher->release();
+  _pendingArtUrl.clear();
+  logArtSource(_previewShown ? "full" : "download", Stage::ArtDownload,
+               _artRequestedAt);
 }
 
-void DisplayManager::drawTextInfo(String title, String artist) {
-  // Clear text area (X=180 to 320, Y=0 to 180)
-  M5.Display.fillRect(180, 0, 140, 180, TFT_BLACK);
-  M5.Display.setClipRect(180, 0, 140, 180);
+// Copies a 180x180 tile into the art layer, badge on top.
+void DisplayManager::showArtTile(const uint16_t *tile) {
+  _art.canvas().pushImage(0, 0, ArtCache::TILE_SIZE, ArtCache::TILE_SIZE,
+                          (const lgfx::swap565_t *)tile);
+  drawLikeButton(_store->state().isLiked);
+  _art.markAllDirty();
+}
 
-  // Layout calculations
-  // Artwork 180px. Center Y = 90.
-  // Block Height = 52px.
-  // Start Y = 90 - 26 = 64.
+void DisplayManager::logArtSource(const char *source, Stage stage,
+                                  unsigned long start) {
+  unsigned long us = micros() - start;
+  Telemetry::record(stage, us);
+  Serial.printf("[art] %s %lu ms | cache hit %u miss %u evict %u | "
+                "prefetch hit %u/%u | cancelled %u failed %u\n",
+                source, us / 1000, _artCache.hits(), _artCache.misses(),
+                _artCache.evictions(), _prefetchHits,
+                _prefetchHits + _prefetchMisses,
+                _prefetcher ? _prefetcher->cancelled() : 0,
+                _prefetcher ? _prefetcher->failures() : 0);
+}
 
-  int startX = 186; // +6px margin
-  int startY = 64;
+void DisplayManager::drawIcon(Layer &layer, IconId id, int x, int y) {
+  const Icon &icon = IconAtlas::get(id);
+  const lgfx::rgb565_t *pixels = (const lgfx::rgb565_t *)icon.pixels;
+  if (icon.keyed) {
+    layer.canvas().pushImage(x, y, icon.width, icon.height, pixels,
+                             IconAtlas::TRANSPARENT);
+  } else {
+    layer.canvas().pushImage(x, y, icon.width, icon.height, pixels);
+  }
+  layer.markDirty(x, y, icon.width, icon.height);
+}
 
-  M5.Display.setCursor(startX, startY);
+// Draws the lines of the last layout() starting at y; returns the y below.
+int DisplayManager::drawLines(M5Canvas &g, const char *text, int y) {
+  char buf[TextLayout::LINE_BYTES];
+  for (int i = 0; i < _layout.lineCount(); i++) {
+    _layout.copyLine(text, i, buf);
+    g.drawString(buf, TEXT_X, y);
+    y += g.fontHeight();
+  }
+  return y;
+}
 
-  // Title: 20px, White, Prominent
-  M5.Display.setFont(&fonts::lgfxJapanGothicP_20);
-  M5.Display.setTextSize(1.0);
-  M5.Display.setTextColor(TFT_WHITE, TFT_BLACK);
+// The text on one scrolling line if the last layout() cut it off.
+bool DisplayManager::startMarquee(Marquee &marquee, const char *text,
+                                  const lgfx::IFont *font, uint16_t color) {
+  int n = _layout.lineCount();
+  if (n == 0 || !_layout.line(n - 1).ellipsis) {
+    marquee.stop();
+    return false;
+  }
+  return marquee.set(text, font, color, TFT_BLACK, TEXT_MAX_WIDTH);
+}
 
-  // Manual Wrapping for Title
-  int maxWidth = 135; // Increased slightly due to reduced margin
-  M5.Display.setTextWrap(false);
-
-  if (M5.Display.textWidth(title) > maxWidth) {
-    String line1 = "";
-    String line2 = "";
-    int len = title.length();
-
-    for (int i = 0; i < len;) {
-      int charLen = 1;
-      unsigned char c = title[i];
-      if (c >= 0xF0)
-        charLen = 4;
-      else if (c >= 0xE0)
-        charLen = 3;
-      else if (c >= 0xC0)
-        charLen = 2;
-
-      String temp = title.substring(0, i + charLen);
-      if (M5.Display.textWidth(temp) > maxWidth) {
-        line1 = title.substring(0, i);
-        line2 = title.substring(i);
-        break;
-      }
-      i += charLen;
-      if (i >= len) {
-        line1 = title;
-        line2 = "";
-      }
-    }
+void DisplayManager::drawTextInfo(const char *title, const char *artist) {
+  // Clear text area (X=180 to 320, Y=0 to 180 on screen). The layer itself
+  // clips to that area.
+  StageTimer timer(Stage::TextLayout);
+  M5Canvas &g = _text.canvas();
+  g.fillScreen(TFT_BLACK);
+  g.setTextSize(1.0);
+  g.setTextWrap(false);
 
-    int adjustedY = startY - 12;
-    M5.Display.setCursor(startX, adjustedY);
+  // Layout calculations
+  // Artwork 180px. Center Y = 90.
+  // Block Height = 52px.
+  // Start Y = 90 - 26 = 64, moved up 12px when the title wraps.
+  // Text that would be cut off after two lines scrolls on one line instead.
 
-    M5.Display.println(line1);
-    M5.Display.setCursor(startX, M5.Display.getCursorY());
-    M5.Display.println(line2);
+  // Title: 20px, White, Prominent
+  g.setFont(&fonts::lgfxJapanGothicP_20);
+  g.setTextColor(TFT_WHITE, TFT_BLACK);
+  int lines = _layout.layout(title, _titleWidths, TEXT_MAX_WIDTH, 2);
+  int y;
+  if (startMarquee(_titleMarquee, title, &fonts::lgfxJapanGothicP_20,
+                   TFT_WHITE)) {
+    y = 64;
+    _titleMarquee.draw(_text, TEXT_X, y);
+    y += _titleMarquee.height();
   } else {
-    M5.Display.setCursor(startX, startY);
-    M5.Display.println(title);
+    y = 64 - 12 * (lines > 1 ? lines - 1 : 0);
+    y = drawLines(g, title, y);
   }
 
   // Gap
-  int cursorY = M5.Display.getCursorY() + 8;
-  M5.Display.setCursor(startX, cursorY);
+  y += 8;
 
   // Artist: 16px, Grey
-  M5.Display.setFont(&fonts::lgfxJapanGothicP_16);
-  M5.Display.setTextColor(TFT_LIGHTGREY, TFT_BLACK);
-
-  // Manual Wrapping for Artist
-  if (M5.Display.textWidth(artist) > maxWidth) {
-    String line1 = "";
-    String line2 = "";
-    int len = artist.length();
-
-    for (int i = 0; i < len;) {
-      int charLen = 1;
-      unsigned char c = artist[i];
-      if (c >= 0xF0)
-        charLen = 4;
-      else if (c >= 0xE0)
-        charLen = 3;
-      else if (c >= 0xC0)
-        charLen = 2;
-
-      String temp = artist.substring(0, i + charLen);
-      if (M5.Display.textWidth(temp) > maxWidth) {
-        line1 = artist.substring(0, i);
-        line2 = artist.substring(i);
-        break;
-      }
-      i += charLen;
-      if (i >= len) {
-        line1 = artist;
-        line2 = "";
-      }
-    }
-    M5.Display.println(line1);
-    M5.Display.setCursor(startX, M5.Display.getCursorY());
-    M5.Display.println(line2);
+  g.setFont(&fonts::lgfxJapanGothicP_16);
+  g.setTextColor(TFT_LIGHTGREY, TFT_BLACK);
+  _layout.layout(artist, _artistWidths, TEXT_MAX_WIDTH, 2);
+  if (startMarquee(_artistMarquee, artist, &fonts::lgfxJapanGothicP_16,
+                   TFT_LIGHTGREY)) {
+    _artistMarquee.draw(_text, TEXT_X, y);
   } else {
-    M5.Display.println(artist);
+    drawLines(g, artist, y);
   }
 
-  M5.Display.setTextWrap(true);
-  M5.Display.setTextColor(TFT_WHITE, TFT_BLACK);
-  M5.Display.clearClipRect();
+  _text.markAllDirty();
 }
 
-void DisplayManager::drawControls(bool isPlaying) {
-  int centerY = 216; // Lower position (Bottom 240, R=19, Pad=5 -> 240-24=216)
-
-  // Prev Button (Center ~ 60)
-  // Clear area (Reduced)
-  M5.Display.fillRect(45, centerY - 15, 30, 30, TFT_BLACK);
-  drawIcon(60, centerY, 0, TFT_WHITE);
+#ifdef TEXT_LAYOUT_BENCH
+// The wrap loop drawTextInfo() used before TextLayout: re-measures the whole
+// prefix for every character, so O(n^2) in glyphs and one String per step.
+static int legacyWrap(LovyanGFX &g, const String &text, int maxWidth) {
+  if (g.textWidth(text) <= maxWidth) {
+    return text.length();
+  }
+  int len = text.length();
+  for (int i = 0; i < len;) {
+    int charLen = 1;
+    unsigned char c = text[i];
+    if (c >= 0xF0)
+      charLen = 4;
+    else if (c >= 0xE0)
+      charLen = 3;
+    else if (c >= 0xC0)
+      charLen = 2;
+
+    String temp = text.substring(0, i + charLen);
+    if (g.textWidth(temp) > maxWidth) {
+      return i;
+    }
+    i += charLen;
+  }
+  return len;
+}
 
-  // Play/Pause - Special Circular Button (Center 160)
-  int ppX = 160;
-  int ppR = 19; // Reduced from 25 (approx 3/4)
+void DisplayManager::benchmarkTextLayout() {
+  static const char *samples[] = {
+      "\xE5\xA4\x9C\xE3\x81\xAB\xE9\xA7\x86\xE3\x81\x91\xE3\x82"
+      "\x8B\xE3\x80\x8C\xE3\x81\x82\xE3\x81\x95\xE3\x81\xA3\xE3"
+      "\x81\xA6\xE3\x80\x8D\xE3\x81\xA8\xE3\x81\x84\xE3\x81\x86"
+      "\xE3\x82\xB7\xE3\x83\xA7\xE3\x83\xBC\xE3\x83\x88\xE3\x82"
+      "\xB9\xE3\x83\x88\xE3\x83\xBC\xE3\x83\xAA\xE3\x83\xBC",
+      "Symphony No. 9 in D Minor, Op. 125 \"Choral\": IV. Presto - Allegro "
+      "assai (Live at the Royal Albert Hall, 2012 Remaster)",
+      "Short Title",
+  };
+  static const int ROUNDS = 20;
+  M5Canvas &g = _text.canvas();
+  g.setFont(&fonts::lgfxJapanGothicP_20);
+
+  for (const char *text : samples) {
+    String s(text);
+    unsigned long t0 = micros();
+    for (int r = 0; r < ROUNDS; r++) {
+      legacyWrap(g, s, TEXT_MAX_WIDTH);
+    }
+    unsigned long legacyUs = (micros() - t0) / ROUNDS;
 
-  // Clear area (Reduced)
-  M5.Display.fillRect(135, centerY - 25, 50, 50, TFT_BLACK);
+    GlyphWidthCache cold;
+    cold.begin(measureCanvasGlyph, &g);
+    t0 = micros();
+    _layout.layout(text, cold, TEXT_MAX_WIDTH, 2);
+    unsigned long coldUs = micros() - t0;
 
-  // Draw White Circle
-  M5.Display.fillCircle(ppX, centerY, ppR, TFT_WHITE);
+    t0 = micros();
+    for (int r = 0; r < ROUNDS; r++) {
+      _layout.layout(text, cold, TEXT_MAX_WIDTH, 2);
+    }
+    unsigned long warmUs = (micros() - t0) / ROUNDS;
 
-  // Draw Icon
-  if (isPlaying) {
-    drawIcon(ppX, centerY, 2, TFT_BLACK);
-  } else {
-    drawIcon(ppX, centerY, 1, TFT_BLACK);
+    Serial.printf("[text] %u bytes: legacy %lu us, layout %lu us cold / %lu us "
+                  "warm (%d lines)\n",
+                  s.length(), legacyUs, coldUs, warmUs, _layout.lineCount());
   }
+}
+#endif
 
-  // Next Button (Center ~ 260)
-  // Clear area (Reduced)
-  M5.Display.fillRect(245, centerY - 15, 30, 30, TFT_BLACK);
-  drawIcon(260, centerY, 3, TFT_WHITE);
+void DisplayManager::drawControls(bool isPlaying) {
+  // Buttons centered at x = 60, 160, 260 and y = 216 on screen
+  if (!_transportDrawn) {
+    drawIcon(_controls, IconId::Prev, 45, 11);
+    drawIcon(_controls, IconId::Next, 245, 11);
+    _transportDrawn = true;
+  }
+  drawIcon(_controls, isPlaying ? IconId::Pause : IconId::Play, 135, 1);
 }
 
 void DisplayManager::drawButton(int x, int y, int w, int h, const char *label,
                                 uint16_t color, bool filled) {}
-
-void DisplayManager::updateControlState(bool shuffle, const char *repeatMode,
-                                        bool isLiked) {
-  // Always draw to ensure visibility after text clearing
-  drawLikeButton(isLiked);
-  _lastIsLiked = isLiked;
-}
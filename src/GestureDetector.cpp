@@ -0,0 +1,82 @@
+#include "GestureDetector.h"
+
+#include <stdlib.h>
+
+GestureDetector::GestureDetector() {
+  _state = Idle;
+  _lastSampleAt = 0;
+  _downAt = 0;
+}
+
+bool GestureDetector::update(bool pressed, int x, int y, unsigned long now,
+                             Gesture &out) {
+  if (now - _lastSampleAt < SAMPLE_INTERVAL_MS) {
+    return false;
+  }
+  _lastSampleAt = now;
+
+  GestureType type = GestureType::None;
+  switch (_state) {
+  case Idle:
+    if (pressed) {
+      _state = Pressed;
+      _downAt = now;
+      _current = Gesture();
+      _current.startX = _current.x = x;
+      _current.startY = _current.y = y;
+    }
+    break;
+
+  case Pressed:
+  case Held: {
+    if (!pressed) {
+      type = _state == Pressed ? GestureType::Tap : GestureType::None;
+      _state = Idle;
+      break;
+    }
+    int dx = x - _current.startX;
+    int dy = y - _current.startY;
+    if (abs(dx) > SLOP_PX || abs(dy) > SLOP_PX) {
+      // A long press that then moves becomes a drag as well
+      _state = Dragging;
+      _current.axis = abs(dx) >= abs(dy) ? DragAxis::Horizontal
+                                         : DragAxis::Vertical;
+      _current.x = x;
+      _current.y = y;
+      type = GestureType::DragStart;
+    } else if (_state == Pressed && now - _downAt >= LONG_PRESS_MS) {
+      _state = Held;
+      type = GestureType::LongPress;
+    }
+    break;
+  }
+
+  case Dragging:
+    if (!pressed) {
+      // The release sample has no position; the last one stands.
+      int distance = _current.axis == DragAxis::Horizontal
+                         ? _current.x - _current.startX
+                         : _current.y - _current.startY;
+      bool quick = now - _downAt <= SWIPE_MAX_MS;
+      if (quick && abs(distance) >= SWIPE_MIN_PX) {
+        type = GestureType::Swipe;
+        _current.direction = distance < 0 ? -1 : 1;
+      } else {
+        type = GestureType::DragEnd;
+      }
+      _state = Idle;
+    } else if (x != _current.x || y != _current.y) {
+      _current.x = x;
+      _current.y = y;
+      type = GestureType::DragMove;
+    }
+    break;
+  }
+
+  if (type == GestureType::None) {
+    return false;
+  }
+  _current.type = type;
+  out = _current;
+  return true;
+}
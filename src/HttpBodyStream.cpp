@@ -0,0 +1,215 @@
+#include "HttpBodyStream.h"
+
+HttpBodyStream::HttpBodyStream() {
+  _client = nullptr;
+  _chunked = false;
+  _untilClose = false;
+  _done = true;
+  _truncated = false;
+  _inChunk = false;
+  _remaining = 0;
+  _abortCheck = nullptr;
+  _abortCtx = nullptr;
+  _tee = nullptr;
+}
+
+void HttpBodyStream::begin(HTTPClient &http, bool hasBody) {
+  _client = hasBody ? http.getStreamPtr() : nullptr;
+  _chunked = http.header("Transfer-Encoding").equalsIgnoreCase("chunked");
+  _inChunk = false;
+  _done = (_client == nullptr);
+  _remaining = 0;
+  _untilClose = false;
+  _truncated = false;
+  _abortCheck = nullptr;
+  _abortCtx = nullptr;
+  _tee = nullptr;
+
+  if (!_done && !_chunked) {
+    int size = http.getSize();
+    _untilClose = (size < 0);
+    _remaining = size < 0 ? 0 : size;
+    _done = (size == 0);
+  }
+}
+
+void HttpBodyStream::setAbortCheck(bool (*check)(void *ctx), void *ctx) {
+  _abortCheck = check;
+  _abortCtx = ctx;
+}
+
+// Blocking single-byte read honouring the Stream timeout.
+int HttpBodyStream::waitRead() {
+  unsigned long start = millis();
+  do {
+    int c = _client->read();
+    if (c >= 0) {
+      return c;
+    }
+    if (!_client->connected()) {
+      return -1;
+    }
+    delay(1);
+  } while (millis() - start < _timeout);
+  return -1;
+}
+
+// Makes sure _remaining > 0, reading the next chunk header if needed.
+// Returns false at the end of the body.
+bool HttpBodyStream::nextChunk() {
+  if (_done) {
+    return false;
+  }
+  if (_abortCheck != nullptr && _abortCheck(_abortCtx)) {
+    _done = true;
+    _truncated = true;
+    return false;
+  }
+  if (_remaining > 0 || _untilClose) {
+    return true;
+  }
+  if (!_chunked) {
+    _done = true;
+    return false;
+  }
+
+  // CRLF that terminates the previous chunk's data
+  if (_inChunk) {
+    if (waitRead() != '\r' || waitRead() != '\n') {
+      _done = true;
+      _truncated = true;
+      return false;
+    }
+  }
+
+  // "<hex size>[;extensions]\r\n"
+  long size = 0;
+  bool inExtension = false;
+  for (;;) {
+    int c = waitRead();
+    if (c < 0) {
+      _done = true;
+      _truncated = true;
+      return false;
+    }
+    if (c == '\n') {
+      break;
+    }
+    if (c == ';') {
+      inExtension = true;
+    }
+    if (inExtension || c == '\r') {
+      continue;
+    }
+    int digit = isDigit(c) ? c - '0' : (toupper(c) - 'A' + 10);
+    if (digit < 0 || digit > 15) {
+      continue;
+    }
+    size = size * 16 + digit;
+  }
+
+  if (size == 0) {
+    // Last chunk: skip (normally empty) trailers up to the blank line
+    int lineLen = 0;
+    for (;;) {
+      int c = waitRead();
+      if (c < 0) {
+        _truncated = true;
+        break;
+      }
+      if (c == '\n') {
+        if (lineLen == 0) {
+          break;
+        }
+        lineLen = 0;
+      } else if (c != '\r') {
+        lineLen++;
+      }
+    }
+    _done = true;
+    return false;
+  }
+
+  _remaining = size;
+  _inChunk = true;
+  return true;
+}
+
+int HttpBodyStream::available() {
+  if (_done) {
+    return 0;
+  }
+  int avail = _client->available();
+  if (_remaining == 0 && !_untilClose) {
+    // At a chunk boundary; report data without blocking on the header.
+    return avail > 0 ? 1 : 0;
+  }
+  if (!_untilClose && avail > _remaining) {
+    avail = _remaining;
+  }
+  return avail;
+}
+
+int HttpBodyStream::read() {
+  if (!nextChunk()) {
+    return -1;
+  }
+  int c = waitRead();
+  if (c < 0) {
+    _done = true;
+    _truncated = !_untilClose;
+    return -1;
+  }
+  if (!_untilClose) {
+    _remaining--;
+  }
+  if (_tee != nullptr) {
+    _tee->write((uint8_t)c);
+  }
+  return c;
+}
+
+int HttpBodyStream::peek() {
+  if (!nextChunk()) {
+    return -1;
+  }
+  return _client->peek();
+}
+
+size_t HttpBodyStream::readBytes(char *buffer, size_t length) {
+  size_t n = 0;
+  unsigned long lastData = millis();
+  while (n < length && nextChunk()) {
+    size_t want = length - n;
+    if (!_untilClose && (long)want > _remaining) {
+      want = _remaining;
+    }
+    int got = _client->read((uint8_t *)buffer + n, want);
+    if (got > 0) {
+      if (_tee != nullptr) {
+        _tee->write((const uint8_t *)buffer + n, got);
+      }
+      n += got;
+      if (!_untilClose) {
+        _remaining -= got;
+      }
+      lastData = millis();
+      continue;
+    }
+    if (!_client->connected() || millis() - lastData >= _timeout) {
+      _done = true;
+      _truncated = !_untilClose;
+      break;
+    }
+    delay(1);
+  }
+  return n;
+}
+
+bool HttpBodyStream::drain() {
+  char scratch[64];
+  while (readBytes(scratch, sizeof(scratch)) > 0) {
+  }
+  // For "until close" bodies the socket is gone anyway.
+  return !_untilClose && !_truncated;
+}
@@ -0,0 +1,162 @@
+#include "HttpPool.h"
+
+#include "Telemetry.h"
+
+HttpPool::HttpPool() {
+  // The API connection is polled every few seconds and effectively never
+  // idles; art and token requests are rarer, so don't hold their sockets.
+  _conns[0].host = "api.spotify.com";
+  _conns[0].idleTimeout = 30000;
+  _conns[1].host = "i.scdn.co";
+  _conns[1].idleTimeout = 15000;
+  _conns[2].host = "accounts.spotify.com";
+  _conns[2].idleTimeout = 5000;
+
+  for (int i = 0; i < POOL_SIZE; i++) {
+    Connection &c = _conns[i];
+    c.lock = nullptr;
+    c.lastUsed = 0;
+    c.handshakes = 0;
+    c.reuses = 0;
+    c.errors = 0;
+    c.handshakeMs = 0;
+    c.reuseMs = 0;
+  }
+  _oneOffRequests = 0;
+  _oneOffMs = 0;
+  _requests = 0;
+  _recorder = nullptr;
+}
+
+void HttpPool::begin() {
+  for (int i = 0; i < POOL_SIZE; i++) {
+    // Same trust model as HTTPClient::begin(url) without a CA certificate.
+    _conns[i].client.setInsecure();
+    _conns[i].lock = xSemaphoreCreateMutex();
+  }
+}
+
+int HttpPool::findSlot(const String &url) {
+  // "https://<host>/..."
+  if (!url.startsWith("https://")) {
+    return -1;
+  }
+  const char *host = url.c_str() + 8;
+  for (int i = 0; i < POOL_SIZE; i++) {
+    size_t len = strlen(_conns[i].host);
+    if (strncmp(host, _conns[i].host, len) == 0 &&
+        (host[len] == '/' || host[len] == '\0')) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void HttpPool::open(HTTPClient &http, const String &url, HttpLease &lease) {
+  lease.active = true;
+  lease.startedAt = micros();
+  lease.reused = false;
+  lease.slot = findSlot(url);
+  // Web API only: token requests carry the client secret
+  lease.recorded = _recorder != nullptr && lease.slot == API_SLOT;
+  if (lease.recorded) {
+    // The path, after "https://<host>"
+    _recorder->start(url.c_str() + 8 + strlen(_conns[API_SLOT].host));
+  }
+
+  if (lease.slot >= 0) {
+    Connection &c = _conns[lease.slot];
+    if (c.lock == nullptr || xSemaphoreTake(c.lock, 0) != pdTRUE) {
+      lease.slot = -1; // busy in the other task
+    } else {
+      if (c.client.connected() && millis() - c.lastUsed > c.idleTimeout) {
+        // The server has likely dropped it already; don't find out the hard
+        // way mid-request.
+        c.client.stop();
+      }
+      lease.reused = c.client.connected();
+    }
+  }
+
+  if (lease.slot >= 0) {
+    http.begin(_conns[lease.slot].client, url);
+    http.setReuse(true);
+  } else {
+    http.begin(url);
+  }
+
+  static const char *headerKeys[] = {"Transfer-Encoding", "Retry-After"};
+  http.collectHeaders(headerKeys, 2);
+}
+
+int HttpPool::send(HTTPClient &http, HttpLease &lease, const char *method,
+                   const String &payload) {
+  int httpCode = http.sendRequest(method, payload);
+  // Connect + TLS (if any) + time to the response headers
+  Telemetry::record(lease.reused ? Stage::HttpReused : Stage::HttpFresh,
+                    micros() - lease.startedAt);
+  bool hasBody = httpCode > 0 && httpCode != 204 && httpCode != 304;
+  lease.body.begin(http, hasBody);
+  if (lease.recorded) {
+    _recorder->response(method, httpCode, (micros() - lease.startedAt) / 1000,
+                        http.header("Retry-After").toInt());
+    lease.body.setTee(_recorder);
+  }
+  return httpCode;
+}
+
+void HttpPool::close(HTTPClient &http, HttpLease &lease, int httpCode) {
+  if (!lease.active) {
+    return;
+  }
+  lease.active = false;
+
+  bool clean = lease.body.drain() && httpCode > 0;
+  if (lease.recorded) {
+    _recorder->finish();
+    lease.recorded = false;
+  }
+  http.end();
+
+  unsigned long elapsed = (micros() - lease.startedAt) / 1000;
+  _requests++;
+
+  if (lease.slot < 0) {
+    _oneOffRequests++;
+    _oneOffMs += elapsed;
+  } else {
+    Connection &c = _conns[lease.slot];
+    if (lease.reused) {
+      c.reuses++;
+      c.reuseMs += elapsed;
+    } else {
+      c.handshakes++;
+      c.handshakeMs += elapsed;
+    }
+    if (!clean) {
+      c.errors++;
+      c.client.stop();
+    }
+    c.lastUsed = millis();
+    xSemaphoreGive(c.lock);
+  }
+  lease.slot = -1;
+
+  if (_requests % STATS_INTERVAL == 0) {
+    printStats();
+  }
+}
+
+void HttpPool::printStats() {
+  for (int i = 0; i < POOL_SIZE; i++) {
+    const Connection &c = _conns[i];
+    Serial.printf("[http] %s: reuse %u (avg %lu ms), handshake %u "
+                  "(avg %lu ms), errors %u\n",
+                  c.host, c.reuses, c.reuses ? c.reuseMs / c.reuses : 0,
+                  c.handshakes, c.handshakes ? c.handshakeMs / c.handshakes : 0,
+                  c.errors);
+  }
+  Serial.printf("[http] one-off: %u (avg %lu ms)\n", _oneOffRequests,
+                _oneOffRequests ? (unsigned long)(_oneOffMs / _oneOffRequests)
+                                : 0UL);
+}
@@ -0,0 +1,200 @@
+#include "IconAtlas.h"
+
+// Everything below runs in the compiler: the rasterizer is constexpr and the
+// bitmaps are constexpr arrays, so only the finished pixels reach flash.
+//
+// Coordinates are integers in 1/UNIT pixel (integer math keeps compile times
+// short), pixel (x, y) covering [x, x + 1) x [y, y + 1); shapes are painted
+// in order, later on top.
+
+static const int UNIT = 8;
+static const int SAMPLES = 4; // per axis, at odd multiples of 1/UNIT
+static_assert(SAMPLES * 2 == UNIT, "samples must tile the pixel");
+
+struct Shape {
+  enum Kind : uint8_t { Rect, Disc, Ring, Triangle, Stroke };
+  Kind kind;
+  // Rect: x0 y0 x1 y1 | Disc: cx cy r | Ring: cx cy inner outer |
+  // Triangle: three vertices | Stroke: segment a-b and half width in e
+  int32_t a, b, c, d, e, f;
+  uint32_t rgb; // 0xRRGGBB
+};
+
+static const uint32_t WHITE = 0xFFFFFF;
+static const uint32_t BLACK = 0x000000;
+static const uint32_t GREEN = 0x1DB954; // Spotify green
+
+// The helpers take integer pixel positions, as the LovyanGFX calls they
+// replace did, and convert them to pixel centers.
+static constexpr int32_t center(int p) { return p * UNIT + UNIT / 2; }
+
+static constexpr Shape rect(int x, int y, int w, int h, uint32_t rgb) {
+  return {Shape::Rect, x * UNIT, y * UNIT, (x + w) * UNIT, (y + h) * UNIT,
+          0, 0, rgb};
+}
+static constexpr Shape disc(int cx, int cy, int r, uint32_t rgb) {
+  return {Shape::Disc, center(cx), center(cy), center(r), 0, 0, 0, rgb};
+}
+// Radii in 1/UNIT pixel
+static constexpr Shape ring(int cx, int cy, int inner, int outer,
+                            uint32_t rgb) {
+  return {Shape::Ring, center(cx), center(cy), inner, outer, 0, 0, rgb};
+}
+static constexpr Shape triangle(int x0, int y0, int x1, int y1, int x2,
+                                int y2, uint32_t rgb) {
+  return {Shape::Triangle, center(x0), center(y0), center(x1),
+          center(y1),      center(x2), center(y2), rgb};
+}
+// Endpoints and half width in 1/UNIT pixel
+static constexpr Shape stroke(int x0, int y0, int x1, int y1, int halfWidth,
+                              uint32_t rgb) {
+  return {Shape::Stroke, x0, y0, x1, y1, halfWidth, 0, rgb};
+}
+
+static constexpr int64_t edge(int32_t ax, int32_t ay, int32_t bx, int32_t by,
+                              int32_t px, int32_t py) {
+  return (int64_t)(bx - ax) * (py - ay) - (int64_t)(by - ay) * (px - ax);
+}
+
+static constexpr int64_t dist2(int32_t ax, int32_t ay, int32_t bx,
+                               int32_t by) {
+  return (int64_t)(bx - ax) * (bx - ax) + (int64_t)(by - ay) * (by - ay);
+}
+
+static constexpr bool inside(const Shape &s, int32_t x, int32_t y) {
+  switch (s.kind) {
+  case Shape::Rect:
+    return x >= s.a && x < s.c && y >= s.b && y < s.d;
+  case Shape::Disc:
+    return dist2(s.a, s.b, x, y) <= (int64_t)s.c * s.c;
+  case Shape::Ring: {
+    int64_t d2 = dist2(s.a, s.b, x, y);
+    return d2 >= (int64_t)s.c * s.c && d2 <= (int64_t)s.d * s.d;
+  }
+  case Shape::Triangle: {
+    int64_t e0 = edge(s.a, s.b, s.c, s.d, x, y);
+    int64_t e1 = edge(s.c, s.d, s.e, s.f, x, y);
+    int64_t e2 = edge(s.e, s.f, s.a, s.b, x, y);
+    bool neg = e0 < 0 || e1 < 0 || e2 < 0;
+    bool pos = e0 > 0 || e1 > 0 || e2 > 0;
+    return !(neg && pos);
+  }
+  case Shape::Stroke: {
+    // Distance to the segment, with round caps
+    int64_t len2 = dist2(s.a, s.b, s.c, s.d);
+    int64_t along = (int64_t)(x - s.a) * (s.c - s.a) +
+                    (int64_t)(y - s.b) * (s.d - s.b);
+    int64_t w2 = (int64_t)s.e * s.e;
+    if (along <= 0) {
+      return dist2(s.a, s.b, x, y) <= w2;
+    }
+    if (along >= len2) {
+      return dist2(s.c, s.d, x, y) <= w2;
+    }
+    int64_t across = edge(s.a, s.b, s.c, s.d, x, y);
+    return across * across <= w2 * len2;
+  }
+  }
+  return false;
+}
+
+template <int W, int H> struct Bitmap {
+  uint16_t pixels[W * H];
+};
+
+// Opaque icons average their samples against black (the controls'
+// background). Keyed ones are TRANSPARENT where less than half of the pixel
+// is covered, and otherwise average only the covered samples, since what
+// lies beneath (album art) isn't known.
+template <int W, int H, int N>
+static constexpr Bitmap<W, H> rasterize(const Shape (&shapes)[N], bool keyed) {
+  Bitmap<W, H> out{};
+  for (int y = 0; y < H; y++) {
+    for (int x = 0; x < W; x++) {
+      uint32_t r = 0, g = 0, b = 0;
+      int covered = 0;
+      for (int s = 0; s < SAMPLES * SAMPLES; s++) {
+        int32_t px = x * UNIT + (s % SAMPLES) * 2 + 1;
+        int32_t py = y * UNIT + (s / SAMPLES) * 2 + 1;
+        int hit = -1;
+        for (int i = 0; i < N; i++) {
+          if (inside(shapes[i], px, py)) {
+            hit = i;
+          }
+        }
+        if (hit >= 0) {
+          covered++;
+          r += (shapes[hit].rgb >> 16) & 0xFF;
+          g += (shapes[hit].rgb >> 8) & 0xFF;
+          b += shapes[hit].rgb & 0xFF;
+        }
+      }
+
+      uint16_t px565 = IconAtlas::TRANSPARENT;
+      if (!keyed || covered * 2 >= SAMPLES * SAMPLES) {
+        int n = keyed ? covered : SAMPLES * SAMPLES;
+        r = (r + n / 2) / n;
+        g = (g + n / 2) / n;
+        b = (b + n / 2) / n;
+        px565 = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+        if (px565 == IconAtlas::TRANSPARENT) {
+          px565 ^= 0x0020; // nearest color that isn't the key
+        }
+      }
+      out.pixels[y * W + x] = px565;
+    }
+  }
+  return out;
+}
+
+// Previous / next: 30x30, 9px half-size glyph centered at (15, 15)
+static constexpr Shape PREV_SHAPES[] = {
+    rect(6, 6, 4, 18, WHITE),
+    triangle(10, 15, 24, 6, 24, 24, WHITE),
+};
+static constexpr Shape NEXT_SHAPES[] = {
+    triangle(6, 6, 6, 24, 20, 15, WHITE),
+    rect(20, 6, 4, 18, WHITE),
+};
+
+// Play / pause: white r=19 button centered at (25, 25); the play triangle
+// sits 2px right of center for visual balance
+static constexpr Shape PLAY_SHAPES[] = {
+    disc(25, 25, 19, WHITE),
+    triangle(18, 16, 18, 34, 36, 25, BLACK),
+};
+static constexpr Shape PAUSE_SHAPES[] = {
+    disc(25, 25, 19, WHITE),
+    rect(17, 16, 6, 18, BLACK),
+    rect(27, 16, 6, 18, BLACK),
+};
+
+// Like badge: black r=17 disc centered at (17, 17) with a r=13 mark
+static constexpr Shape LIKED_SHAPES[] = {
+    disc(17, 17, 17, BLACK),
+    disc(17, 17, 13, GREEN),
+    stroke(112, 144, 136, 176, 10, BLACK), // (14, 18)-(17, 22), 2.5px wide
+    stroke(136, 176, 184, 112, 10, BLACK), // (17, 22)-(23, 14)
+};
+static constexpr Shape NOT_LIKED_SHAPES[] = {
+    disc(17, 17, 17, BLACK),
+    ring(17, 17, 92, 108, WHITE), // 11.5 to 13.5px
+    rect(12, 16, 11, 3, WHITE),
+    rect(16, 12, 3, 11, WHITE),
+};
+
+static constexpr Bitmap<30, 30> PREV = rasterize<30, 30>(PREV_SHAPES, false);
+static constexpr Bitmap<30, 30> NEXT = rasterize<30, 30>(NEXT_SHAPES, false);
+static constexpr Bitmap<50, 50> PLAY = rasterize<50, 50>(PLAY_SHAPES, false);
+static constexpr Bitmap<50, 50> PAUSE = rasterize<50, 50>(PAUSE_SHAPES, false);
+static constexpr Bitmap<35, 35> LIKED = rasterize<35, 35>(LIKED_SHAPES, true);
+static constexpr Bitmap<35, 35> NOT_LIKED =
+    rasterize<35, 35>(NOT_LIKED_SHAPES, true);
+
+static const Icon ICONS[(int)IconId::Count] = {
+    {30, 30, PREV.pixels, false},  {30, 30, NEXT.pixels, false},
+    {50, 50, PLAY.pixels, false},  {50, 50, PAUSE.pixels, false},
+    {35, 35, LIKED.pixels, true},  {35, 35, NOT_LIKED.pixels, true},
+};
+
+const Icon &IconAtlas::get(IconId id) { return ICONS[(int)id]; }
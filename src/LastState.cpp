@@ -0,0 +1,104 @@
+#include "LastState.h"
+
+#include <esp_heap_caps.h>
+#include <type_traits>
+
+#include "ArtCache.h"
+
+static const char *PATH = "/last.bin";
+static const char *TEMP_PATH = "/last.tmp";
+
+// Saved as raw bytes
+static_assert(std::is_trivially_copyable<TrackInfo>::value,
+              "TrackInfo must stay a plain copyable struct");
+
+LastState::LastState() {
+  _tile = nullptr;
+  _written = 0;
+  _saveStartedAt = 0;
+  _savedHash = 0;
+}
+
+bool LastState::begin() {
+  // Formatting happens once, on the first boot with an empty partition.
+  if (!LittleFS.begin(true)) {
+    Serial.println("[last] filesystem unavailable");
+    return false;
+  }
+  _tile = (uint16_t *)heap_caps_malloc(ArtCache::TILE_BYTES,
+                                       MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  return _tile != nullptr;
+}
+
+const uint16_t *LastState::load(TrackInfo &track) {
+  if (_tile == nullptr) {
+    return nullptr;
+  }
+  File f = LittleFS.open(PATH, "r");
+  if (!f) {
+    return nullptr;
+  }
+  bool ok = f.read((uint8_t *)&_header, sizeof(_header)) == sizeof(_header) &&
+            _header.magic == MAGIC && _header.size == sizeof(Header) &&
+            f.read((uint8_t *)_tile, ArtCache::TILE_BYTES) ==
+                ArtCache::TILE_BYTES;
+  f.close();
+  if (!ok) {
+    return nullptr;
+  }
+  track = _header.track;
+  _savedHash = track.hash;
+  return _tile;
+}
+
+bool LastState::save(const TrackInfo &track, const uint16_t *tile) {
+  if (_tile == nullptr || _file) {
+    return false;
+  }
+  _file = LittleFS.open(TEMP_PATH, "w");
+  if (!_file) {
+    return false;
+  }
+  _header.magic = MAGIC;
+  _header.size = sizeof(Header);
+  _header.track = track;
+  memcpy(_tile, tile, ArtCache::TILE_BYTES);
+  _written = 0;
+  _saveStartedAt = millis();
+  // Counts as saved from here, so a failed write isn't retried every frame
+  _savedHash = track.hash;
+  return true;
+}
+
+void LastState::step() {
+  if (!_file) {
+    return;
+  }
+
+  // Header first, then the tile, each write in its own step
+  bool ok;
+  if (_written == 0) {
+    ok = _file.write((const uint8_t *)&_header, sizeof(_header)) ==
+         sizeof(_header);
+    _written = sizeof(_header);
+  } else {
+    size_t offset = _written - sizeof(_header);
+    size_t n = ArtCache::TILE_BYTES - offset;
+    if (n > CHUNK_BYTES) {
+      n = CHUNK_BYTES;
+    }
+    ok = _file.write((const uint8_t *)_tile + offset, n) == n;
+    _written += n;
+  }
+  if (ok && _written < sizeof(_header) + ArtCache::TILE_BYTES) {
+    return;
+  }
+
+  _file.close();
+  if (ok) {
+    LittleFS.remove(PATH);
+    ok = LittleFS.rename(TEMP_PATH, PATH);
+  }
+  Serial.printf("[last] %s in %lu ms\n", ok ? "saved" : "save failed",
+                millis() - _saveStartedAt);
+}
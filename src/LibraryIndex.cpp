@@ -0,0 +1,543 @@
+#include "LibraryIndex.h"
+
+#include <string.h>
+
+static const int BUCKET_BITS = 14;
+static_assert(LibraryIndex::BUCKETS == 1 << BUCKET_BITS,
+              "BUCKETS must match BUCKET_BITS");
+
+// Normalized title, ' ', normalized artist
+static const int TEXT_MAX =
+    LibraryIndex::TITLE_MAX + LibraryIndex::NAME_MAX + 1;
+
+// U+00C0..U+00FF without accents; ' ' for the two symbols (x, /)
+static const char LATIN1_FOLD[] = "aaaaaaaceeeeiiii"
+                                  "dnooooo ouuuuyts"
+                                  "aaaaaaaceeeeiiii"
+                                  "dnooooo ouuuuyty";
+
+// U+FF66..U+FF9D, half-width katakana, as full-width katakana
+static const uint16_t HALFWIDTH_KANA[] = {
+    0x30F2, 0x30A1, 0x30A3, 0x30A5, 0x30A7, 0x30A9, 0x30E3, 0x30E5,
+    0x30E7, 0x30C3, 0x30FC, 0x30A2, 0x30A4, 0x30A6, 0x30A8, 0x30AA,
+    0x30AB, 0x30AD, 0x30AF, 0x30B1, 0x30B3, 0x30B5, 0x30B7, 0x30B9,
+    0x30BB, 0x30BD, 0x30BF, 0x30C1, 0x30C4, 0x30C6, 0x30C8, 0x30CA,
+    0x30CB, 0x30CC, 0x30CD, 0x30CE, 0x30CF, 0x30D2, 0x30D5, 0x30D8,
+    0x30DB, 0x30DE, 0x30DF, 0x30E0, 0x30E1, 0x30E2, 0x30E4, 0x30E6,
+    0x30E8, 0x30E9, 0x30EA, 0x30EB, 0x30EC, 0x30ED, 0x30EF, 0x30F3,
+};
+
+// Katakana to hiragana, then voiced and small kana to the plain one
+static uint16_t foldKana(uint16_t c) {
+  if (c >= 0x30A1 && c <= 0x30F6) {
+    c -= 0x60;
+  }
+  switch (c) {
+  case 0x3041: // small a i u e o
+  case 0x3043:
+  case 0x3045:
+  case 0x3047:
+  case 0x3049:
+  case 0x3083: // small ya yu yo
+  case 0x3085:
+  case 0x3087:
+  case 0x308E: // small wa
+    return c + 1;
+  case 0x3063: // small tsu
+    return 0x3064;
+  case 0x3094: // vu
+    return 0x3046;
+  case 0x3095: // small ka
+    return 0x304B;
+  case 0x3096: // small ke
+    return 0x3051;
+  }
+  if (c >= 0x304B && c <= 0x3062) { // ka..dji: voiced at odd offsets
+    return c - (c - 0x304B) % 2;
+  }
+  if (c >= 0x3064 && c <= 0x3069) { // tsu..do
+    return c - (c - 0x3064) % 2;
+  }
+  if (c >= 0x306F && c <= 0x307D) { // ha..po: plain, voiced, semi-voiced
+    return c - (c - 0x306F) % 3;
+  }
+  return c;
+}
+
+// One codepoint folded for matching: 0 to drop it, ' ' for a word break.
+static uint16_t fold(uint32_t cp) {
+  if (cp < 0x80) {
+    if (cp >= 'A' && cp <= 'Z') {
+      return cp + ('a' - 'A');
+    }
+    if ((cp >= 'a' && cp <= 'z') || (cp >= '0' && cp <= '9')) {
+      return cp;
+    }
+    return cp == '\'' ? 0 : ' '; // "don't" matches "dont"
+  }
+  if (cp >= 0xFF01 && cp <= 0xFF5E) { // full-width ASCII
+    return fold(cp - 0xFEE0);
+  }
+  if (cp >= 0xC0 && cp <= 0xFF) {
+    return (uint8_t)LATIN1_FOLD[cp - 0xC0];
+  }
+  if (cp >= 0xFF66 && cp <= 0xFF9D) {
+    return foldKana(HALFWIDTH_KANA[cp - 0xFF66]);
+  }
+  if ((cp >= 0x3041 && cp <= 0x3096) || (cp >= 0x30A1 && cp <= 0x30F6)) {
+    return foldKana(cp);
+  }
+  if ((cp >= 0x3099 && cp <= 0x309C) || cp == 0xFF9E || cp == 0xFF9F) {
+    return 0; // (semi-)voiced sound marks, folded away like the kana
+  }
+  if (cp == 0x2019) { // right single quote, as '
+    return 0;
+  }
+  if (cp == 0x3005 || cp == 0x3006 || cp == 0x30FC) { // 々 〆 ー
+    return cp;
+  }
+  if (cp < 0xC0 || (cp >= 0x2000 && cp <= 0x2BFF) ||
+      (cp >= 0x3000 && cp <= 0x303F) || cp == 0x30FB ||
+      (cp >= 0xFF5F && cp <= 0xFF65) || cp >= 0xFFF0) {
+    return ' '; // punctuation, symbols, and anything outside the BMP
+  }
+  return cp;
+}
+
+// Decodes one UTF-8 sequence and advances `s`; U+FFFD if malformed.
+static uint32_t decodeUtf8(const char *&s) {
+  uint8_t c = *s++;
+  if (c < 0x80) {
+    return c;
+  }
+  int extra;
+  uint32_t cp;
+  if ((c & 0xE0) == 0xC0) {
+    extra = 1;
+    cp = c & 0x1F;
+  } else if ((c & 0xF0) == 0xE0) {
+    extra = 2;
+    cp = c & 0x0F;
+  } else if ((c & 0xF8) == 0xF0) {
+    extra = 3;
+    cp = c & 0x07;
+  } else {
+    return 0xFFFD;
+  }
+  while (extra-- > 0) {
+    if ((*s & 0xC0) != 0x80) {
+      return 0xFFFD;
+    }
+    cp = (cp << 6) | (*s++ & 0x3F);
+  }
+  return cp;
+}
+
+int LibraryIndex::normalize(const char *utf8, uint16_t *out, int max) {
+  int n = 0;
+  const char *s = utf8;
+  while (*s != '\0' && n < max) {
+    uint16_t c = fold(decodeUtf8(s));
+    if (c == 0) {
+      continue;
+    }
+    if (c == ' ' && (n == 0 || out[n - 1] == ' ')) {
+      continue;
+    }
+    out[n++] = c;
+  }
+  if (n > 0 && out[n - 1] == ' ') {
+    n--;
+  }
+  return n;
+}
+
+// Fibonacci hashing of a character pair; b = 0 for a word's first character.
+static uint32_t bucketOf(uint16_t a, uint16_t b) {
+  return (((uint32_t)a << 16 | b) * 0x9E3779B1u) >> (32 - BUCKET_BITS);
+}
+
+static const char *recordTitle(const uint8_t *record) {
+  return (const char *)record + 1 + LibraryIndex::ID_LEN;
+}
+
+static const char *recordArtist(const uint8_t *record) {
+  const char *title = recordTitle(record);
+  return title + strlen(title) + 1;
+}
+
+static const uint8_t *nextRecord(const uint8_t *record) {
+  const char *artist = recordArtist(record);
+  return (const uint8_t *)artist + strlen(artist) + 1;
+}
+
+static int entryText(const uint8_t *record, uint16_t *out) {
+  int n = LibraryIndex::normalize(recordTitle(record), out,
+                                  LibraryIndex::TITLE_MAX);
+  if (n > 0) {
+    out[n++] = ' ';
+  }
+  int m = LibraryIndex::normalize(recordArtist(record), out + n,
+                                  LibraryIndex::NAME_MAX);
+  if (m == 0 && n > 0) {
+    n--;
+  }
+  return n + m;
+}
+
+// Calls f(bucket) for every key of a normalized text: each word's first
+// character and each pair of adjacent characters within a word.
+template <typename F> static void forEachKey(const uint16_t *t, int n, F f) {
+  for (int i = 0; i < n; i++) {
+    if (t[i] == ' ') {
+      continue;
+    }
+    if (i == 0 || t[i - 1] == ' ') {
+      f(bucketOf(t[i], 0));
+    }
+    if (i + 1 < n && t[i + 1] != ' ') {
+      f(bucketOf(t[i], t[i + 1]));
+    }
+  }
+}
+
+static size_t varintSize(uint32_t v) {
+  size_t n = 1;
+  while (v >= 0x80) {
+    v >>= 7;
+    n++;
+  }
+  return n;
+}
+
+static size_t copyCut(uint8_t *out, const char *s, size_t max) {
+  size_t n = s != nullptr ? strnlen(s, max + 1) : 0;
+  if (n > max) {
+    n = max;
+    // Don't cut a multi-byte sequence in half
+    while (n > 0 && ((uint8_t)s[n] & 0xC0) == 0x80) {
+      n--;
+    }
+  }
+  memcpy(out, s, n);
+  out[n] = '\0';
+  return n + 1;
+}
+
+LibraryIndex::LibraryIndex() { detach(); }
+
+size_t LibraryIndex::encode(uint8_t *out, Kind kind, const char *id,
+                            const char *title, const char *artist) {
+  uint8_t *p = out;
+  *p++ = kind;
+  size_t idLen = strnlen(id, ID_LEN);
+  memcpy(p, id, idLen);
+  memset(p + idLen, 0, ID_LEN - idLen);
+  p += ID_LEN;
+  p += copyCut(p, title, TITLE_MAX);
+  p += copyCut(p, artist, NAME_MAX);
+  return p - out;
+}
+
+size_t LibraryIndex::tableBytes(const uint8_t *records, size_t recordBytes,
+                                Header &header, void *scratch) {
+  uint32_t *bytes = (uint32_t *)scratch;
+  uint16_t *last = (uint16_t *)(bytes + BUCKETS); // entry + 1, 0: none
+  memset(scratch, 0, SCRATCH_BYTES);
+
+  uint32_t entries = 0, playlists = 0;
+  uint16_t text[TEXT_MAX];
+  const uint8_t *end = records + recordBytes;
+  for (const uint8_t *p = records; p < end && entries < MAX_ENTRIES;
+       p = nextRecord(p)) {
+    if (p[0] == Playlist && playlists == entries) {
+      playlists++;
+    }
+    uint16_t e = entries + 1;
+    forEachKey(text, entryText(p, text), [&](uint32_t b) {
+      if (last[b] != e) { // once per entry
+        bytes[b] += varintSize(e - last[b]);
+        last[b] = e;
+      }
+    });
+    entries++;
+  }
+
+  uint32_t postings = 0;
+  for (int b = 0; b < BUCKETS; b++) {
+    postings += bytes[b];
+  }
+  header.magic = MAGIC;
+  header.size = sizeof(Header);
+  header.entries = entries;
+  header.playlists = playlists;
+  header.recordBytes = recordBytes;
+  header.tableBytes =
+      (entries + BUCKETS + 1) * sizeof(uint32_t) + postings;
+  return header.tableBytes;
+}
+
+void LibraryIndex::buildTables(const uint8_t *records, const Header &header,
+                               uint8_t *tables, void *scratch) {
+  uint32_t *offsets = (uint32_t *)tables;
+  uint32_t *buckets = offsets + header.entries;
+  uint8_t *postings = (uint8_t *)(buckets + BUCKETS + 1);
+  uint32_t *cursor = (uint32_t *)scratch; // sizes from tableBytes()
+  uint16_t *last = (uint16_t *)(cursor + BUCKETS);
+
+  uint32_t start = 0;
+  for (int b = 0; b < BUCKETS; b++) {
+    buckets[b] = start;
+    start += cursor[b];
+    cursor[b] = buckets[b];
+    last[b] = 0;
+  }
+  buckets[BUCKETS] = start;
+
+  uint16_t text[TEXT_MAX];
+  const uint8_t *p = records;
+  for (uint32_t e = 0; e < header.entries; e++, p = nextRecord(p)) {
+    offsets[e] = p - records;
+    uint16_t e1 = e + 1;
+    forEachKey(text, entryText(p, text), [&](uint32_t b) {
+      if (last[b] == e1) {
+        return;
+      }
+      uint32_t v = e1 - last[b];
+      uint8_t *out = postings + cursor[b];
+      while (v >= 0x80) {
+        *out++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+      }
+      *out++ = (uint8_t)v;
+      cursor[b] = out - postings;
+      last[b] = e1;
+    });
+  }
+}
+
+bool LibraryIndex::valid(const Header &header, const uint8_t *records,
+                         const uint8_t *tables) {
+  size_t fixed = ((size_t)header.entries + BUCKETS + 1) * sizeof(uint32_t);
+  if (header.entries > (uint32_t)MAX_ENTRIES ||
+      header.playlists > header.entries || header.recordBytes == 0 ||
+      header.tableBytes < fixed ||
+      // Titles and artists are read up to their NUL
+      records[header.recordBytes - 1] != '\0') {
+    return false;
+  }
+  const uint32_t *offsets = (const uint32_t *)tables;
+  for (uint32_t e = 0; e < header.entries; e++) {
+    if ((e > 0 && offsets[e] <= offsets[e - 1]) ||
+        offsets[e] + 1 + ID_LEN >= header.recordBytes) {
+      return false;
+    }
+  }
+  const uint32_t *buckets = offsets + header.entries;
+  const uint8_t *postings = (const uint8_t *)(buckets + BUCKETS + 1);
+  if (buckets[0] != 0 || buckets[BUCKETS] != header.tableBytes - fixed) {
+    return false;
+  }
+  for (int b = 0; b < BUCKETS; b++) {
+    if (buckets[b + 1] < buckets[b]) {
+      return false;
+    }
+    // Every varint ends inside its list, every entry number is in range
+    uint32_t entry = 0;
+    const uint8_t *p = postings + buckets[b];
+    const uint8_t *end = postings + buckets[b + 1];
+    while (p < end) {
+      uint32_t delta = 0;
+      int shift = 0;
+      for (;;) {
+        if (p >= end || shift > 28) {
+          return false;
+        }
+        delta |= (uint32_t)(*p & 0x7F) << shift;
+        shift += 7;
+        if (!(*p++ & 0x80)) {
+          break;
+        }
+      }
+      entry += delta;
+      if (delta == 0 || entry > header.entries) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void LibraryIndex::attach(const Header &header, const uint8_t *records,
+                          const uint8_t *tables) {
+  _header = header;
+  _records = records;
+  _offsets = (const uint32_t *)tables;
+  _buckets = _offsets + header.entries;
+  _postings = (const uint8_t *)(_buckets + BUCKETS + 1);
+}
+
+void LibraryIndex::detach() {
+  memset(&_header, 0, sizeof(_header));
+  _records = nullptr;
+  _offsets = nullptr;
+  _buckets = nullptr;
+  _postings = nullptr;
+}
+
+size_t LibraryIndex::playlistBytes() const {
+  return _header.playlists < _header.entries ? _offsets[_header.playlists]
+                                             : _header.recordBytes;
+}
+
+LibraryIndex::Kind LibraryIndex::kind(int entry) const {
+  return (Kind)_records[_offsets[entry]];
+}
+
+const char *LibraryIndex::title(int entry) const {
+  return recordTitle(_records + _offsets[entry]);
+}
+
+const char *LibraryIndex::artist(int entry) const {
+  return recordArtist(_records + _offsets[entry]);
+}
+
+void LibraryIndex::id(int entry, char *out) const {
+  memcpy(out, _records + _offsets[entry] + 1, ID_LEN);
+  out[ID_LEN] = '\0';
+}
+
+// Every word of the query in the entry's text: a one-character word at
+// the start of a word, a longer one anywhere.
+bool LibraryIndex::matches(int entry, const uint16_t *query,
+                           int length) const {
+  uint16_t text[TEXT_MAX];
+  int n = entryText(_records + _offsets[entry], text);
+  for (int w = 0; w < length;) {
+    int end = w;
+    while (end < length && query[end] != ' ') {
+      end++;
+    }
+    int len = end - w;
+    bool found = false;
+    for (int i = 0; i + len <= n && !found; i++) {
+      if (len == 1 && i > 0 && text[i - 1] != ' ') {
+        continue;
+      }
+      found = memcmp(text + i, query + w, len * sizeof(uint16_t)) == 0;
+    }
+    if (!found) {
+      return false;
+    }
+    w = end + 1;
+  }
+  return true;
+}
+
+// Reads one posting list in order.
+namespace {
+struct PostingCursor {
+  const uint8_t *p;
+  const uint8_t *end;
+  uint32_t entry; // + 1, 0 before the first
+
+  bool next() {
+    if (p >= end) {
+      return false;
+    }
+    uint32_t delta = 0;
+    int shift = 0;
+    do {
+      delta |= (uint32_t)(*p & 0x7F) << shift;
+      shift += 7;
+    } while (*p++ & 0x80);
+    entry += delta;
+    return true;
+  }
+  // To the first entry >= target
+  bool seek(uint32_t target) {
+    while (entry < target) {
+      if (!next()) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+} // namespace
+
+int LibraryIndex::search(const char *query, uint16_t *results, int max,
+                         uint32_t *checked) const {
+  if (checked != nullptr) {
+    *checked = 0;
+  }
+  if (!ready() || max <= 0) {
+    return 0;
+  }
+  uint16_t q[MAX_QUERY];
+  int n = normalize(query, q, MAX_QUERY);
+  if (n == 0) {
+    return 0;
+  }
+
+  // Every match is on the list of every key of the query: walk the
+  // shortest few together and check only entries on all of them.
+  PostingCursor lists[MAX_LISTS];
+  int listCount = 0;
+  for (int i = 0; i < n; i++) {
+    if (q[i] == ' ') {
+      continue;
+    }
+    bool wordEnd = i + 1 == n || q[i + 1] == ' ';
+    uint32_t b;
+    if (!wordEnd) {
+      b = bucketOf(q[i], q[i + 1]);
+    } else if (i == 0 || q[i - 1] == ' ') {
+      b = bucketOf(q[i], 0); // one-character word: a prefix
+    } else {
+      continue;
+    }
+    PostingCursor c = {_postings + _buckets[b], _postings + _buckets[b + 1],
+                       0};
+    bool seen = false;
+    for (int j = 0; j < listCount && !seen; j++) {
+      seen = lists[j].p == c.p;
+    }
+    if (seen) {
+      continue;
+    }
+    // Insertion by length, the longest dropped
+    int j = listCount < MAX_LISTS ? listCount++ : MAX_LISTS;
+    while (j > 0 && lists[j - 1].end - lists[j - 1].p > c.end - c.p) {
+      if (j < MAX_LISTS) {
+        lists[j] = lists[j - 1];
+      }
+      j--;
+    }
+    if (j < MAX_LISTS) {
+      lists[j] = c;
+    }
+  }
+
+  int found = 0;
+  while (found < max && lists[0].next()) {
+    uint32_t entry = lists[0].entry;
+    bool onAll = true;
+    for (int j = 1; j < listCount && onAll; j++) {
+      if (!lists[j].seek(entry)) {
+        return found; // a list ran out: nothing further matches
+      }
+      onAll = lists[j].entry == entry;
+    }
+    if (!onAll) {
+      continue;
+    }
+    if (checked != nullptr) {
+      (*checked)++;
+    }
+    if (matches(entry - 1, q, n)) {
+      results[found++] = entry - 1;
+    }
+  }
+  return found;
+}
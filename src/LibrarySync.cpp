@@ -0,0 +1,482 @@
+#include "LibrarySync.h"
+
+#include <esp_heap_caps.h>
+#include <time.h>
+
+static const char *PATH = "/library.idx";
+static const char *TEMP_PATH = "/library.tmp";
+static const char *NEW_PATH = "/library.new"; // records of a running sync
+
+static void *psramAlloc(size_t bytes) {
+  return heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+
+LibrarySync::LibrarySync(SpotifyClient &client)
+    : _indexState(IndexNone), _syncing(false) {
+  _client = &client;
+  _records = nullptr;
+  _tables = nullptr;
+  _phase = Idle;
+  _nextStepAt = 0;
+  _startedAt = 0;
+  _fileDone = 0;
+  memset(&_header, 0, sizeof(_header));
+  _full = false;
+  _offset = 0;
+  _total = 0;
+  _failures = 0;
+  _knownId[0] = '\0';
+  _knownAddedAt = 0;
+  _caughtUp = false;
+  _newSeen = 0;
+  _newestAddedAt = 0;
+  _playlistBytes = 0;
+  _playlistsSame = false;
+  _page = nullptr;
+  _pageBytes = 0;
+}
+
+bool LibrarySync::begin() {
+  _page = (uint8_t *)psramAlloc(PAGE_ITEMS * LibraryIndex::RECORD_MAX);
+  if (_page == nullptr) {
+    Serial.println("[library] no PSRAM, search disabled");
+    return false;
+  }
+  _phase = Load;
+  _nextStepAt = millis();
+  return true;
+}
+
+uint32_t LibrarySync::msUntilStep() const {
+  if (_page == nullptr) {
+    return UINT32_MAX;
+  }
+  long left = (long)(_nextStepAt - millis());
+  return left > 0 ? (uint32_t)left : 0;
+}
+
+const LibraryIndex *LibrarySync::acquire() {
+  uint8_t expected = IndexReady;
+  if (!_indexState.compare_exchange_strong(expected, IndexReading,
+                                           std::memory_order_acq_rel)) {
+    return nullptr;
+  }
+  return &_index;
+}
+
+void LibrarySync::release() {
+  uint8_t expected = IndexReading;
+  _indexState.compare_exchange_strong(expected, IndexReady,
+                                      std::memory_order_release);
+}
+
+void LibrarySync::step() {
+  switch (_phase) {
+  case Load:
+    stepLoad();
+    break;
+  case Idle:
+    startSync(fullSyncDue());
+    break;
+  case Playlists:
+  case Tracks:
+    stepFetch();
+    break;
+  case CopyOld:
+    stepCopy();
+    break;
+  case Build:
+    stepBuild();
+    break;
+  case Save:
+    stepSave();
+    break;
+  }
+}
+
+void LibrarySync::freeIndex() {
+  _index.detach();
+  free(_records);
+  free(_tables);
+  _records = nullptr;
+  _tables = nullptr;
+}
+
+// The saved index, READ_BYTES per step (records, then tables).
+void LibrarySync::stepLoad() {
+  if (!_file) {
+    _startedAt = millis();
+    _file = LittleFS.open(PATH, "r");
+    bool ok = _file &&
+              _file.read((uint8_t *)&_header, sizeof(_header)) ==
+                  sizeof(_header) &&
+              _header.magic == LibraryIndex::MAGIC &&
+              _header.size == sizeof(_header) && _header.recordBytes > 0 &&
+              _file.size() ==
+                  sizeof(_header) + _header.recordBytes + _header.tableBytes;
+    if (ok) {
+      _records = (uint8_t *)psramAlloc(_header.recordBytes);
+      _tables = (uint8_t *)psramAlloc(_header.tableBytes);
+      ok = _records != nullptr && _tables != nullptr;
+    }
+    if (!ok) {
+      if (_file) {
+        _file.close();
+        Serial.println("[library] saved index unusable, syncing anew");
+      }
+      freeIndex();
+      finish(FIRST_SYNC_MS);
+      return;
+    }
+    _fileDone = 0;
+    return;
+  }
+
+  size_t total = _header.recordBytes + _header.tableBytes;
+  uint8_t *dst;
+  size_t left;
+  if (_fileDone < _header.recordBytes) {
+    dst = _records + _fileDone;
+    left = _header.recordBytes - _fileDone;
+  } else {
+    dst = _tables + (_fileDone - _header.recordBytes);
+    left = total - _fileDone;
+  }
+  size_t n = left < READ_BYTES ? left : READ_BYTES;
+  if (_file.read(dst, n) != n) {
+    _file.close();
+    freeIndex();
+    Serial.println("[library] saved index unreadable, syncing anew");
+    finish(FIRST_SYNC_MS);
+    return;
+  }
+  _fileDone += n;
+  if (_fileDone < total) {
+    return;
+  }
+  _file.close();
+  // A damaged or stale file would send search() outside these blocks
+  if (!LibraryIndex::valid(_header, _records, _tables)) {
+    freeIndex();
+    LittleFS.remove(PATH);
+    Serial.println("[library] saved index inconsistent, syncing anew");
+    finish(FIRST_SYNC_MS);
+    return;
+  }
+  _index.attach(_header, _records, _tables);
+  _indexState.store(IndexReady, std::memory_order_release);
+  Serial.printf("[library] loaded %u playlists, %u tracks (%u KB) in %lu ms\n",
+                _header.playlists, _header.entries - _header.playlists,
+                (unsigned)(total / 1024), millis() - _startedAt);
+  finish(FIRST_SYNC_MS);
+}
+
+bool LibrarySync::fullSyncDue() const {
+  if (!_index.ready()) {
+    return true;
+  }
+  // Signed: until NTP sets the clock, time() counts from 1970 and nothing
+  // is due; a full sync dated then is due once it is set
+  int32_t age = (int32_t)((uint32_t)time(nullptr) - _index.header().fullSyncAt);
+  return age >= (int32_t)FULL_SYNC_SEC;
+}
+
+void LibrarySync::startSync(bool full) {
+  _file = LittleFS.open(NEW_PATH, "w");
+  if (!_file) {
+    abort("cannot write /library.new");
+    return;
+  }
+  _syncing.store(true, std::memory_order_relaxed);
+  _startedAt = millis();
+  _full = full;
+  _phase = Playlists;
+  _offset = 0;
+  _total = 0;
+  _failures = 0;
+  _caughtUp = false;
+  _newSeen = 0;
+  _playlistBytes = 0;
+  _playlistsSame = _index.ready();
+  // The index only changes on this task, so it can be read while the UI
+  // holds it
+  const LibraryIndex::Header &known = _index.header();
+  if (_index.ready() && known.entries > known.playlists) {
+    _index.id(known.playlists, _knownId);
+    _knownAddedAt = known.newestAddedAt;
+  } else {
+    _knownId[0] = '\0';
+    _knownAddedAt = 0;
+  }
+  _newestAddedAt = _knownAddedAt;
+  _nextStepAt = millis();
+}
+
+void LibrarySync::onItem(void *ctx, const LibraryItem &item) {
+  LibrarySync *self = static_cast<LibrarySync *>(ctx);
+  uint8_t *out = self->_page + self->_pageBytes;
+
+  if (self->_phase == Playlists) {
+    if (item.id == nullptr) {
+      return;
+    }
+    size_t n = LibraryIndex::encode(out, LibraryIndex::Playlist, item.id,
+                                    item.title, item.artist);
+    self->_playlistsSame =
+        self->_playlistsSame &&
+        self->_playlistBytes + n <= self->_index.playlistBytes() &&
+        memcmp(self->_records + self->_playlistBytes, out, n) == 0;
+    self->_playlistBytes += n;
+    self->_pageBytes += n;
+    return;
+  }
+
+  if (self->_caughtUp) {
+    return;
+  }
+  if (!self->_full && self->_knownId[0] != '\0' &&
+      (item.addedAt < self->_knownAddedAt ||
+       (item.id != nullptr && strcmp(item.id, self->_knownId) == 0))) {
+    self->_caughtUp = true; // the rest is in the index
+    return;
+  }
+  if (self->_newSeen++ == 0) {
+    self->_newestAddedAt = item.addedAt;
+  }
+  if (item.id != nullptr) {
+    self->_pageBytes += LibraryIndex::encode(out, LibraryIndex::Track,
+                                             item.id, item.title, item.artist);
+  }
+}
+
+void LibrarySync::stepFetch() {
+  int total;
+  _pageBytes = 0;
+  int status =
+      _phase == Playlists
+          ? _client->getPlaylistsPage(_offset, PAGE_ITEMS, total, onItem, this)
+          : _client->getSavedTracksPage(_offset, PAGE_ITEMS, total, onItem,
+                                        this);
+  if (status != 200) {
+    if (++_failures >= MAX_FAILURES) {
+      abort("requests keep failing");
+    } else {
+      _nextStepAt = millis() + RETRY_MS;
+    }
+    return;
+  }
+  _failures = 0;
+  _total = total;
+  if (_pageBytes > 0 && _file.write(_page, _pageBytes) != _pageBytes) {
+    abort("write failed");
+    return;
+  }
+  _offset += PAGE_ITEMS;
+
+  if (_phase == Playlists) {
+    if (_offset < total) {
+      return;
+    }
+    _playlistsSame =
+        _playlistsSame && _playlistBytes == _index.playlistBytes();
+    _phase = Tracks;
+    _offset = 0;
+    return;
+  }
+  if (!_caughtUp && _offset < total) {
+    return;
+  }
+  finishFetch();
+}
+
+void LibrarySync::finishFetch() {
+  if (!_full) {
+    int expected = _newSeen + (int)_index.header().trackTotal;
+    if (expected != _total) {
+      // Tracks older than the newest known were removed: only a full pass
+      // tells which
+      Serial.printf("[library] %d saved tracks, expected %d: full sync\n",
+                    _total, expected);
+      _file.close();
+      startSync(true);
+      return;
+    }
+    if (_newSeen == 0 && _playlistsSame) {
+      _file.close();
+      LittleFS.remove(NEW_PATH);
+      Serial.printf("[library] up to date (%lu ms)\n",
+                    millis() - _startedAt);
+      finish(SYNC_INTERVAL_MS);
+      return;
+    }
+  }
+  _header.trackTotal = _total;
+  _header.newestAddedAt = _newestAddedAt;
+  _header.fullSyncAt =
+      _full ? (uint32_t)time(nullptr) : _index.header().fullSyncAt;
+  if (!_full && _index.header().entries > _index.header().playlists) {
+    _phase = CopyOld;
+    _fileDone = _index.playlistBytes();
+  } else {
+    _phase = Build;
+  }
+}
+
+// The saved tracks already in the index, after the new ones.
+void LibrarySync::stepCopy() {
+  size_t end = _index.header().recordBytes;
+  size_t n = end - _fileDone;
+  if (n > CHUNK_BYTES) {
+    n = CHUNK_BYTES;
+  }
+  if (_file.write(_records + _fileDone, n) != n) {
+    abort("write failed");
+    return;
+  }
+  _fileDone += n;
+  _nextStepAt = millis() + SAVE_GAP_MS;
+  if (_fileDone >= end) {
+    _phase = Build;
+  }
+}
+
+void LibrarySync::stepBuild() {
+  if (_indexState.load(std::memory_order_acquire) != IndexBuilding) {
+    uint8_t expected = IndexReady;
+    if (!_indexState.compare_exchange_strong(expected, IndexBuilding,
+                                             std::memory_order_acq_rel)) {
+      expected = IndexNone;
+      if (!_indexState.compare_exchange_strong(expected, IndexBuilding,
+                                               std::memory_order_acq_rel)) {
+        _nextStepAt = millis() + HELD_RETRY_MS; // search is open
+        return;
+      }
+    }
+    // The index is ours: replace it with the records just written
+    _file.close();
+    freeIndex();
+    _file = LittleFS.open(NEW_PATH, "r");
+    _header.recordBytes = _file ? _file.size() : 0;
+    _records = _header.recordBytes > 0
+                   ? (uint8_t *)psramAlloc(_header.recordBytes)
+                   : nullptr;
+    if (_records == nullptr) {
+      abort(_header.recordBytes > 0 ? "no memory for records"
+                                    : "library is empty");
+      return;
+    }
+    _fileDone = 0;
+    return;
+  }
+
+  if (_fileDone < _header.recordBytes) {
+    size_t n = _header.recordBytes - _fileDone;
+    if (n > READ_BYTES) {
+      n = READ_BYTES;
+    }
+    if (_file.read(_records + _fileDone, n) != n) {
+      abort("read failed");
+      return;
+    }
+    _fileDone += n;
+    return;
+  }
+  _file.close();
+
+  unsigned long started = micros();
+  void *scratch = psramAlloc(LibraryIndex::SCRATCH_BYTES);
+  if (scratch == nullptr) {
+    abort("no memory to build");
+    return;
+  }
+  size_t tableBytes = LibraryIndex::tableBytes(_records, _header.recordBytes,
+                                               _header, scratch);
+  _tables = (uint8_t *)psramAlloc(tableBytes);
+  if (_tables == nullptr) {
+    free(scratch);
+    abort("no memory for tables");
+    return;
+  }
+  LibraryIndex::buildTables(_records, _header, _tables, scratch);
+  free(scratch);
+  _index.attach(_header, _records, _tables);
+  _indexState.store(IndexReady, std::memory_order_release);
+
+  Serial.printf("[library] %s sync: %u playlists, %u tracks (%d new); "
+                "records %u KB + tables %u KB, built in %lu ms\n",
+                _full ? "full" : "incremental", _header.playlists,
+                _header.entries - _header.playlists, _newSeen,
+                _header.recordBytes / 1024, _header.tableBytes / 1024,
+                (micros() - started) / 1000);
+  _phase = Save;
+  _fileDone = 0;
+}
+
+// Header, records, tables; CHUNK_BYTES per step, renamed into place at the
+// end so a reset mid-save keeps the previous index.
+void LibrarySync::stepSave() {
+  if (!_file) {
+    _file = LittleFS.open(TEMP_PATH, "w");
+    if (!_file ||
+        _file.write((const uint8_t *)&_header, sizeof(_header)) !=
+            sizeof(_header)) {
+      abort("cannot write /library.tmp");
+      return;
+    }
+    _fileDone = 0;
+    _nextStepAt = millis() + SAVE_GAP_MS;
+    return;
+  }
+
+  size_t total = _header.recordBytes + _header.tableBytes;
+  const uint8_t *src = _fileDone < _header.recordBytes
+                           ? _records + _fileDone
+                           : _tables + (_fileDone - _header.recordBytes);
+  size_t left = _fileDone < _header.recordBytes
+                    ? _header.recordBytes - _fileDone
+                    : total - _fileDone;
+  size_t n = left < CHUNK_BYTES ? left : CHUNK_BYTES;
+  if (_file.write(src, n) != n) {
+    abort("write failed");
+    return;
+  }
+  _fileDone += n;
+  _nextStepAt = millis() + SAVE_GAP_MS;
+  if (_fileDone < total) {
+    return;
+  }
+
+  _file.close();
+  LittleFS.remove(PATH);
+  bool ok = LittleFS.rename(TEMP_PATH, PATH);
+  LittleFS.remove(NEW_PATH);
+  Serial.printf("[library] %s %u KB; sync took %lu s\n",
+                ok ? "saved" : "save failed",
+                (unsigned)((sizeof(_header) + total) / 1024),
+                (millis() - _startedAt) / 1000);
+  finish(SYNC_INTERVAL_MS);
+}
+
+void LibrarySync::finish(unsigned long nextSyncMs) {
+  _syncing.store(false, std::memory_order_relaxed);
+  _phase = Idle;
+  _nextStepAt = millis() + nextSyncMs;
+}
+
+void LibrarySync::abort(const char *why) {
+  if (_file) {
+    _file.close();
+  }
+  LittleFS.remove(NEW_PATH);
+  LittleFS.remove(TEMP_PATH);
+  // A rebuild that failed has already dropped the old index
+  uint8_t expected = IndexBuilding;
+  if (_indexState.compare_exchange_strong(expected, IndexNone,
+                                          std::memory_order_acq_rel)) {
+    freeIndex();
+  }
+  Serial.printf("[library] sync stopped: %s\n", why);
+  _syncing.store(false, std::memory_order_relaxed);
+  _phase = Idle;
+  _nextStepAt = millis() + ABORT_RETRY_MS;
+}
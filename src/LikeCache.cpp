@@ -0,0 +1,62 @@
+#include "LikeCache.h"
+
+#include <string.h>
+
+LikeCache::LikeCache() {
+  clear();
+  _hits = 0;
+  _misses = 0;
+}
+
+void LikeCache::clear() { memset(_entries, 0, sizeof(_entries)); }
+
+int LikeCache::find(const char *trackId) const {
+  for (int i = 0; i < CAPACITY; i++) {
+    if (_entries[i].id[0] != '\0' &&
+        strncmp(_entries[i].id, trackId, ID_SIZE) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool LikeCache::lookup(const char *trackId, unsigned long now, bool &liked) {
+  int i = find(trackId);
+  if (i < 0 || now - _entries[i].storedAt > TTL_MS) {
+    _misses++;
+    return false;
+  }
+  _hits++;
+  liked = _entries[i].liked;
+  return true;
+}
+
+bool LikeCache::contains(const char *trackId, unsigned long now) const {
+  int i = find(trackId);
+  return i >= 0 && now - _entries[i].storedAt <= TTL_MS;
+}
+
+void LikeCache::store(const char *trackId, bool liked, unsigned long now) {
+  if (trackId == nullptr || trackId[0] == '\0' ||
+      strlen(trackId) >= (size_t)ID_SIZE) {
+    return;
+  }
+
+  int slot = find(trackId);
+  if (slot < 0) {
+    // Free slot, else the oldest entry
+    slot = 0;
+    for (int i = 0; i < CAPACITY; i++) {
+      if (_entries[i].id[0] == '\0') {
+        slot = i;
+        break;
+      }
+      if (now - _entries[i].storedAt > now - _entries[slot].storedAt) {
+        slot = i;
+      }
+    }
+    strcpy(_entries[slot].id, trackId);
+  }
+  _entries[slot].liked = liked;
+  _entries[slot].storedAt = now;
+}
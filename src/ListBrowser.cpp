@@ -0,0 +1,490 @@
+#include "ListBrowser.h"
+
+#include <esp_heap_caps.h>
+#include <math.h>
+#include <new>
+
+#include "ArtCache.h"
+#include "ScreenStyle.h"
+#include "Telemetry.h"
+
+// Row text palette (2 bpp)
+static const int INK_BG = 0;
+static const int INK_TITLE = 1;
+static const int INK_ARTIST = 2;
+static const int INK_RULE = 3;
+static const int TITLE_Y = 5;
+static const int ARTIST_Y = 25;
+
+ThumbCache::ThumbCache() { _pixels = nullptr; }
+
+bool ThumbCache::begin() {
+  _pixels = (uint16_t *)heap_caps_malloc(SLOTS * BYTES,
+                                         MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  return _pixels != nullptr && _slots.begin(SLOTS);
+}
+
+const uint16_t *ThumbCache::find(const char *url) {
+  if (_pixels == nullptr) {
+    return nullptr;
+  }
+  int slot = _slots.find(url);
+  return slot >= 0 ? _pixels + slot * SIZE * SIZE : nullptr;
+}
+
+void ThumbCache::insert(const char *url, const uint16_t *pixels, int stride) {
+  if (_pixels == nullptr || url[0] == '\0') {
+    return;
+  }
+  bool evicted;
+  int slot = _slots.claim(url, evicted);
+  if (slot < 0) {
+    return;
+  }
+
+  uint16_t *dst = _pixels + slot * SIZE * SIZE;
+  if (pixels == nullptr) {
+    // Stored byte-swapped, like the tiles
+    uint16_t swapped = __builtin_bswap16(SCREEN_DIM);
+    for (int i = 0; i < SIZE * SIZE; i++) {
+      dst[i] = swapped;
+    }
+    return;
+  }
+  for (int y = 0; y < SIZE; y++) {
+    memcpy(dst + y * SIZE, pixels + y * stride, SIZE * sizeof(uint16_t));
+  }
+}
+
+RowCache::RowCache() {
+  for (int i = 0; i < SLOTS; i++) {
+    _index[i] = -1;
+    _lastUsed[i] = 0;
+  }
+  _useClock = 0;
+  _w = 0;
+  _h = 0;
+  _ready = false;
+}
+
+bool RowCache::begin(int w, int h) {
+  _w = w;
+  _h = h;
+  for (int i = 0; i < SLOTS; i++) {
+    _sprites[i].setColorDepth(2);
+    _sprites[i].setPsram(true);
+    if (!_sprites[i].createSprite(w, h)) {
+      return false;
+    }
+    _sprites[i].createPalette();
+  }
+  _ready = true;
+  return true;
+}
+
+void RowCache::clear() {
+  for (int i = 0; i < SLOTS; i++) {
+    _index[i] = -1;
+    _lastUsed[i] = 0;
+  }
+}
+
+M5Canvas *RowCache::find(int index) {
+  for (int i = 0; i < SLOTS; i++) {
+    if (_index[i] == index) {
+      _lastUsed[i] = ++_useClock;
+      return &_sprites[i];
+    }
+  }
+  return nullptr;
+}
+
+M5Canvas *RowCache::claim(int index) {
+  if (!_ready) {
+    return nullptr;
+  }
+  int lru = 0;
+  for (int i = 1; i < SLOTS; i++) {
+    if (_lastUsed[i] < _lastUsed[lru]) {
+      lru = i;
+    }
+  }
+  _index[lru] = index;
+  _lastUsed[lru] = ++_useClock;
+  return &_sprites[lru];
+}
+
+ListBrowser::ListBrowser(NetworkTask &net, ArtPrefetcher &art)
+    : _header(0, 0, 320, HEADER_H), _list(0, HEADER_H, 320, 240 - HEADER_H) {
+  _net = &net;
+  _art = &art;
+  _open = false;
+  _source = ListSource::Queue;
+  _status = 0;
+  _scrollY = 0;
+  _velocity = 0;
+  _dragging = false;
+  _dragLastY = 0;
+  _dragLastAt = 0;
+  _pendingOffset = -1;
+  _pendingAt = 0;
+  _retryAt = 0;
+  _thumbRequestedAt = 0;
+  _dirty = false;
+  _drawnTotal = -2;
+}
+
+bool ListBrowser::begin() {
+  _header.begin(false);
+  _list.begin(true);
+  _compositor.addLayer(_header);
+  _compositor.addLayer(_list);
+  _titleWidths.begin(measureCanvasGlyph, &_header.canvas());
+  _artistWidths.begin(measureCanvasGlyph, &_header.canvas());
+
+  void *mem = heap_caps_malloc(WINDOW_PAGES * sizeof(ListPage),
+                               MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (mem == nullptr) {
+    Serial.printf("[list] no PSRAM for %d pages\n", WINDOW_PAGES);
+    return false;
+  }
+  ListPage *pages = static_cast<ListPage *>(mem);
+  for (int i = 0; i < WINDOW_PAGES; i++) {
+    new (&pages[i]) ListPage();
+  }
+  _window.begin(pages, WINDOW_PAGES);
+  bool ok = _rows.begin(320 - TEXT_X, ROW_H) && _thumbs.begin();
+
+  size_t layers = (size_t)320 * 240 * sizeof(uint16_t);
+  Serial.printf("[list] memory: pages %u B, row text %u B, covers %u B, "
+                "layers %u B; %d rows x %d B each\n",
+                (unsigned)_window.bytes(), (unsigned)_rows.bytes(),
+                (unsigned)_thumbs.bytes(), (unsigned)layers,
+                WINDOW_PAGES * ListPage::ROWS, (int)sizeof(ListRow));
+  return ok;
+}
+
+void ListBrowser::open(ListSource source) {
+  _open = true;
+  _source = source;
+  _status = 0;
+  _window.reset();
+  _rows.clear();
+  _scrollY = 0;
+  _velocity = 0;
+  _dragging = false;
+  _pendingOffset = -1;
+  _retryAt = 0;
+  _thumbPending.clear();
+  _dirty = true;
+  _drawnTotal = -2;
+  drawHeader();
+  _compositor.invalidate();
+}
+
+void ListBrowser::scrollTo(float y) {
+  int total = _window.total();
+  float max = total > 0 ? (float)total * ROW_H - listHeight() : 0;
+  if (max < 0) {
+    max = 0;
+  }
+  if (y > max) {
+    y = max;
+    _velocity = 0;
+  }
+  if (y < 0) {
+    y = 0;
+    _velocity = 0;
+  }
+  _scrollY = y;
+}
+
+void ListBrowser::drag(int y) {
+  unsigned long now = millis();
+  if (!_dragging) {
+    _dragging = true;
+    _velocity = 0;
+  } else {
+    int dy = _dragLastY - y;
+    scrollTo(_scrollY + dy);
+    unsigned long dt = now - _dragLastAt;
+    if (dt > 0) {
+      // Smoothed, so the last jittery sample doesn't decide the fling
+      float instant = (float)dy * FRAME_MS / dt;
+      _velocity = 0.5f * _velocity + 0.5f * instant;
+    }
+  }
+  _dragLastY = y;
+  _dragLastAt = now;
+}
+
+void ListBrowser::release() {
+  _dragging = false;
+  // A finger held still before lifting doesn't fling
+  if (millis() - _dragLastAt > 100 || fabsf(_velocity) < SETTLED_SPEED) {
+    _velocity = 0;
+  }
+}
+
+ListBrowser::Action ListBrowser::tap(int x, int y, int &row) {
+  if (y < HEADER_H) {
+    if (x < 100) {
+      return Close;
+    }
+    return x >= 220 ? Switch : NoAction;
+  }
+  if (fabsf(_velocity) >= SETTLED_SPEED) {
+    _velocity = 0;
+    return NoAction;
+  }
+  int index = ((int)_scrollY + y - HEADER_H) / ROW_H;
+  if (index >= _window.total() || _window.row(index) == nullptr) {
+    return NoAction;
+  }
+  row = index;
+  return Play;
+}
+
+void ListBrowser::takePage() {
+  const ListPage *page = _net->takePage();
+  if (page == nullptr) {
+    return;
+  }
+  // Pages for a list closed or switched away from are dropped
+  if (page->source == _source && page->offset == _pendingOffset) {
+    _pendingOffset = -1;
+    _status = page->status;
+    if (page->status == 200) {
+      _window.insert(*page, (int)_scrollY / ROW_H);
+    } else if (page->status != 204) {
+      _retryAt = millis() + PAGE_RETRY_MS;
+    }
+    _dirty = true;
+  }
+  _net->releasePage();
+}
+
+void ListBrowser::takeThumb() {
+  if (_thumbPending.isEmpty()) {
+    return;
+  }
+  bool preview;
+  const uint16_t *tile = _art->take(_thumbPending.c_str(), preview);
+  if (tile != nullptr) {
+    _thumbs.insert(_thumbPending.c_str(), tile, ArtCache::TILE_SIZE);
+    _art->release();
+  } else if (millis() - _thumbRequestedAt >= THUMB_TIMEOUT_MS) {
+    _thumbs.insert(_thumbPending.c_str(), nullptr, 0);
+  } else {
+    return;
+  }
+  _thumbPending.clear();
+  _dirty = true;
+}
+
+void ListBrowser::requestPage(int first, int last) {
+  if (_status == 204) {
+    return; // nothing to list
+  }
+  unsigned long now = millis();
+  // One page in flight at a time
+  if (_pendingOffset >= 0 && now - _pendingAt < PAGE_TIMEOUT_MS) {
+    return;
+  }
+  if ((long)(_retryAt - now) > 0) {
+    return;
+  }
+  int offset = _window.wanted(first, last);
+  if (offset >= 0 && _net->requestPage(_source, offset)) {
+    _pendingOffset = offset;
+    _pendingAt = now;
+  }
+}
+
+void ListBrowser::requestThumb(int first, int last) {
+  // Covers wait until scrolling settles; the art task is shared with the
+  // now-playing screen
+  if (_dragging || fabsf(_velocity) >= SETTLED_SPEED ||
+      !_thumbPending.isEmpty()) {
+    return;
+  }
+  for (int i = first; i <= last; i++) {
+    const ListRow *row = _window.row(i);
+    if (row == nullptr || row->thumbUrl.isEmpty() ||
+        _thumbs.find(row->thumbUrl.c_str()) != nullptr) {
+      continue;
+    }
+    _art->thumbnail(row->thumbUrl.c_str(), ThumbCache::SIZE);
+    _thumbPending = row->thumbUrl.c_str();
+    _thumbRequestedAt = millis();
+    return;
+  }
+}
+
+void ListBrowser::tick() {
+  if (!_open) {
+    return;
+  }
+  takePage();
+  takeThumb();
+
+  int drawnTop = (int)_scrollY;
+  if (!_dragging && _velocity != 0) {
+    scrollTo(_scrollY + _velocity);
+    _velocity *= FLING_DECAY;
+    if (fabsf(_velocity) < 0.5f) {
+      _velocity = 0;
+    }
+  }
+  int top = (int)_scrollY;
+  int first = top / ROW_H;
+  int last = (top + listHeight() - 1) / ROW_H;
+  requestPage(first, last);
+  requestThumb(first, last);
+
+  if (_window.total() != _drawnTotal) {
+    drawHeader();
+  }
+  if (_dirty || top != drawnTop) {
+    drawList(first, last);
+  }
+}
+
+void ListBrowser::render() {
+  if (_open) {
+    _compositor.flush();
+  }
+}
+
+void ListBrowser::drawHeader() {
+  M5Canvas &g = _header.canvas();
+  g.fillScreen(SCREEN_HEADER_BG);
+  g.setFont(&fonts::lgfxJapanGothicP_16);
+  g.setTextColor(TFT_WHITE, SCREEN_HEADER_BG);
+  g.setTextDatum(middle_left);
+  g.drawString("< Back", 6, HEADER_H / 2);
+  g.setTextDatum(middle_right);
+  g.drawString(_source == ListSource::Queue ? "Playlist >" : "Queue >",
+               314, HEADER_H / 2);
+
+  char title[32];
+  const char *name = _source == ListSource::Queue ? "Queue" : "Playlist";
+  int total = _window.total();
+  if (total >= 0) {
+    snprintf(title, sizeof(title), "%s (%d)", name, total);
+  } else {
+    snprintf(title, sizeof(title), "%s", name);
+  }
+  g.setTextDatum(middle_center);
+  g.drawString(title, 160, HEADER_H / 2);
+  g.setTextDatum(top_left);
+  _header.markAllDirty();
+  _drawnTotal = total;
+}
+
+void ListBrowser::drawMessage(const char *message) {
+  M5Canvas &g = _list.canvas();
+  g.fillScreen(TFT_BLACK);
+  g.setFont(&fonts::lgfxJapanGothicP_16);
+  g.setTextColor(TFT_LIGHTGREY, TFT_BLACK);
+  g.setTextDatum(middle_center);
+  g.drawString(message, 160, listHeight() / 2);
+  g.setTextDatum(top_left);
+  _list.markAllDirty();
+}
+
+void ListBrowser::drawList(int first, int last) {
+  StageTimer timer(Stage::ListFrame);
+  _dirty = false;
+  int total = _window.total();
+  if (total <= 0) {
+    char message[40];
+    if (_status == 204 || total == 0) {
+      drawMessage(_source == ListSource::Queue ? "Queue is empty"
+                                               : "Not playing a playlist");
+    } else if (_status != 0 && _status != 200) {
+      snprintf(message, sizeof(message), "Couldn't load (%d)", _status);
+      drawMessage(message);
+    } else {
+      drawMessage("Loading...");
+    }
+    return;
+  }
+
+  M5Canvas &g = _list.canvas();
+  int top = (int)_scrollY;
+  int renders = 0;
+  for (int i = first; i <= last && i < total; i++) {
+    if (!drawRow(g, i, i * ROW_H - top, renders)) {
+      _dirty = true; // finish it next frame
+    }
+  }
+  int bottom = total * ROW_H - top;
+  if (bottom < listHeight()) {
+    g.fillRect(0, bottom, 320, listHeight() - bottom, TFT_BLACK);
+  }
+  _list.markAllDirty();
+}
+
+// One row at y (may be partly off the layer); false if its text is loaded
+// but waits for a later frame's render budget.
+bool ListBrowser::drawRow(M5Canvas &g, int index, int y, int &renders) {
+  const ListRow *row = _window.row(index);
+  g.fillRect(0, y, TEXT_X, ROW_H, TFT_BLACK);
+  const uint16_t *thumb = row != nullptr && !row->thumbUrl.isEmpty()
+                              ? _thumbs.find(row->thumbUrl.c_str())
+                              : nullptr;
+  int thumbY = y + (ROW_H - ThumbCache::SIZE) / 2;
+  if (thumb != nullptr) {
+    g.pushImage(THUMB_X, thumbY, ThumbCache::SIZE, ThumbCache::SIZE,
+                (const lgfx::swap565_t *)thumb);
+  } else {
+    g.fillRect(THUMB_X, thumbY, ThumbCache::SIZE, ThumbCache::SIZE,
+               SCREEN_DIM);
+  }
+
+  M5Canvas *text = _rows.find(index);
+  if (text == nullptr && row != nullptr && renders < MAX_ROW_RENDERS) {
+    text = renderRow(index, *row);
+    renders++;
+  }
+  if (text != nullptr) {
+    text->pushSprite(&g, TEXT_X, y);
+    return true;
+  }
+  g.fillRect(TEXT_X, y, 320 - TEXT_X, ROW_H, TFT_BLACK);
+  g.fillRect(TEXT_X + 2, y + TITLE_Y + 3, 140, 10, SCREEN_DIM);
+  g.fillRect(TEXT_X + 2, y + ARTIST_Y + 2, 90, 8, SCREEN_DIM);
+  return row == nullptr; // redrawn when its page arrives
+}
+
+M5Canvas *ListBrowser::renderRow(int index, const ListRow &row) {
+  M5Canvas *s = _rows.claim(index);
+  if (s == nullptr) {
+    return nullptr;
+  }
+  s->setPaletteColor(INK_BG, TFT_BLACK);
+  s->setPaletteColor(INK_TITLE, TFT_WHITE);
+  s->setPaletteColor(INK_ARTIST, TFT_LIGHTGREY);
+  s->setPaletteColor(INK_RULE, SCREEN_DIM);
+  s->fillScreen(INK_BG);
+
+  // Widths are measured on the header canvas, set to the same font
+  char line[TextLayout::LINE_BYTES];
+  int width = s->width() - 4;
+  s->setFont(&fonts::lgfxJapanGothicP_16);
+  _header.canvas().setFont(&fonts::lgfxJapanGothicP_16);
+  s->setTextColor(INK_TITLE, INK_BG);
+  s->drawString(_layout.fitLine(row.title.c_str(), _titleWidths, width, line),
+                0, TITLE_Y);
+
+  s->setFont(&fonts::lgfxJapanGothicP_12);
+  _header.canvas().setFont(&fonts::lgfxJapanGothicP_12);
+  s->setTextColor(INK_ARTIST, INK_BG);
+  s->drawString(
+      _layout.fitLine(row.artist.c_str(), _artistWidths, width, line), 0,
+      ARTIST_Y);
+
+  s->drawFastHLine(0, ROW_H - 1, s->width(), INK_RULE);
+  return s;
+}
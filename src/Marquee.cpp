@@ -0,0 +1,92 @@
+#include "Marquee.h"
+
+Marquee::Marquee() {
+  _allocated = false;
+  _active = false;
+  _period = 0;
+  _w = 0;
+  _h = 0;
+  _x = 0;
+  _y = 0;
+  _offset = 0;
+  _hold = 0;
+}
+
+bool Marquee::begin() {
+  // Two palette entries, set per text: 6 KB instead of 96 KB at 16 bpp
+  _strip.setColorDepth(1);
+  _strip.setPsram(true);
+  if (_strip.createSprite(MAX_WIDTH, MAX_HEIGHT) == nullptr) {
+    Serial.println("[marquee] strip allocation failed");
+    return false;
+  }
+  _strip.createPalette();
+  _allocated = true;
+  return true;
+}
+
+bool Marquee::set(const char *text, const lgfx::IFont *font, uint16_t fg,
+                  uint16_t bg, int w) {
+  _active = false;
+  if (!_allocated) {
+    return false;
+  }
+  _strip.setFont(font);
+  _strip.setTextSize(1.0);
+  _strip.setTextWrap(false);
+  if (_strip.fontHeight() > MAX_HEIGHT) {
+    return false;
+  }
+  _strip.setPaletteColor(0, bg);
+  _strip.setPaletteColor(1, fg);
+  _strip.fillScreen(0);
+  _strip.setTextColor(1, 0);
+  _strip.drawString(text, 0, 0);
+
+  int textW = _strip.textWidth(text);
+  if (textW > MAX_WIDTH - GAP) {
+    textW = MAX_WIDTH - GAP;
+    _strip.fillRect(textW, 0, GAP, MAX_HEIGHT, 0); // keep the gap blank
+  }
+  _period = textW + GAP;
+  _w = w;
+  _h = _strip.fontHeight();
+  _offset = 0;
+  _hold = HOLD_FRAMES;
+  _active = true;
+  return true;
+}
+
+void Marquee::draw(Layer &layer, int x, int y) {
+  if (!_active) {
+    return;
+  }
+  _x = x;
+  _y = y;
+  M5Canvas &g = layer.canvas();
+  g.setClipRect(x, y, _w, _h);
+  // The strip, then its start again once the end has scrolled in
+  _strip.pushSprite(&g, x - _offset, y);
+  if (_period - _offset < _w) {
+    _strip.pushSprite(&g, x - _offset + _period, y);
+  }
+  g.clearClipRect();
+  layer.markDirty(x, y, _w, _h);
+}
+
+bool Marquee::tick(Layer &layer) {
+  if (!_active) {
+    return false;
+  }
+  if (_hold > 0) {
+    _hold--;
+    return false;
+  }
+  _offset += STEP_PX;
+  if (_offset >= _period) {
+    _offset = 0;
+    _hold = HOLD_FRAMES;
+  }
+  draw(layer, _x, _y);
+  return true;
+}
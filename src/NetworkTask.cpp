@@ -0,0 +1,510 @@
+#include "NetworkTask.h"
+
+#include <esp_heap_caps.h>
+#include <new>
+
+#include "Telemetry.h"
+
+NetworkTask::NetworkTask(SpotifyClient &client, ArtPrefetcher &prefetcher)
+    : _busy(false), _pageState(PageEmpty) {
+  _client = &client;
+  _prefetcher = &prefetcher;
+  _library = nullptr;
+  _queue = nullptr;
+  _task = nullptr;
+  _commandsPosted = 0;
+  _lastPostedAt = 0;
+  _likeCheckNeeded = false;
+  _queueCheckNeeded = false;
+  _upcomingCount = 0;
+  _nextPollAt = 0;
+  _pollCount = 0;
+  _pollReportAt = POLL_REPORT_INTERVAL;
+  _page = nullptr;
+}
+
+bool NetworkTask::begin(BaseType_t core) {
+  _queue = xQueueCreate(QUEUE_LENGTH, sizeof(NetCommand));
+  void *page = heap_caps_malloc(sizeof(ListPage),
+                                MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (_queue == nullptr || page == nullptr) {
+    return false;
+  }
+  _page = new (page) ListPage();
+  // Priority 1 matches loopTask, so the UI core is never preempted by us.
+  if (xTaskCreatePinnedToCore(taskEntry, "net", STACK_SIZE, this, 1, &_task,
+                              core) != pdPASS) {
+    return false;
+  }
+  Telemetry::registerTask("net", _task);
+  return true;
+}
+
+bool NetworkTask::post(NetCommandType type, const char *trackId) {
+  NetCommand cmd;
+  cmd.type = type;
+  cmd.trackId[0] = '\0';
+  cmd.value = 0;
+  if (trackId != nullptr) {
+    strlcpy(cmd.trackId, trackId, sizeof(cmd.trackId));
+  }
+  return send(cmd);
+}
+
+bool NetworkTask::post(NetCommandType type, int value) {
+  NetCommand cmd;
+  cmd.type = type;
+  cmd.trackId[0] = '\0';
+  cmd.value = value;
+  return send(cmd);
+}
+
+bool NetworkTask::send(NetCommand &cmd) {
+  cmd.postedAt = micros();
+  if (xQueueSend(_queue, &cmd, 0) != pdTRUE) {
+    Serial.println("[net] command queue full, dropped");
+    return false;
+  }
+  _commandsPosted++;
+  _lastPostedAt = cmd.postedAt;
+  return true;
+}
+
+bool NetworkTask::requestPage(ListSource source, int offset) {
+  NetCommand cmd;
+  cmd.type = source == ListSource::Queue ? NetCommandType::QueuePage
+                                         : NetCommandType::PlaylistPage;
+  cmd.trackId[0] = '\0';
+  cmd.value = offset;
+  cmd.postedAt = micros();
+  // Not counted in _commandsPosted: no snapshot waits for it
+  return xQueueSend(_queue, &cmd, 0) == pdTRUE;
+}
+
+const ListPage *NetworkTask::takePage() {
+  uint8_t expected = PageReady;
+  if (!_pageState.compare_exchange_strong(expected, PageReading,
+                                          std::memory_order_acq_rel)) {
+    return nullptr;
+  }
+  return _page;
+}
+
+void NetworkTask::releasePage() {
+  _pageState.store(PageEmpty, std::memory_order_release);
+}
+
+bool NetworkTask::poll(PlayerSnapshot &out) {
+  if (!_snapshots.consume()) {
+    return false;
+  }
+  out = _snapshots.readSlot();
+  return true;
+}
+
+void NetworkTask::taskEntry(void *arg) {
+  static_cast<NetworkTask *>(arg)->run();
+}
+
+void NetworkTask::run() {
+  for (;;) {
+    // Token renewal happens here, between requests, so no poll or command
+    // ever waits on it.
+    uint32_t tokenWait = _client->maintainToken();
+    unsigned long now = millis();
+    uint32_t pollWait = 0;
+    if ((long)(_nextPollAt - now) > 0) {
+      pollWait = _nextPollAt - now;
+    }
+    // A library step only runs with time for it before the next poll
+    uint32_t libraryWait = UINT32_MAX;
+    if (_library != nullptr) {
+      uint32_t left = _library->msUntilStep();
+      if (left != UINT32_MAX && left + LIBRARY_STEP_MS <= pollWait) {
+        libraryWait = left;
+      }
+    }
+    uint32_t waitMs = tokenWait < pollWait ? tokenWait : pollWait;
+    if (libraryWait < waitMs) {
+      waitMs = libraryWait;
+    }
+    TickType_t wait = pdMS_TO_TICKS(waitMs);
+
+    NetCommand cmd;
+    if (xQueueReceive(_queue, &cmd, wait) == pdTRUE) {
+      CommandBatch batch;
+      collect(cmd, batch);
+      _busy.store(true, std::memory_order_relaxed);
+      if (batch.pageSource >= 0) {
+        fetchPage((ListSource)batch.pageSource, batch.pageOffset);
+      }
+      if (batch.count == 0) {
+        _busy.store(false, std::memory_order_relaxed);
+        continue; // only list pages: the player is as it was
+      }
+      execute(batch);
+      _busy.store(false, std::memory_order_relaxed);
+      Telemetry::record(Stage::CommandAck, micros() - batch.firstPostedAt);
+      _state.commandsApplied += batch.count;
+      publish();
+      // Spotify needs a moment before currently_playing reflects the
+      // command, then re-sync right away instead of waiting a full interval.
+      _scheduler.onCommand();
+      _nextPollAt = millis() + COMMAND_SETTLE_MS;
+      continue;
+    }
+    if ((long)(_nextPollAt - millis()) > 0) {
+      if (_library != nullptr && _library->msUntilStep() == 0 &&
+          (long)(_nextPollAt - millis()) >= (long)LIBRARY_STEP_MS) {
+        _busy.store(true, std::memory_order_relaxed);
+        _library->step();
+        _busy.store(false, std::memory_order_relaxed);
+      }
+      continue; // woke up for the token or the library
+    }
+
+    _busy.store(true, std::memory_order_relaxed);
+    refreshNowPlaying();
+    _busy.store(false, std::memory_order_relaxed);
+    schedulePoll();
+  }
+}
+
+void NetworkTask::schedulePoll() {
+  PollScheduler::Mode prevMode = _scheduler.mode();
+  uint32_t delayMs = _scheduler.onPoll(_state.status, _state.isPlaying,
+                                       _state.progressMs, _state.track.durationMs,
+                                       _client->retryAfterMs());
+  unsigned long now = millis();
+  _nextPollAt = now + delayMs;
+  _pollCount++;
+
+  if (_scheduler.mode() != prevMode) {
+    Serial.printf("[poll] %s, next in %u ms\n",
+                  PollScheduler::modeName(_scheduler.mode()), delayMs);
+  }
+  if ((long)(now - _pollReportAt) >= 0) {
+    Serial.printf("[poll] %u polls in the last %lu min\n", _pollCount,
+                  POLL_REPORT_INTERVAL / 60000);
+    _pollCount = 0;
+    _pollReportAt = now + POLL_REPORT_INTERVAL;
+  }
+}
+
+void NetworkTask::collect(const NetCommand &first, CommandBatch &batch) {
+  merge(first, batch);
+
+  unsigned long deadline = millis() + COALESCE_MS;
+  NetCommand cmd;
+  for (;;) {
+    long left = (long)(deadline - millis());
+    if (left <= 0 ||
+        xQueueReceive(_queue, &cmd, pdMS_TO_TICKS(left)) != pdTRUE) {
+      break;
+    }
+    merge(cmd, batch);
+  }
+}
+
+void NetworkTask::merge(const NetCommand &cmd, CommandBatch &batch) {
+  if (cmd.type == NetCommandType::QueuePage ||
+      cmd.type == NetCommandType::PlaylistPage) {
+    // The latest request is where the user is now
+    batch.pageSource = (int)(cmd.type == NetCommandType::QueuePage
+                                 ? ListSource::Queue
+                                 : ListSource::Playlist);
+    batch.pageOffset = cmd.value;
+    return;
+  }
+  if (batch.count++ == 0) {
+    batch.firstPostedAt = cmd.postedAt;
+  }
+  switch (cmd.type) {
+  case NetCommandType::Play:
+    batch.playing = 1;
+    break;
+  case NetCommandType::Pause:
+    batch.playing = 0;
+    break;
+  case NetCommandType::Next:
+    batch.skips++;
+    batch.seekMs = -1;
+    break;
+  case NetCommandType::Previous:
+    // Right after a skip, previous goes back to where the burst started
+    if (batch.skips > 0) {
+      batch.skips--;
+    } else {
+      batch.previous++;
+    }
+    batch.seekMs = -1;
+    break;
+  case NetCommandType::Seek:
+    batch.seekMs = cmd.value;
+    break;
+  case NetCommandType::Volume:
+    batch.volume = cmd.value;
+    break;
+  case NetCommandType::Like:
+  case NetCommandType::Unlike:
+    // Only the last state per track matters; a different track (after a
+    // skip) can't be merged, so the pending one is sent first.
+    if (batch.liked >= 0 && strcmp(batch.likeTrackId, cmd.trackId) != 0 &&
+        !setLiked(batch.likeTrackId, batch.liked == 1)) {
+      _state.commandsFailed++;
+    }
+    strlcpy(batch.likeTrackId, cmd.trackId, sizeof(batch.likeTrackId));
+    batch.liked = cmd.type == NetCommandType::Like ? 1 : 0;
+    break;
+  case NetCommandType::PlayQueued:
+    // There is no call to jump into the queue: skip through it
+    batch.skips += cmd.value + 1;
+    batch.seekMs = -1;
+    break;
+  case NetCommandType::PlayInPlaylist:
+    batch.playlistPosition = cmd.value;
+    batch.playUri = -1;
+    batch.skips = 0;
+    batch.previous = 0;
+    batch.seekMs = -1;
+    break;
+  case NetCommandType::PlayTrack:
+  case NetCommandType::PlayPlaylist:
+    batch.playUri = (int8_t)cmd.type;
+    strlcpy(batch.playId, cmd.trackId, sizeof(batch.playId));
+    batch.playlistPosition = -1;
+    batch.skips = 0;
+    batch.previous = 0;
+    batch.seekMs = -1;
+    break;
+  case NetCommandType::Refresh:
+  case NetCommandType::QueuePage:
+  case NetCommandType::PlaylistPage:
+    break;
+  }
+}
+
+void NetworkTask::execute(const CommandBatch &batch) {
+  uint32_t failed = 0;
+
+  if (batch.playlistPosition >= 0) {
+    if (_client->playInContext(_listContext.c_str(), batch.playlistPosition)) {
+      _state.isPlaying = true;
+    } else {
+      failed++;
+    }
+  }
+  if (batch.playUri >= 0) {
+    bool ok;
+    if (batch.playUri == (int8_t)NetCommandType::PlayTrack) {
+      ok = _client->playTrack(batch.playId);
+    } else {
+      char uri[64];
+      snprintf(uri, sizeof(uri), "spotify:playlist:%s", batch.playId);
+      ok = _client->playInContext(uri, 0);
+    }
+    if (ok) {
+      _state.isPlaying = true;
+    } else {
+      failed++;
+    }
+  }
+
+  for (int i = 0; i < batch.previous; i++) {
+    if (!_client->previous()) {
+      failed++;
+    }
+  }
+
+  int skipped = 0;
+  for (int i = 0; i < batch.skips; i++) {
+    if (!_client->next()) {
+      failed++;
+      break;
+    }
+    skipped++;
+  }
+  // Show the prefetched track right away; the next poll confirms it (or
+  // corrects it after a multi-skip).
+  if (skipped > 0 && !_state.next.id.isEmpty()) {
+    advanceToNext();
+  }
+
+  if (batch.seekMs >= 0) {
+    if (_client->seek(batch.seekMs)) {
+      _state.progressMs = batch.seekMs;
+      _state.fetchedAt = millis(); // the UI extrapolates from here
+    } else {
+      failed++;
+    }
+  }
+
+  if (batch.volume >= 0 && batch.volume != _state.volumePercent) {
+    if (_client->setVolume(batch.volume)) {
+      _state.volumePercent = batch.volume;
+    } else {
+      failed++;
+    }
+  }
+
+  if (batch.playing >= 0 && (batch.playing == 1) != _state.isPlaying) {
+    bool play = batch.playing == 1;
+    if (play ? _client->play() : _client->pause()) {
+      _state.isPlaying = play;
+    } else {
+      failed++;
+    }
+  }
+
+  if (batch.liked >= 0) {
+    bool liked = batch.liked == 1;
+    bool unchanged = _state.likeKnown && _state.isLiked == liked &&
+                     _state.track.id == batch.likeTrackId;
+    if (!unchanged && !setLiked(batch.likeTrackId, liked)) {
+      failed++;
+    }
+  }
+
+  if (failed > 0) {
+    Serial.printf("[net] %u API calls failed (%u commands merged)\n", failed,
+                  batch.count);
+  }
+  _state.commandsFailed += failed;
+}
+
+// Fetches into the staging page once the UI has taken the previous one.
+void NetworkTask::fetchPage(ListSource source, int offset) {
+  unsigned long start = millis();
+  for (;;) {
+    uint8_t expected = PageEmpty;
+    if (_pageState.compare_exchange_strong(expected, PageLoading,
+                                           std::memory_order_acq_rel)) {
+      break;
+    }
+    if (millis() - start > PAGE_CLAIM_MS) {
+      return; // the list screen is closed; it asks again when reopened
+    }
+    vTaskDelay(pdMS_TO_TICKS(5));
+  }
+
+  ListPage &page = *_page;
+  page.source = source;
+  page.offset = offset;
+  if (source == ListSource::Queue) {
+    page.status = _client->getQueuePage(page);
+  } else {
+    if (offset == 0 || _listContext.isEmpty()) {
+      _listContext = _client->contextUri();
+    }
+    page.status =
+        _client->getPlaylistPage(_listContext.c_str(), offset, page);
+  }
+  Serial.printf("[list] %s page %d: status %d, %d of %d rows in %lu ms\n",
+                source == ListSource::Queue ? "queue" : "playlist", offset,
+                page.status, page.count, page.total, millis() - start);
+  _pageState.store(PageReady, std::memory_order_release);
+}
+
+bool NetworkTask::setLiked(const char *trackId, bool liked) {
+  bool ok = liked ? _client->likeTrack(trackId) : _client->unlikeTrack(trackId);
+  if (ok && _state.track.id == trackId) {
+    _state.isLiked = liked;
+    _state.likeKnown = true;
+  }
+  return ok;
+}
+
+void NetworkTask::refreshNowPlaying() {
+  StageTimer timer(Stage::Poll);
+  _state.status =
+      _client->getNowPlaying(_state.track, _state.isPlaying,
+                             _state.progressMs, _state.volumePercent);
+  _state.fetchedAt = millis();
+
+  if (_state.status == 200) {
+    if (_lastTrackId != _state.track.id) {
+      // Track Changed
+      _lastTrackId = _state.track.id;
+      _likeCheckNeeded = true;
+      _queueCheckNeeded = true;
+      _state.next.clear();
+      _upcomingCount = 0;
+      // Usually cached since the track was in the queue; otherwise looked
+      // up together with the new queue below.
+      _state.likeKnown =
+          _client->cachedLikeState(_state.track.id.c_str(), _state.isLiked);
+      if (!_state.likeKnown) {
+        _state.isLiked = false;
+      }
+    }
+  }
+
+  publish();
+
+  if (_state.status == 200 && _queueCheckNeeded) {
+    refreshQueue();
+  }
+  // On failure (rate limit, network) it is retried on the next poll.
+  if (_state.status == 200 && _likeCheckNeeded) {
+    refreshLikes();
+  }
+}
+
+void NetworkTask::refreshLikes() {
+  // Current track plus what is queued, in one request; the client skips
+  // ids it already has.
+  const char *ids[1 + MAX_UPCOMING];
+  int n = 0;
+  ids[n++] = _state.track.id.c_str();
+  for (int i = 0; i < _upcomingCount; i++) {
+    ids[n++] = _upcoming[i];
+  }
+  if (!_client->fetchLikeStates(ids, n)) {
+    return;
+  }
+  _likeCheckNeeded = false;
+
+  if (!_state.likeKnown) {
+    _state.likeKnown =
+        _client->cachedLikeState(_state.track.id.c_str(), _state.isLiked);
+  }
+  if (!_state.next.id.isEmpty()) {
+    _state.nextLikeKnown = _client->cachedLikeState(
+        _state.next.id.c_str(), _state.nextIsLiked);
+  }
+  publish();
+}
+
+void NetworkTask::refreshQueue() {
+  int status = _client->getNextInQueue(_state.next, _upcoming, MAX_UPCOMING,
+                                       &_upcomingCount);
+  if (status != 200 && status != 204) {
+    return; // retried on the next poll
+  }
+  _queueCheckNeeded = false;
+  _state.nextLikeKnown = false;
+  _state.nextIsLiked = false;
+  _likeCheckNeeded = true; // like states of the queued tracks
+  publish();
+
+  // Same album as now playing: the UI's art cache already has it.
+  if (!_state.next.id.isEmpty() &&
+      _state.next.artUrl != _state.track.artUrl) {
+    _prefetcher->prefetch(_state.next.artUrl.c_str());
+  }
+}
+
+void NetworkTask::advanceToNext() {
+  _state.track = _state.next;
+  _state.progressMs = 0;
+  _state.fetchedAt = millis(); // progress counts from the skip
+  _state.isLiked = _state.nextIsLiked;
+  _state.likeKnown = _state.nextLikeKnown;
+  _state.next.clear();
+  _state.nextLikeKnown = false;
+}
+
+void NetworkTask::publish() {
+  _snapshots.writeSlot() = _state;
+  _snapshots.publish();
+}
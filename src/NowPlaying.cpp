@@ -0,0 +1,27 @@
+#include "NowPlaying.h"
+
+#include "Fnv1a.h"
+
+void TrackInfo::clear() {
+  title.clear();
+  artist.clear();
+  albumName.clear();
+  artUrl.clear();
+  thumbUrl.clear();
+  id.clear();
+  durationMs = 0;
+  hash = 0;
+}
+
+void TrackInfo::updateHash() {
+  // Lengths include the NUL so field boundaries are part of the hash
+  uint32_t h = FNV1A_SEED;
+  h = fnv1a(h, title.c_str(), title.length() + 1);
+  h = fnv1a(h, artist.c_str(), artist.length() + 1);
+  h = fnv1a(h, albumName.c_str(), albumName.length() + 1);
+  h = fnv1a(h, artUrl.c_str(), artUrl.length() + 1);
+  h = fnv1a(h, thumbUrl.c_str(), thumbUrl.length() + 1);
+  h = fnv1a(h, id.c_str(), id.length() + 1);
+  h = fnv1a(h, &durationMs, sizeof(durationMs));
+  hash = h;
+}
@@ -0,0 +1,159 @@
+#include "PlayerStore.h"
+
+static const char *FIELD_NAMES[PlayerStore::FIELD_COUNT] = {
+    "art", "text", "track", "playing", "progress", "liked", "volume", "next",
+};
+static const char *SOURCE_NAMES[PlayerStore::SOURCE_COUNT] = {
+    "poll", "command", "splash",
+};
+
+int PlayerState::position(unsigned long now) const {
+  if (!isPlaying) {
+    return progressMs;
+  }
+  long progress = (long)progressMs + (long)(now - progressAt);
+  return progress > track.durationMs ? track.durationMs : (int)progress;
+}
+
+PlayerStore::PlayerStore() {
+  _editing = false;
+  _published = false;
+  _version = 0;
+  _subCount = 0;
+  for (int i = 0; i < SOURCE_COUNT; i++) {
+    _commits[i] = 0;
+  }
+  _noopCommits = 0;
+  for (int i = 0; i < FIELD_COUNT; i++) {
+    _changes[i] = 0;
+    _calls[i] = 0;
+  }
+  _countersSince = 0;
+}
+
+bool PlayerStore::subscribe(uint16_t fields, Listener listener, void *ctx) {
+  if (_subCount >= MAX_LISTENERS) {
+    return false;
+  }
+  _subs[_subCount++] = {fields, listener, ctx};
+  return true;
+}
+
+PlayerState &PlayerStore::edit() {
+  if (!_editing) {
+    _draft = _state;
+    _editing = true;
+  }
+  return _draft;
+}
+
+uint16_t PlayerStore::diff(const PlayerState &from,
+                           const PlayerState &to) const {
+  uint16_t changed = 0;
+  // Equal hashes: the whole track is unchanged (the usual poll)
+  if (from.track.hash != to.track.hash) {
+    if (from.track.artUrl != to.track.artUrl ||
+        from.track.thumbUrl != to.track.thumbUrl) {
+      changed |= Art;
+    }
+    if (from.track.title != to.track.title ||
+        from.track.artist != to.track.artist) {
+      changed |= Text;
+    }
+    if (from.track.id != to.track.id ||
+        from.track.albumName != to.track.albumName ||
+        from.track.durationMs != to.track.durationMs) {
+      changed |= Track;
+    }
+  }
+  if (from.isPlaying != to.isPlaying) {
+    changed |= Playing;
+  }
+  unsigned long now = millis();
+  if (abs(to.position(now) - from.position(now)) > PROGRESS_TOLERANCE_MS) {
+    changed |= Progress;
+  }
+  if (from.isLiked != to.isLiked) {
+    changed |= Liked;
+  }
+  if (from.volumePercent != to.volumePercent) {
+    changed |= Volume;
+  }
+  if (from.next.hash != to.next.hash || from.nextIsLiked != to.nextIsLiked) {
+    changed |= Next;
+  }
+  return changed;
+}
+
+uint16_t PlayerStore::commit(Source source) {
+  if (!_editing) {
+    return 0;
+  }
+  _editing = false;
+  uint16_t changed = _published ? diff(_state, _draft) : AllFields;
+  _published = true;
+  // Taken even when nothing changed, so progress stays anchored to the
+  // latest server value.
+  _state = _draft;
+
+  _commits[source]++;
+  if (changed == 0) {
+    _noopCommits++;
+    return 0;
+  }
+  _version++;
+  for (int i = 0; i < FIELD_COUNT; i++) {
+    if (changed & (1 << i)) {
+      _changes[i]++;
+    }
+  }
+
+  for (int s = 0; s < _subCount; s++) {
+    uint16_t fields = changed & _subs[s].fields;
+    if (fields == 0) {
+      continue;
+    }
+    for (int i = 0; i < FIELD_COUNT; i++) {
+      if (fields & (1 << i)) {
+        _calls[i]++;
+      }
+    }
+    _subs[s].listener(_subs[s].ctx, _state, fields);
+  }
+  return changed;
+}
+
+void PlayerStore::report(Print &out) {
+  unsigned long now = millis();
+  float hours = (now - _countersSince) / 3600000.0f;
+  if (hours <= 0) {
+    return;
+  }
+  out.printf("[store] v%u over %.2f h, commits/h:", _version, hours);
+  for (int i = 0; i < SOURCE_COUNT; i++) {
+    out.printf(" %s %.0f", SOURCE_NAMES[i], _commits[i] / hours);
+  }
+  out.printf(" (%.0f changed nothing)\n", _noopCommits / hours);
+  out.printf("[store] changes/h (listener calls/h):");
+  for (int i = 0; i < FIELD_COUNT; i++) {
+    out.printf(" %s %.0f (%.0f)", FIELD_NAMES[i], _changes[i] / hours,
+               _calls[i] / hours);
+  }
+  out.printf("\n");
+
+  for (int i = 0; i < SOURCE_COUNT; i++) {
+    _commits[i] = 0;
+  }
+  _noopCommits = 0;
+  for (int i = 0; i < FIELD_COUNT; i++) {
+    _changes[i] = 0;
+    _calls[i] = 0;
+  }
+  _countersSince = now;
+}
+
+void PlayerStore::maybeReport(Print &out) {
+  if (millis() - _countersSince >= REPORT_INTERVAL) {
+    report(out);
+  }
+}
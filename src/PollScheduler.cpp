@@ -0,0 +1,69 @@
+#include "PollScheduler.h"
+
+PollScheduler::PollScheduler() {
+  _mode = Playing;
+  _streak = 0;
+}
+
+const char *PollScheduler::modeName(Mode mode) {
+  switch (mode) {
+  case Playing:
+    return "playing";
+  case Paused:
+    return "paused";
+  case Idle:
+    return "idle";
+  case Error:
+    return "error";
+  case RateLimited:
+    return "rate-limited";
+  }
+  return "?";
+}
+
+uint32_t PollScheduler::backoff(Mode mode, uint32_t maxDelay) {
+  if (_mode != mode) {
+    _mode = mode;
+    _streak = 0;
+  }
+  uint32_t delayMs = BACKOFF_BASE;
+  for (uint8_t i = 0; i < _streak && delayMs < maxDelay; i++) {
+    delayMs *= 2;
+  }
+  if (_streak < 255) {
+    _streak++;
+  }
+  return delayMs < maxDelay ? delayMs : maxDelay;
+}
+
+uint32_t PollScheduler::onPoll(int status, bool isPlaying, int progressMs,
+                               int durationMs, uint32_t retryAfterMs) {
+  if (status == 429) {
+    // Retry-After is in whole seconds; without one, back off like an error.
+    uint32_t delayMs = backoff(RateLimited, ERROR_MAX);
+    return retryAfterMs > delayMs ? retryAfterMs : delayMs;
+  }
+  if (status == 204) {
+    return backoff(Idle, IDLE_MAX);
+  }
+  if (status != 200) {
+    return backoff(Error, ERROR_MAX);
+  }
+  if (!isPlaying) {
+    return backoff(Paused, PAUSED_MAX);
+  }
+
+  _mode = Playing;
+  _streak = 0;
+
+  uint32_t delayMs = PLAYING_INTERVAL;
+  if (durationMs > 0 && progressMs >= 0 && progressMs < durationMs) {
+    uint32_t untilEnd = (uint32_t)(durationMs - progressMs) + TRACK_END_SLACK;
+    if (untilEnd < delayMs) {
+      delayMs = untilEnd;
+    }
+  }
+  return delayMs < MIN_INTERVAL ? MIN_INTERVAL : delayMs;
+}
+
+void PollScheduler::onCommand() { _streak = 0; }
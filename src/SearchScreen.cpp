@@ -0,0 +1,406 @@
+#include "SearchScreen.h"
+
+#include "ScreenStyle.h"
+#include "Telemetry.h"
+
+static const uint16_t KEY_BG = 0x2945;
+static const uint16_t KEY_ACTIVE = 0x1C8A; // current page, kana column
+static const uint16_t PLAYLIST_MARK = 0x1DC8; // Spotify green
+static const int TEXT_X = 8; // result text, after the playlist mark
+
+// Key rows per page, labels separated by spaces
+static const char *const LATIN_ROWS[] = {
+    "q w e r t y u i o p", "a s d f g h j k l", "z x c v b n m"};
+static const char *const DIGIT_ROWS[] = {
+    "1 2 3 4 5 6 7 8 9 0", "- / : & . , ! ? '", "( ) # + @ $ %"};
+static const char *const KANA_COLUMNS =
+    "あ か さ た な は ま や ら わ";
+static const char *const KANA_ROWS[] = {
+    "あ い う え お", "か き く け こ", "さ し す せ そ", "た ち つ て と",
+    "な に ぬ ね の", "は ひ ふ へ ほ", "ま み む め も", "や ゆ よ",
+    "ら り る れ ろ", "わ を ん"};
+static const char *const KANA_EXTRA = "ー ん";
+
+// Bottom row: page keys, space, delete
+static const int PAGE_KEY_W = 48;
+static const int SPACE_X = 3 * PAGE_KEY_W;
+static const int DELETE_X = 256;
+static const char *const PAGE_LABELS[] = {"ABC", "123", "かな"};
+
+// Number of space-separated labels in `row`
+static int countKeys(const char *row) {
+  int n = *row != '\0' ? 1 : 0;
+  for (const char *p = row; *p; p++) {
+    n += *p == ' ';
+  }
+  return n;
+}
+
+// Copies the index-th label of `row`; false if there is none.
+static bool copyKey(const char *row, int index, char *out, size_t size) {
+  const char *p = row;
+  for (int i = 0; i < index; i++) {
+    p = strchr(p, ' ');
+    if (p == nullptr) {
+      return false;
+    }
+    p++;
+  }
+  const char *end = strchr(p, ' ');
+  size_t n = end != nullptr ? (size_t)(end - p) : strlen(p);
+  if (n == 0 || n >= size) {
+    return false;
+  }
+  memcpy(out, p, n);
+  out[n] = '\0';
+  return true;
+}
+
+SearchScreen::SearchScreen(LibrarySync &library)
+    : _header(0, 0, 320, HEADER_H),
+      _results(0, HEADER_H, 320, KEYS_Y - HEADER_H),
+      _keys(0, KEYS_Y, 320, 240 - KEYS_Y) {
+  _library = &library;
+  _index = nullptr;
+  _open = false;
+  _page = Latin;
+  _kanaColumn = 0;
+  _query[0] = '\0';
+  _queryLen = 0;
+  _hitCount = 0;
+  _queryUs = 0;
+  _scroll = 0;
+  _dragging = false;
+  _dragStartY = 0;
+  _dragStartScroll = 0;
+  _resultsDirty = false;
+  _keysDirty = false;
+}
+
+bool SearchScreen::begin() {
+  _header.begin(false);
+  _results.begin(true);
+  _keys.begin(true);
+  _compositor.addLayer(_header);
+  _compositor.addLayer(_results);
+  _compositor.addLayer(_keys);
+  _titleWidths.begin(measureCanvasGlyph, &_header.canvas());
+  _artistWidths.begin(measureCanvasGlyph, &_header.canvas());
+  return true;
+}
+
+void SearchScreen::open() {
+  _open = true;
+  _query[0] = '\0';
+  _queryLen = 0;
+  _hitCount = 0;
+  _scroll = 0;
+  _dragging = false;
+  _index = _library->acquire();
+  _resultsDirty = true;
+  _keysDirty = true;
+  _compositor.invalidate();
+}
+
+void SearchScreen::close() {
+  _open = false;
+  if (_index != nullptr) {
+    _index = nullptr;
+    _library->release();
+  }
+}
+
+const char *SearchScreen::keyRow(int row) const {
+  switch (_page) {
+  case Latin:
+    return LATIN_ROWS[row];
+  case Digits:
+    return DIGIT_ROWS[row];
+  case Kana:
+    return row == 0 ? KANA_COLUMNS
+                    : (row == 1 ? KANA_ROWS[_kanaColumn] : KANA_EXTRA);
+  }
+  return "";
+}
+
+// The key under x in one of the upper rows: its index, its label in
+// `label`; -1 if none.
+int SearchScreen::keyAt(int row, int x, char *label, size_t size) const {
+  const char *keys = keyRow(row);
+  int n = countKeys(keys);
+  int left = (320 - n * KEY_W) / 2;
+  if (x < left) {
+    return -1;
+  }
+  int index = (x - left) / KEY_W;
+  if (index >= n || !copyKey(keys, index, label, size)) {
+    return -1;
+  }
+  return index;
+}
+
+SearchScreen::Action SearchScreen::tap(int x, int y, char *id,
+                                       bool &playlist) {
+  if (y < HEADER_H) {
+    return x < 100 ? Close : NoAction;
+  }
+  if (y < KEYS_Y) {
+    // The layer is a little taller than its rows; nothing is drawn below
+    int row = (y - HEADER_H) / ROW_H;
+    int i = _scroll + row;
+    if (_index == nullptr || row >= ROWS || i >= _hitCount) {
+      return NoAction;
+    }
+    _index->id(_hits[i], id);
+    playlist = _index->kind(_hits[i]) == LibraryIndex::Playlist;
+    return Play;
+  }
+
+  int row = (y - KEYS_Y) / KEY_H;
+  if (row >= KEY_ROWS) {
+    if (x < SPACE_X) {
+      _page = (Page)(x / PAGE_KEY_W);
+      _keysDirty = true;
+    } else if (x < DELETE_X) {
+      if (_queryLen > 0 && _query[_queryLen - 1] != ' ') {
+        type(" ");
+      }
+    } else {
+      erase();
+    }
+    return NoAction;
+  }
+  char label[8];
+  int index = keyAt(row, x, label, sizeof(label));
+  if (index < 0) {
+    return NoAction;
+  }
+  if (_page == Kana && row == 0) {
+    _kanaColumn = index;
+    _keysDirty = true;
+  } else {
+    type(label);
+  }
+  return NoAction;
+}
+
+void SearchScreen::longPress(int x, int y) {
+  if (y >= KEYS_Y + KEY_ROWS * KEY_H && x >= DELETE_X && _queryLen > 0) {
+    _query[0] = '\0';
+    _queryLen = 0;
+    runQuery();
+  }
+}
+
+void SearchScreen::drag(int y) {
+  if (!_dragging) {
+    _dragging = true;
+    _dragStartY = y;
+    _dragStartScroll = _scroll;
+    return;
+  }
+  int scroll = _dragStartScroll + (_dragStartY - y) / ROW_H;
+  int max = _hitCount > ROWS ? _hitCount - ROWS : 0;
+  scroll = scroll < 0 ? 0 : (scroll > max ? max : scroll);
+  if (scroll != _scroll) {
+    _scroll = scroll;
+    _resultsDirty = true;
+  }
+}
+
+void SearchScreen::type(const char *text) {
+  size_t n = strlen(text);
+  if (_queryLen + n >= sizeof(_query)) {
+    return;
+  }
+  memcpy(_query + _queryLen, text, n + 1);
+  _queryLen += n;
+  runQuery();
+}
+
+// Removes the last character (UTF-8 continuation bytes with it).
+void SearchScreen::erase() {
+  if (_queryLen == 0) {
+    return;
+  }
+  do {
+    _queryLen--;
+  } while (_queryLen > 0 && ((uint8_t)_query[_queryLen] & 0xC0) == 0x80);
+  _query[_queryLen] = '\0';
+  runQuery();
+}
+
+void SearchScreen::runQuery() {
+  _hitCount = 0;
+  _scroll = 0;
+  _resultsDirty = true;
+  if (_index == nullptr || _queryLen == 0) {
+    return;
+  }
+  unsigned long start = micros();
+  _hitCount = _index->search(_query, _hits, MAX_RESULTS);
+  _queryUs = micros() - start;
+  Telemetry::record(Stage::SearchQuery, _queryUs);
+}
+
+void SearchScreen::tick() {
+  if (!_open) {
+    return;
+  }
+  if (_index == nullptr) {
+    // Loaded or rebuilt since the screen opened
+    _index = _library->acquire();
+    if (_index != nullptr) {
+      runQuery();
+    }
+  }
+  if (_resultsDirty) {
+    drawHeader();
+    drawResults();
+    _resultsDirty = false;
+  }
+  if (_keysDirty) {
+    drawKeys();
+    _keysDirty = false;
+  }
+}
+
+void SearchScreen::render() {
+  if (_open) {
+    _compositor.flush();
+  }
+}
+
+void SearchScreen::drawHeader() {
+  M5Canvas &g = _header.canvas();
+  g.fillScreen(SCREEN_HEADER_BG);
+  g.setFont(&fonts::lgfxJapanGothicP_16);
+  g.setTextColor(TFT_WHITE, SCREEN_HEADER_BG);
+  g.setTextDatum(middle_left);
+  g.drawString("<", 6, HEADER_H / 2);
+
+  // The end of the query, with a cursor
+  char shown[QUERY_BYTES + 4];
+  snprintf(shown, sizeof(shown), "%s_", _query);
+  const char *text = shown;
+  while (g.textWidth(text) > 200) {
+    do {
+      text++;
+    } while (((uint8_t)*text & 0xC0) == 0x80);
+  }
+  g.drawString(text, 24, HEADER_H / 2);
+
+  char status[24];
+  if (_index != nullptr && _queryLen > 0) {
+    snprintf(status, sizeof(status), "%d%s %u.%u ms", _hitCount,
+             _hitCount == MAX_RESULTS ? "+" : "", _queryUs / 1000,
+             _queryUs % 1000 / 100);
+  } else if (_index != nullptr) {
+    snprintf(status, sizeof(status), "%d items", _index->entryCount());
+  } else {
+    status[0] = '\0';
+  }
+  g.setFont(&fonts::lgfxJapanGothicP_12);
+  g.setTextColor(TFT_LIGHTGREY, SCREEN_HEADER_BG);
+  g.setTextDatum(middle_right);
+  g.drawString(status, 314, HEADER_H / 2);
+  g.setTextDatum(top_left);
+  _header.markAllDirty();
+}
+
+void SearchScreen::drawResults() {
+  M5Canvas &g = _results.canvas();
+  g.fillScreen(TFT_BLACK);
+  const char *message = nullptr;
+  if (_index == nullptr) {
+    message = _library->syncing() ? "Syncing library..."
+                                  : "Library not loaded yet";
+  } else if (_queryLen == 0) {
+    message = "Type to search your library";
+  } else if (_hitCount == 0) {
+    message = "No matches";
+  }
+  if (message != nullptr) {
+    g.setFont(&fonts::lgfxJapanGothicP_16);
+    g.setTextColor(TFT_LIGHTGREY, TFT_BLACK);
+    g.setTextDatum(middle_center);
+    g.drawString(message, 160, g.height() / 2);
+    g.setTextDatum(top_left);
+    _results.markAllDirty();
+    return;
+  }
+
+  // Widths are measured on the header canvas, set to the same font
+  char line[TextLayout::LINE_BYTES];
+  int width = 320 - TEXT_X - 6;
+  for (int r = 0; r < ROWS && _scroll + r < _hitCount; r++) {
+    int entry = _hits[_scroll + r];
+    int y = r * ROW_H;
+    bool playlist = _index->kind(entry) == LibraryIndex::Playlist;
+    if (playlist) {
+      g.fillRect(0, y + 4, 3, ROW_H - 8, PLAYLIST_MARK);
+    }
+    g.setFont(&fonts::lgfxJapanGothicP_16);
+    _header.canvas().setFont(&fonts::lgfxJapanGothicP_16);
+    g.setTextColor(TFT_WHITE, TFT_BLACK);
+    g.drawString(_layout.fitLine(_index->title(entry), _titleWidths, width,
+                                 line),
+                 TEXT_X, y + 1);
+
+    g.setFont(&fonts::lgfxJapanGothicP_12);
+    _header.canvas().setFont(&fonts::lgfxJapanGothicP_12);
+    g.setTextColor(playlist ? PLAYLIST_MARK : TFT_LIGHTGREY, TFT_BLACK);
+    g.drawString(_layout.fitLine(_index->artist(entry), _artistWidths, width,
+                                 line),
+                 TEXT_X, y + 17);
+    g.drawFastHLine(0, y + ROW_H - 1, 320, SCREEN_DIM);
+  }
+  if (_hitCount > ROWS) {
+    // Scroll position
+    int h = g.height() * ROWS / _hitCount;
+    int top = (g.height() - h) * _scroll / (_hitCount - ROWS);
+    g.fillRect(317, top, 3, h, TFT_DARKGREY);
+  }
+  _results.markAllDirty();
+}
+
+void SearchScreen::drawKeys() {
+  M5Canvas &g = _keys.canvas();
+  g.fillScreen(TFT_BLACK);
+  g.setFont(&fonts::lgfxJapanGothicP_16);
+  g.setTextDatum(middle_center);
+
+  char label[8];
+  for (int row = 0; row < KEY_ROWS; row++) {
+    const char *keys = keyRow(row);
+    int n = countKeys(keys);
+    int left = (320 - n * KEY_W) / 2;
+    for (int i = 0; i < n && copyKey(keys, i, label, sizeof(label)); i++) {
+      bool active = _page == Kana && row == 0 && i == _kanaColumn;
+      uint16_t bg = active ? KEY_ACTIVE : KEY_BG;
+      int x = left + i * KEY_W;
+      g.fillRoundRect(x + 1, row * KEY_H + 1, KEY_W - 2, KEY_H - 2, 4, bg);
+      g.setTextColor(TFT_WHITE, bg);
+      g.drawString(label, x + KEY_W / 2, row * KEY_H + KEY_H / 2);
+    }
+  }
+
+  int y = KEY_ROWS * KEY_H;
+  for (int p = 0; p < 3; p++) {
+    uint16_t bg = p == _page ? KEY_ACTIVE : KEY_BG;
+    g.fillRoundRect(p * PAGE_KEY_W + 1, y + 1, PAGE_KEY_W - 2, KEY_H - 2, 4,
+                    bg);
+    g.setTextColor(TFT_WHITE, bg);
+    g.drawString(PAGE_LABELS[p], p * PAGE_KEY_W + PAGE_KEY_W / 2,
+                 y + KEY_H / 2);
+  }
+  g.fillRoundRect(SPACE_X + 1, y + 1, DELETE_X - SPACE_X - 2, KEY_H - 2, 4,
+                  KEY_BG);
+  g.setTextColor(TFT_WHITE, KEY_BG);
+  g.drawString("space", (SPACE_X + DELETE_X) / 2, y + KEY_H / 2);
+  g.fillRoundRect(DELETE_X + 1, y + 1, 320 - DELETE_X - 2, KEY_H - 2, 4,
+                  KEY_BG);
+  g.drawString("Del", (DELETE_X + 320) / 2, y + KEY_H / 2);
+  g.setTextDatum(top_left);
+  _keys.markAllDirty();
+}
@@ -1,127 +1,708 @@
 #include "SpotifyClient.h"
 
-SpotifyClient::SpotifyClient(Spotify &spotify, const char *refreshToken) {
-  _spotify = &spotify;
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+#include <time.h>
+
+#include "Fnv1a.h"
+#include "Telemetry.h"
+
+static const char *API_BASE = "https://api.spotify.com/v1";
+
+// NVS namespace for the saved access token
+static const char *TOKEN_NVS = "spotify";
+// Anything earlier means SNTP hasn't set the clock yet
+static const time_t MIN_VALID_TIME = 1700000000; // 2023-11
+
+static bool clockValid() { return time(nullptr) >= MIN_VALID_TIME; }
+
+// The buffered start of a reply followed by the rest of it still on the
+// socket, for replies larger than the buffer.
+class ChainedStream : public Stream {
+public:
+  ChainedStream(const char *head, size_t len, Stream &tail) {
+    _head = head;
+    _len = len;
+    _pos = 0;
+    _tail = &tail;
+  }
+
+  int available() override {
+    return _pos < _len ? _len - _pos : _tail->available();
+  }
+  int read() override {
+    return _pos < _len ? (uint8_t)_head[_pos++] : _tail->read();
+  }
+  int peek() override {
+    return _pos < _len ? (uint8_t)_head[_pos] : _tail->peek();
+  }
+  size_t write(uint8_t) override { return 0; }
+  void flush() override {}
+
+private:
+  const char *_head;
+  size_t _len;
+  size_t _pos;
+  Stream *_tail;
+};
+
+SpotifyClient::SpotifyClient(HttpPool &pool, const char *clientId,
+                             const char *clientSecret,
+                             const char *refreshToken)
+    : _jsonArena(_jsonArenaBuf, sizeof(_jsonArenaBuf)) {
+  _pool = &pool;
+  _clientId = clientId;
+  _clientSecret = clientSecret;
   _refreshToken = refreshToken;
+  _tokenExpiresAt = 0;
+  _tokenRetryAt = 0;
+  _savedExpiry = 0;
+  _rateLimitedUntil = 0;
+  _likeCalls = 0;
+  _likeIdsFetched = 0;
+
+  _parseCount = 0;
+  _parseTotalUs = 0;
+  _parseMaxUs = 0;
+  _parseMaxHeap = 0;
+  _parseAvgUs = 0;
+  _skipCount = 0;
+  _digestTotalUs = 0;
+
+  _body = nullptr;
+  _parsedHasTrack = false;
+  _parsedPlaying = false;
+  _parsedVolume = -1;
+
+  buildNowPlayingFilter(_nowPlayingFilter);
+  buildQueueFilter(_queueFilter);
+  buildPlaylistPageFilter(_playlistPageFilter);
+  buildSavedTracksFilter(_savedTracksFilter);
+  buildPlaylistsFilter(_playlistsFilter);
+}
+
+void SpotifyClient::begin() {
+  Preferences prefs;
+  if (!prefs.begin(TOKEN_NVS, true)) {
+    return; // nothing saved yet
+  }
+  String token = prefs.getString("token", "");
+  uint32_t owner = prefs.getUInt("owner", 0);
+  uint32_t expiry = prefs.getUInt("expiry", 0);
+  prefs.end();
+  // Saved for other credentials (secrets.h changed): don't use it
+  if (token.isEmpty() || owner != tokenOwner()) {
+    return;
+  }
+
+  if (clockValid() && expiry != 0) {
+    long leftSec = (long)expiry - (long)time(nullptr);
+    if (leftSec * 1000L <= (long)TOKEN_MIN_VALIDITY_MS) {
+      Serial.println("[token] saved token expired");
+      return;
+    }
+    _tokenExpiresAt = millis() + leftSec * 1000UL;
+    Serial.printf("[token] restored, %ld s left\n", leftSec);
+  } else {
+    // Trusted for a short while; maintainToken() corrects the expiry once
+    // the clock is set, and a 401 replaces it right away.
+    _savedExpiry = expiry;
+    _tokenExpiresAt = millis() + TOKEN_REFRESH_AHEAD_MS + TOKEN_PROVISIONAL_MS;
+    Serial.println("[token] restored, expiry unverified");
+  }
+  _accessToken = token;
+}
+
+// Changes whenever the credentials do; saved alongside the token.
+uint32_t SpotifyClient::tokenOwner() const {
+  return fnv1aString(fnv1aString(FNV1A_SEED, _clientId), _refreshToken);
+}
+
+void SpotifyClient::saveToken(unsigned long lifetimeSec) {
+  Preferences prefs;
+  if (!prefs.begin(TOKEN_NVS, false)) {
+    return;
+  }
+  prefs.putString("token", _accessToken);
+  prefs.putUInt("owner", tokenOwner());
+  // 0: unknown, the next boot treats the token as provisional
+  prefs.putUInt("expiry",
+                clockValid() ? (uint32_t)(time(nullptr) + lifetimeSec) : 0);
+  prefs.end();
 }
 
 bool SpotifyClient::refreshAccessToken() {
-  Serial.println("Refreshing Access Token...");
-  // The library handles this internally usually, but we can enable logic here
-  // if needed. FinianLandes/SpotifyEsp32 handles refresh on API calls if token
-  // is expired, provided we initialized it with refresh token.
+  unsigned long start = millis();
+
+  HTTPClient http;
+  HttpLease lease;
+  _pool->open(http, "https://accounts.spotify.com/api/token", lease);
+  http.setAuthorization(_clientId, _clientSecret);
+  http.addHeader("Content-Type", "application/x-www-form-urlencoded");
+  int httpCode =
+      _pool->send(http, lease, "POST",
+                  String("grant_type=refresh_token&refresh_token=") +
+                      _refreshToken);
+  if (httpCode != HTTP_CODE_OK) {
+    Serial.printf("[token] refresh failed: %d\n", httpCode);
+    _pool->close(http, lease, httpCode);
+    _tokenRetryAt = millis() + TOKEN_RETRY_MS;
+    return false;
+  }
+
+  JsonDocument filter;
+  filter["access_token"] = true;
+  filter["expires_in"] = true;
+  JsonDocument doc;
+  DeserializationError err = deserializeJson(
+      doc, lease.body, DeserializationOption::Filter(filter));
+  _pool->close(http, lease, httpCode);
+  if (err || !doc["access_token"].is<const char *>()) {
+    _tokenRetryAt = millis() + TOKEN_RETRY_MS;
+    return false;
+  }
+
+  _accessToken = doc["access_token"].as<String>();
+  unsigned long lifetimeSec = doc["expires_in"] | 3600;
+  _tokenExpiresAt = millis() + lifetimeSec * 1000UL;
+  _savedExpiry = 0;
+  saveToken(lifetimeSec);
+  Serial.printf("[token] refreshed in %lu ms, valid for %lu s\n",
+                millis() - start, lifetimeSec);
   return true;
 }
 
-bool SpotifyClient::play() {
-  return _spotify->start_resume_playback().status_code == 204;
+uint32_t SpotifyClient::maintainToken() {
+  unsigned long now = millis();
+  if (_savedExpiry != 0 && clockValid()) {
+    // Clock set since begin(): now the saved expiry can be trusted
+    long leftSec = (long)_savedExpiry - (long)time(nullptr);
+    _tokenExpiresAt = now + (leftSec > 0 ? leftSec * 1000UL : 0);
+    _savedExpiry = 0;
+  }
+
+  long due = _accessToken.isEmpty()
+                 ? 0
+                 : (long)(_tokenExpiresAt - TOKEN_REFRESH_AHEAD_MS - now);
+  long retry = (long)(_tokenRetryAt - now);
+  if (due <= 0 && retry <= 0) {
+    refreshAccessToken();
+    now = millis();
+    due = (long)(_tokenExpiresAt - TOKEN_REFRESH_AHEAD_MS - now);
+    retry = (long)(_tokenRetryAt - now);
+  }
+  if (retry > due) {
+    due = retry;
+  }
+  return due > 0 ? due : 0;
+}
+
+bool SpotifyClient::ensureAccessToken() {
+  // Gate: never send a token that is about to expire. maintainToken()
+  // normally renewed it long before this.
+  if (!_accessToken.isEmpty() &&
+      (long)(_tokenExpiresAt - millis()) > (long)TOKEN_MIN_VALIDITY_MS) {
+    return true;
+  }
+  Serial.println("[token] stale, refreshing inline");
+  return refreshAccessToken();
+}
+
+uint32_t SpotifyClient::retryAfterMs() const {
+  long left = (long)(_rateLimitedUntil - millis());
+  return left > 0 ? left : 0;
+}
+
+int SpotifyClient::apiRequest(HTTPClient &http, HttpLease &lease,
+                              const char *method, const String &path,
+                              const String &payload) {
+  if (retryAfterMs() > 0) {
+    return 429;
+  }
+  if (!ensureAccessToken()) {
+    return 401;
+  }
+
+  String url = String(API_BASE) + path;
+  bool reauthorized = false;
+  for (int attempt = 0;; attempt++) {
+    _pool->open(http, url, lease);
+    http.addHeader("Authorization", "Bearer " + _accessToken);
+    if (!payload.isEmpty()) {
+      http.addHeader("Content-Type", "application/json");
+    } else if (strcmp(method, "GET") != 0) {
+      // Spotify rejects bodiless PUT/POST without an explicit length (411)
+      http.addHeader("Content-Length", "0");
+    }
+    int httpCode = _pool->send(http, lease, method, payload);
+
+    if (httpCode < 0 && lease.reused && attempt == 0) {
+      // The server closed the kept-alive connection under us; reconnect.
+      _pool->close(http, lease, httpCode);
+      continue;
+    }
+    if (httpCode == 401 && !reauthorized) {
+      // Revoked, or a restored token that had in fact expired: renew and
+      // retry once.
+      _pool->close(http, lease, httpCode);
+      _accessToken = "";
+      reauthorized = true;
+      if (!refreshAccessToken()) {
+        return 401;
+      }
+      continue;
+    }
+    if (httpCode == 401) {
+      _accessToken = ""; // refreshed on the next call
+    }
+    if (httpCode == 429) {
+      long retryAfterSec = http.header("Retry-After").toInt();
+      if (retryAfterSec < 1) {
+        retryAfterSec = 1;
+      }
+      _rateLimitedUntil = millis() + retryAfterSec * 1000UL;
+      Serial.printf("Rate limited for %ld s\n", retryAfterSec);
+    }
+    return httpCode;
+  }
+}
+
+int SpotifyClient::apiCommand(const char *method, const String &path,
+                              const String &payload) {
+  HTTPClient http;
+  HttpLease lease;
+  int httpCode = apiRequest(http, lease, method, path, payload);
+  _pool->close(http, lease, httpCode);
+  return httpCode;
+}
+
+bool SpotifyClient::play() { return apiCommand("PUT", "/me/player/play") == 204; }
+
+bool SpotifyClient::playInContext(const char *contextUri, int position) {
+  String body = String("{\"context_uri\":\"") + contextUri +
+                "\",\"offset\":{\"position\":" + position + "}}";
+  return apiCommand("PUT", "/me/player/play", body) == 204;
+}
+
+bool SpotifyClient::playTrack(const char *trackId) {
+  String body = String("{\"uris\":[\"spotify:track:") + trackId + "\"]}";
+  return apiCommand("PUT", "/me/player/play", body) == 204;
 }
 
 bool SpotifyClient::pause() {
-  return _spotify->pause_playback().status_code == 204;
+  return apiCommand("PUT", "/me/player/pause") == 204;
 }
 
-bool SpotifyClient::next() { return _spotify->skip().status_code == 204; }
+bool SpotifyClient::next() {
+  return apiCommand("POST", "/me/player/next") == 204;
+}
 
 bool SpotifyClient::previous() {
-  return _spotify->previous().status_code == 204;
+  return apiCommand("POST", "/me/player/previous") == 204;
+}
+
+bool SpotifyClient::seek(int positionMs) {
+  return apiCommand("PUT", String("/me/player/seek?position_ms=") +
+                               positionMs) == 204;
+}
+
+bool SpotifyClient::setVolume(int percent) {
+  return apiCommand("PUT", String("/me/player/volume?volume_percent=") +
+                               percent) == 204;
 }
 
 bool SpotifyClient::toggleShuffle(bool state) {
-  return _spotify->shuffle(state).status_code == 204;
+  return apiCommand("PUT", String("/me/player/shuffle?state=") +
+                               (state ? "true" : "false")) == 204;
 }
 
 bool SpotifyClient::setRepeatMode(const char *mode) {
-  return _spotify->repeat_mode(mode).status_code == 204;
+  return apiCommand("PUT", String("/me/player/repeat?state=") + mode) == 204;
 }
 
 bool SpotifyClient::likeTrack(const char *trackId) {
-  // Check API availability for 'save_tracks_for_current_user'
-  const char *ids[] = {trackId};
-  return _spotify->save_tracks_for_current_user(1, ids).status_code == 200;
+  if (apiCommand("PUT", String("/me/tracks?ids=") + trackId) != 200) {
+    return false;
+  }
+  _likes.store(trackId, true, millis());
+  return true;
 }
 
 bool SpotifyClient::unlikeTrack(const char *trackId) {
-  const char *ids[] = {trackId};
-  return _spotify->remove_user_saved_tracks(1, ids).status_code == 200;
+  if (apiCommand("DELETE", String("/me/tracks?ids=") + trackId) != 200) {
+    return false;
+  }
+  _likes.store(trackId, false, millis());
+  return true;
+}
+
+bool SpotifyClient::cachedLikeState(const char *trackId, bool &isLiked) {
+  return _likes.lookup(trackId, millis(), isLiked);
 }
 
-bool SpotifyClient::getLikeState(const char *trackId, bool &isLiked) {
-  const char *ids[] = {trackId};
-  response resp = _spotify->check_user_saved_tracks(1, ids);
+bool SpotifyClient::fetchLikeStates(const char *const *trackIds, int count) {
+  unsigned long now = millis();
+  const char *ids[MAX_LIKE_IDS];
+  int n = 0;
+  String path = "/me/tracks/contains?ids=";
+  for (int i = 0; i < count && n < MAX_LIKE_IDS; i++) {
+    const char *id = trackIds[i];
+    if (id == nullptr || id[0] == '\0' || _likes.contains(id, now)) {
+      continue;
+    }
+    bool duplicate = false;
+    for (int j = 0; j < n && !duplicate; j++) {
+      duplicate = strcmp(ids[j], id) == 0;
+    }
+    if (duplicate) {
+      continue;
+    }
+    if (n > 0) {
+      path += ',';
+    }
+    path += id;
+    ids[n++] = id;
+  }
+  if (n == 0) {
+    return true; // all cached
+  }
 
-  // Debug output (commented out or use Serial if available)
-  // Serial.printf("Like Check: %d\n", resp.status_code);
+  HTTPClient http;
+  HttpLease lease;
+  int httpCode = apiRequest(http, lease, "GET", path);
 
-  if (resp.status_code == 200) {
-    JsonDocument &doc = resp.reply;
-    if (doc.size() > 0) {
-      isLiked = doc[0].as<bool>();
-      return true; // Success
+  bool ok = false;
+  if (httpCode == 200) {
+    // Reply: one boolean per id, in order
+    JsonDocument doc(&_jsonArena);
+    if (!deserializeJson(doc, lease.body) && doc.size() == (size_t)n) {
+      for (int i = 0; i < n; i++) {
+        _likes.store(ids[i], doc[i].as<bool>(), now);
+      }
+      ok = true;
     }
   }
-  return false; // API Error or invalid response
+  _pool->close(http, lease, httpCode);
+
+  if (ok) {
+    _likeCalls++;
+    _likeIdsFetched += n;
+    // Without the cache every track change costs one request
+    uint32_t saved = _likes.hits() + _likeIdsFetched - _likeCalls;
+    Serial.printf("[like] %d ids in 1 request | cache hit %u/%u, %u requests "
+                  "for %u ids, %u saved\n",
+                  n, _likes.hits(), _likes.hits() + _likes.misses(),
+                  _likeCalls, _likeIdsFetched, saved);
+  }
+  return ok; // false: API Error or invalid response
 }
 
-int SpotifyClient::getNowPlaying(String &title, String &artist,
-                                 String &albumName, String &albumArtUrl,
-                                 String &trackId, bool &isPlaying,
-                                 int &progressMs, int &durationMs) {
-  // Use currently_playing() which returns a response object
-  response resp = _spotify->currently_playing();
+int SpotifyClient::getNowPlaying(TrackInfo &track, bool &isPlaying,
+                                 int &progressMs, int &volumePercent) {
+  HTTPClient http;
+  HttpLease lease;
+  // currently-playing plus the device, whose volume drag-to-adjust starts
+  // from
+  int httpCode = apiRequest(http, lease, "GET", "/me/player");
+  if (httpCode != HTTP_CODE_OK) {
+    _pool->close(http, lease, httpCode);
+    return httpCode;
+  }
 
-  if (resp.status_code == 200) {
-    // Parse JSON
-    JsonDocument &doc = resp.reply;
+  if (_body == nullptr) {
+    _body = (char *)heap_caps_malloc(BODY_BYTES,
+                                     MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  }
+  // Read the reply whole, digesting it as it arrives
+  _digest.reset();
+  unsigned long digestUs = 0;
+  size_t len = 0;
+  while (_body != nullptr && len < BODY_BYTES) {
+    size_t n = lease.body.readBytes(_body + len, BODY_BYTES - len);
+    if (n == 0) {
+      break;
+    }
+    unsigned long t = micros();
+    _digest.update(_body + len, n);
+    digestUs += micros() - t;
+    len += n;
+  }
+  // Not whole: no buffer, or larger than it (the rest is still unread)
+  bool whole = _body != nullptr && len < BODY_BYTES && lease.body.drain();
 
-    if (doc["item"].is<JsonObject>()) {
-      JsonObject item = doc["item"];
-      title = item["name"].as<String>();
-      trackId = item["id"].as<String>();
+  if (whole && _digest.unchanged()) {
+    _pool->close(http, lease, httpCode);
+    Telemetry::record(Stage::Parse, digestUs);
+    recordSkip(digestUs);
+    if (_parsedHasTrack) {
+      track = _parsedTrack;
+    }
+    isPlaying = _parsedPlaying;
+    progressMs = _digest.progressMs();
+    volumePercent = _parsedVolume;
+    return 200;
+  }
 
-      // Artist
-      JsonArray artists = item["artists"];
-      if (artists.size() > 0) {
-        artist = artists[0]["name"].as<String>();
-      } else {
-        artist = "Unknown";
-      }
+  uint32_t heapBefore = ESP.getFreeHeap();
+  unsigned long parseStart = micros();
+  JsonDocument doc(&_jsonArena);
+  ChainedStream rest(_body, len, lease.body);
+#ifdef NOWPLAYING_UNFILTERED_PARSE
+  // Baseline for comparison: materialize the whole reply
+  DeserializationError err =
+      whole ? deserializeJson(doc, _body, len) : deserializeJson(doc, rest);
+#else
+  DeserializationError err =
+      whole ? deserializeJson(doc, _body, len,
+                              DeserializationOption::Filter(_nowPlayingFilter))
+            : deserializeJson(doc, rest,
+                              DeserializationOption::Filter(_nowPlayingFilter));
+#endif
+  unsigned long parseUs = micros() - parseStart;
+  uint32_t heapAfter = ESP.getFreeHeap();
+  _pool->close(http, lease, httpCode);
+
+  if (err) {
+    _digest.parsed(false);
+    Serial.printf("currently_playing parse error: %s\n", err.c_str());
+    return STATUS_PARSE_ERROR;
+  }
+  Telemetry::record(Stage::Parse, digestUs + parseUs);
+  recordParse(digestUs, parseUs,
+              heapBefore > heapAfter ? heapBefore - heapAfter : 0);
+
+  _parsedHasTrack = doc["item"].is<JsonObject>();
+  if (_parsedHasTrack) {
+    readTrack(doc["item"], _parsedTrack);
+    track = _parsedTrack;
+  }
+  _parsedPlaying = doc["is_playing"];
+  _parsedVolume = readVolume(doc["device"]);
+  _contextUri = doc["context"]["uri"].as<const char *>();
+  _digest.parsed(whole);
+
+  isPlaying = _parsedPlaying;
+  progressMs = doc["progress_ms"];
+  volumePercent = _parsedVolume;
+
+  return 200;
+}
+
+void SpotifyClient::recordParse(unsigned long digestUs, unsigned long us,
+                                uint32_t heapBytes) {
+  _digestTotalUs += digestUs;
+  _parseCount++;
+  _parseTotalUs += us;
+  if (us > _parseMaxUs) {
+    _parseMaxUs = us;
+  }
+  if (heapBytes > _parseMaxHeap) {
+    _parseMaxHeap = heapBytes;
+  }
+  reportParse();
+}
+
+void SpotifyClient::recordSkip(unsigned long digestUs) {
+  _digestTotalUs += digestUs;
+  _skipCount++;
+  reportParse();
+}
+
+void SpotifyClient::reportParse() {
+  uint32_t polls = _parseCount + _skipCount;
+  if (polls < PARSE_REPORT_INTERVAL) {
+    return;
+  }
+
+  if (_parseCount > 0) {
+#ifdef NOWPLAYING_UNFILTERED_PARSE
+    const char *mode = "full";
+#else
+    const char *mode = "filtered";
+#endif
+    _parseAvgUs = _parseTotalUs / _parseCount;
+    // Doc heap stays 0 while replies fit the arena
+    Serial.printf("[json] currently_playing %s: avg %lu us, max %lu us, "
+                  "peak doc heap %u B, arena peak %u/%u B (%u fallbacks), "
+                  "min free heap %u B\n",
+                  mode, _parseAvgUs, _parseMaxUs, _parseMaxHeap,
+                  _jsonArena.highWater(), JSON_ARENA_BYTES,
+                  _jsonArena.fallbacks(), ESP.getMinFreeHeap());
+  }
+  // A skipped poll costs only the digest, which every poll pays
+  Serial.printf("[json] %u/%u polls unchanged, parse skipped (%u%%): "
+                "digest avg %lu us, ~%lu ms CPU saved\n",
+                _skipCount, polls, _skipCount * 100 / polls,
+                _digestTotalUs / polls, _skipCount * _parseAvgUs / 1000);
+  _parseCount = 0;
+  _parseTotalUs = 0;
+  _parseMaxUs = 0;
+  _parseMaxHeap = 0;
+  _skipCount = 0;
+  _digestTotalUs = 0;
+}
 
-      // Album
-      JsonObject album = item["album"];
-      albumName = album["name"].as<String>();
-
-      // Image
-      JsonArray images = album["images"];
-      // Get 300x300 or closest which is usually index 1
-      if (images.size() > 0) {
-        // Find best fit or just take first?
-        // Spotify images: [0]=640px, [1]=300px, [2]=64px
-        // Core2 screen is 320x240, art size ~140. Index 1 (300px) is best to
-        // scale down or crop? Or index 2 (64px) is too small. Index 0 too big.
-        // Let's pick appropriate size logic
-        for (JsonObject img : images) {
-          int w = img["width"];
-          if (w <= 350 && w >= 100) {
-            albumArtUrl = img["url"].as<String>();
-            break;
-          }
-        }
-        if (albumArtUrl.isEmpty()) {
-          albumArtUrl = images[0]["url"].as<String>();
-        }
-      } else {
-        albumArtUrl = "";
+int SpotifyClient::getNextInQueue(TrackInfo &next,
+                                  char (*upcoming)[LikeCache::ID_SIZE],
+                                  int maxUpcoming, int *upcomingCount) {
+  HTTPClient http;
+  HttpLease lease;
+  int httpCode = apiRequest(http, lease, "GET", "/me/player/queue");
+  if (httpCode != HTTP_CODE_OK) {
+    _pool->close(http, lease, httpCode);
+    return httpCode;
+  }
+
+  JsonDocument doc(&_jsonArena);
+  DeserializationError err = deserializeJson(
+      doc, lease.body, DeserializationOption::Filter(_queueFilter));
+  _pool->close(http, lease, httpCode);
+  if (err) {
+    return STATUS_PARSE_ERROR;
+  }
+
+  if (upcomingCount != nullptr) {
+    int n = 0;
+    for (JsonObjectConst queued : doc["queue"].as<JsonArrayConst>()) {
+      if (n >= maxUpcoming) {
+        break;
+      }
+      const char *id = queued["id"];
+      if (isTrack(queued) && id != nullptr &&
+          strlen(id) < (size_t)LikeCache::ID_SIZE) {
+        strcpy(upcoming[n++], id);
       }
+    }
+    *upcomingCount = n;
+  }
+
+  JsonObject item = doc["queue"][0];
+
+  // Episodes have no album art we can use; treat them as "nothing queued".
+  if (!isTrack(item)) {
+    next.clear();
+    return 204;
+  }
+
+  readTrack(item, next);
+  return 200;
+}
+
+int SpotifyClient::getQueuePage(ListPage &page) {
+  page.count = 0;
+  page.total = 0;
+  HTTPClient http;
+  HttpLease lease;
+  int httpCode = apiRequest(http, lease, "GET", "/me/player/queue");
+  if (httpCode != HTTP_CODE_OK) {
+    _pool->close(http, lease, httpCode);
+    return httpCode;
+  }
+
+  JsonDocument doc(&_jsonArena);
+  DeserializationError err = deserializeJson(
+      doc, lease.body, DeserializationOption::Filter(_queueFilter));
+  _pool->close(http, lease, httpCode);
+  if (err) {
+    return STATUS_PARSE_ERROR;
+  }
+
+  for (JsonObjectConst queued : doc["queue"].as<JsonArrayConst>()) {
+    if (page.count >= ListPage::ROWS) {
+      break;
+    }
+    readRow(queued, page.rows[page.count++]);
+  }
+  page.total = page.count;
+  return page.count > 0 ? 200 : 204;
+}
 
-      durationMs = item["duration_ms"];
+int SpotifyClient::getPlaylistPage(const char *playlistUri, int offset,
+                                   ListPage &page) {
+  static const char *PLAYLIST_PREFIX = "spotify:playlist:";
+  page.count = 0;
+  page.total = 0;
+  size_t prefixLen = strlen(PLAYLIST_PREFIX);
+  if (strncmp(playlistUri, PLAYLIST_PREFIX, prefixLen) != 0) {
+    return 204; // an album, artist or nothing: not browsable here
+  }
+
+  // `fields` trims the reply server-side too; the filter still guards the
+  // arena against anything extra.
+  String path = String("/playlists/") + (playlistUri + prefixLen) +
+                "/tracks?offset=" + offset + "&limit=" + ListPage::ROWS +
+                "&fields=total,items(track(type,name,id,duration_ms,"
+                "artists(name),album(name,images)))";
+  HTTPClient http;
+  HttpLease lease;
+  int httpCode = apiRequest(http, lease, "GET", path);
+  if (httpCode != HTTP_CODE_OK) {
+    _pool->close(http, lease, httpCode);
+    return httpCode;
+  }
+
+  JsonDocument doc(&_jsonArena);
+  DeserializationError err = deserializeJson(
+      doc, lease.body, DeserializationOption::Filter(_playlistPageFilter));
+  _pool->close(http, lease, httpCode);
+  if (err) {
+    return STATUS_PARSE_ERROR;
+  }
+
+  for (JsonObjectConst item : doc["items"].as<JsonArrayConst>()) {
+    if (page.count >= ListPage::ROWS) {
+      break;
     }
+    readRow(item["track"], page.rows[page.count++]);
+  }
+  page.total = doc["total"];
+  return page.total > 0 ? 200 : 204;
+}
 
-    isPlaying = doc["is_playing"];
-    progressMs = doc["progress_ms"];
+int SpotifyClient::getSavedTracksPage(int offset, int limit, int &total,
+                                      LibraryItemFn fn, void *ctx) {
+  return getLibraryPage(String("/me/tracks?offset=") + offset +
+                            "&limit=" + limit,
+                        _savedTracksFilter, true, total, fn, ctx);
+}
 
-    return 200;
+int SpotifyClient::getPlaylistsPage(int offset, int limit, int &total,
+                                    LibraryItemFn fn, void *ctx) {
+  return getLibraryPage(String("/me/playlists?offset=") + offset +
+                            "&limit=" + limit,
+                        _playlistsFilter, false, total, fn, ctx);
+}
+
+int SpotifyClient::getLibraryPage(const String &path,
+                                  const JsonDocument &filter,
+                                  bool savedTracks, int &total,
+                                  LibraryItemFn fn, void *ctx) {
+  total = 0;
+  HTTPClient http;
+  HttpLease lease;
+  int httpCode = apiRequest(http, lease, "GET", path);
+  if (httpCode != HTTP_CODE_OK) {
+    _pool->close(http, lease, httpCode);
+    return httpCode;
   }
 
-  return resp.status_code;
+  JsonDocument doc(&_jsonArena);
+  DeserializationError err = deserializeJson(
+      doc, lease.body, DeserializationOption::Filter(filter));
+  _pool->close(http, lease, httpCode);
+  if (err) {
+    return STATUS_PARSE_ERROR;
+  }
+
+  total = doc["total"];
+  for (JsonObjectConst entry : doc["items"].as<JsonArrayConst>()) {
+    LibraryItem item;
+    bool usable = savedTracks ? readSavedTrack(entry, item)
+                              : readPlaylist(entry, item);
+    if (!usable) {
+      item.id = nullptr;
+    }
+    fn(ctx, item);
+  }
+  return 200;
 }
@@ -0,0 +1,249 @@
+#include "SpotifyJson.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Fnv1a.h"
+
+static void buildTrackFilter(JsonObject track) {
+  // For arrays the filter of element [0] applies to every element.
+  track["type"] = true;
+  track["name"] = true;
+  track["id"] = true;
+  track["duration_ms"] = true;
+  track["artists"][0]["name"] = true;
+  track["album"]["name"] = true;
+  track["album"]["images"][0]["url"] = true;
+  track["album"]["images"][0]["width"] = true;
+}
+
+void buildNowPlayingFilter(JsonDocument &filter) {
+  filter["is_playing"] = true;
+  filter["progress_ms"] = true;
+  filter["device"]["volume_percent"] = true;
+  filter["device"]["supports_volume"] = true;
+  filter["context"]["uri"] = true;
+  buildTrackFilter(filter["item"].to<JsonObject>());
+}
+
+void buildQueueFilter(JsonDocument &filter) {
+  buildTrackFilter(filter["queue"][0].to<JsonObject>());
+}
+
+void buildPlaylistPageFilter(JsonDocument &filter) {
+  filter["total"] = true;
+  buildTrackFilter(filter["items"][0]["track"].to<JsonObject>());
+}
+
+void buildSavedTracksFilter(JsonDocument &filter) {
+  filter["total"] = true;
+  JsonObject item = filter["items"][0].to<JsonObject>();
+  item["added_at"] = true;
+  item["track"]["id"] = true;
+  item["track"]["name"] = true;
+  item["track"]["artists"][0]["name"] = true;
+}
+
+void buildPlaylistsFilter(JsonDocument &filter) {
+  filter["total"] = true;
+  JsonObject item = filter["items"][0].to<JsonObject>();
+  item["id"] = true;
+  item["name"] = true;
+  item["owner"]["display_name"] = true;
+}
+
+bool isTrack(JsonObjectConst item) {
+  return !item.isNull() && item["type"] == "track";
+}
+
+static const char *stringOr(JsonVariantConst v, const char *fallback) {
+  const char *s = v.as<const char *>();
+  return s != nullptr ? s : fallback;
+}
+
+void readTrack(JsonObjectConst item, TrackFields &out) {
+  out.title = stringOr(item["name"], "");
+  out.trackId = stringOr(item["id"], "");
+
+  // Artist
+  JsonArrayConst artists = item["artists"];
+  out.artist = stringOr(artists[0]["name"], "Unknown");
+
+  // Album
+  JsonObjectConst album = item["album"];
+  out.albumName = stringOr(album["name"], "");
+
+  // Image
+  // Spotify images: [0]=640px, [1]=300px, [2]=64px
+  // Art is drawn at 180px, so the 300px image scaled by 0.6 is the best fit;
+  // 64px is too small and 640px too big to decode quickly.
+  // The 64px one loads in a single round trip and is shown upscaled while
+  // the 300px one downloads.
+  JsonArrayConst images = album["images"];
+  out.albumArtUrl = nullptr;
+  out.thumbUrl = "";
+  for (JsonObjectConst img : images) {
+    int w = img["width"];
+    if (w <= 350 && w >= 100 && out.albumArtUrl == nullptr) {
+      out.albumArtUrl = img["url"].as<const char *>();
+    } else if (w > 0 && w < 100) {
+      out.thumbUrl = stringOr(img["url"], "");
+    }
+  }
+  if (out.albumArtUrl == nullptr) {
+    out.albumArtUrl = stringOr(images[0]["url"], "");
+  }
+  if (strcmp(out.thumbUrl, out.albumArtUrl) == 0) {
+    out.thumbUrl = "";
+  }
+
+  out.durationMs = item["duration_ms"];
+}
+
+void readTrack(JsonObjectConst item, TrackInfo &out) {
+  TrackFields fields;
+  readTrack(item, fields);
+  out.title = fields.title;
+  out.artist = fields.artist;
+  out.albumName = fields.albumName;
+  out.artUrl = fields.albumArtUrl;
+  out.thumbUrl = fields.thumbUrl;
+  out.id = fields.trackId;
+  out.durationMs = fields.durationMs;
+  out.updateHash();
+}
+
+int readVolume(JsonObjectConst device) {
+  // supports_volume is missing from older replies; only false rules it out
+  if (device.isNull() || !(device["supports_volume"] | true) ||
+      !device["volume_percent"].is<int>()) {
+    return -1;
+  }
+  return device["volume_percent"];
+}
+
+void readRow(JsonObjectConst item, ListRow &out) {
+  if (item.isNull()) {
+    // Removed from the catalog, or a local file
+    out.title = "(unavailable)";
+    out.artist = "";
+    out.thumbUrl = "";
+    return;
+  }
+  TrackFields fields;
+  readTrack(item, fields);
+  out.title = fields.title;
+  out.artist = fields.artist;
+  out.thumbUrl = fields.thumbUrl;
+}
+
+bool readSavedTrack(JsonObjectConst item, LibraryItem &out) {
+  JsonObjectConst track = item["track"];
+  out.addedAt = parseIsoTime(item["added_at"]);
+  out.id = track["id"];
+  out.title = stringOr(track["name"], "");
+  out.artist = stringOr(track["artists"][0]["name"], "");
+  return out.id != nullptr;
+}
+
+bool readPlaylist(JsonObjectConst item, LibraryItem &out) {
+  out.addedAt = 0;
+  out.id = item["id"];
+  out.title = stringOr(item["name"], "");
+  out.artist = stringOr(item["owner"]["display_name"], "");
+  return out.id != nullptr;
+}
+
+uint32_t parseIsoTime(const char *s) {
+  int y, mo, d, h, mi, sec;
+  if (s == nullptr || sscanf(s, "%4d-%2d-%2dT%2d:%2d:%2d", &y, &mo, &d, &h,
+                             &mi, &sec) != 6 ||
+      y < 1970 || mo < 1 || mo > 12) {
+    return 0;
+  }
+  // Days from the civil date (proleptic Gregorian, March-based years)
+  y -= mo <= 2;
+  int era = y / 400;
+  int yoe = y - era * 400;
+  int doy = (153 * (mo + (mo > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  long days = (long)era * 146097 + doe - 719468;
+  return (uint32_t)(days * 86400 + h * 3600 + mi * 60 + sec);
+}
+
+// Values left out of the digest
+enum : uint8_t { SKIP_NONE, SKIP_PROGRESS, SKIP_TIMESTAMP };
+
+void PlayerDigest::reset() {
+  _hash = FNV1A_SEED;
+  _progressMs = -1;
+  _depth = 0;
+  _inString = false;
+  _escaped = false;
+  _keyLen = 0;
+  _skipping = SKIP_NONE;
+  _valueStarted = false;
+}
+
+void PlayerDigest::update(const char *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    char c = data[i];
+    if (_skipping != SKIP_NONE) {
+      // A number (or null): runs until the next delimiter
+      bool isSpace = c == ' ' || c == '\t' || c == '\r' || c == '\n';
+      if (isSpace && !_valueStarted) {
+        continue;
+      }
+      if (!isSpace && c != ',' && c != '}' && c != ']') {
+        _valueStarted = true;
+        if (_skipping == SKIP_PROGRESS && _depth == 1) {
+          if (c >= '0' && c <= '9') {
+            _progressMs = (_progressMs < 0 ? 0 : _progressMs * 10) + (c - '0');
+          }
+        }
+        continue;
+      }
+      _skipping = SKIP_NONE;
+    }
+
+    _hash = fnv1aByte(_hash, (uint8_t)c);
+    if (_inString) {
+      if (_escaped) {
+        _escaped = false;
+      } else if (c == '\\') {
+        _escaped = true;
+      } else if (c == '"') {
+        _inString = false;
+      }
+      if (_inString && _keyLen < KEY_SIZE) {
+        _key[_keyLen++] = c;
+      }
+      continue;
+    }
+    switch (c) {
+    case '"':
+      _inString = true;
+      _keyLen = 0;
+      break;
+    case '{':
+    case '[':
+      _depth++;
+      break;
+    case '}':
+    case ']':
+      _depth--;
+      break;
+    case ':':
+      if (_keyLen == 11 && memcmp(_key, "progress_ms", 11) == 0) {
+        _skipping = SKIP_PROGRESS;
+      } else if (_keyLen == 9 && memcmp(_key, "timestamp", 9) == 0) {
+        _skipping = SKIP_TIMESTAMP;
+      }
+      _valueStarted = false;
+      _keyLen = 0;
+      break;
+    default:
+      break;
+    }
+  }
+}
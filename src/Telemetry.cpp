@@ -0,0 +1,132 @@
+#include "Telemetry.h"
+
+#include <esp_heap_caps.h>
+
+static const int STAGE_COUNT = (int)Stage::Count;
+
+portMUX_TYPE Telemetry::_lock = portMUX_INITIALIZER_UNLOCKED;
+Telemetry::Histogram Telemetry::_stages[STAGE_COUNT];
+const char *Telemetry::_taskNames[MAX_TASKS];
+TaskHandle_t Telemetry::_tasks[MAX_TASKS];
+int Telemetry::_taskCount = 0;
+
+const char *Telemetry::stageName(Stage stage) {
+  switch (stage) {
+  case Stage::Poll:
+    return "poll";
+  case Stage::HttpFresh:
+    return "http_fresh";
+  case Stage::HttpReused:
+    return "http_reused";
+  case Stage::Parse:
+    return "parse";
+  case Stage::ArtPreview:
+    return "art_preview";
+  case Stage::ArtDownload:
+    return "art_download";
+  case Stage::ArtLocal:
+    return "art_local";
+  case Stage::TextLayout:
+    return "text_layout";
+  case Stage::Marquee:
+    return "marquee";
+  case Stage::ListFrame:
+    return "list_frame";
+  case Stage::SearchQuery:
+    return "search_query";
+  case Stage::Frame:
+    return "frame";
+  case Stage::CommandAck:
+    return "cmd_ack";
+  case Stage::CommandShown:
+    return "cmd_shown";
+  case Stage::Count:
+    break;
+  }
+  return "?";
+}
+
+void Telemetry::record(Stage stage, uint32_t us) {
+  int bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+  if (bucket >= BUCKETS) {
+    bucket = BUCKETS - 1;
+  }
+
+  portENTER_CRITICAL(&_lock);
+  Histogram &h = _stages[(int)stage];
+  h.count++;
+  h.totalUs += us;
+  if (us > h.maxUs) {
+    h.maxUs = us;
+  }
+  h.buckets[bucket]++;
+  portEXIT_CRITICAL(&_lock);
+}
+
+void Telemetry::registerTask(const char *name, TaskHandle_t task) {
+  portENTER_CRITICAL(&_lock);
+  if (_taskCount < MAX_TASKS) {
+    _taskNames[_taskCount] = name;
+    _tasks[_taskCount] = task;
+    _taskCount++;
+  }
+  portEXIT_CRITICAL(&_lock);
+}
+
+void Telemetry::reset() {
+  portENTER_CRITICAL(&_lock);
+  memset(_stages, 0, sizeof(_stages));
+  portEXIT_CRITICAL(&_lock);
+}
+
+// Upper bound of the bucket holding the given fraction of samples
+uint32_t Telemetry::percentile(const Histogram &h, uint32_t permille) {
+  uint64_t target = ((uint64_t)h.count * permille + 999) / 1000;
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKETS; i++) {
+    seen += h.buckets[i];
+    if (seen >= target) {
+      uint32_t bound = i == 0 ? 0 : (1u << i) - 1;
+      return (i == BUCKETS - 1 || bound > h.maxUs) ? h.maxUs : bound;
+    }
+  }
+  return h.maxUs;
+}
+
+void Telemetry::dump(Print &out) {
+  // Copy under the lock, print without it (serial output is slow)
+  static Histogram snapshot[STAGE_COUNT];
+  portENTER_CRITICAL(&_lock);
+  memcpy(snapshot, _stages, sizeof(snapshot));
+  portEXIT_CRITICAL(&_lock);
+
+  out.printf("[telemetry] begin uptime_ms=%lu\n", millis());
+  for (int s = 0; s < STAGE_COUNT; s++) {
+    const Histogram &h = snapshot[s];
+    out.printf("[telemetry] stage=%s n=%u avg_us=%lu p50_us=%u p90_us=%u "
+               "p99_us=%u max_us=%u hist=",
+               stageName((Stage)s), h.count,
+               h.count ? (unsigned long)(h.totalUs / h.count) : 0UL,
+               percentile(h, 500), percentile(h, 900), percentile(h, 990),
+               h.maxUs);
+    for (int i = 0; i < BUCKETS; i++) {
+      out.printf(i ? ",%u" : "%u", h.buckets[i]);
+    }
+    out.print('\n');
+  }
+
+  out.printf("[telemetry] heap=internal free=%u largest=%u min=%u\n",
+             heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+             heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+             heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+  out.printf("[telemetry] heap=psram free=%u largest=%u min=%u\n",
+             heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+             heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM),
+             heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+  for (int i = 0; i < _taskCount; i++) {
+    // High-water mark: the least stack ever left free (bytes on ESP32)
+    out.printf("[telemetry] task=%s stack_free_min=%u\n", _taskNames[i],
+               uxTaskGetStackHighWaterMark(_tasks[i]));
+  }
+  out.printf("[telemetry] end\n");
+}
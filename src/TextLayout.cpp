@@ -0,0 +1,271 @@
+#include "TextLayout.h"
+
+#include <string.h>
+
+const char *TextLayout::ELLIPSIS = "\xE2\x80\xA6";
+static const uint32_t ELLIPSIS_CP = 0x2026;
+
+GlyphWidthCache::GlyphWidthCache() {
+  _measure = nullptr;
+  _ctx = nullptr;
+  memset(_keys, 0, sizeof(_keys));
+  _hits = 0;
+  _misses = 0;
+}
+
+void GlyphWidthCache::begin(GlyphMeasureFn measure, void *ctx) {
+  _measure = measure;
+  _ctx = ctx;
+  memset(_keys, 0, sizeof(_keys));
+}
+
+int GlyphWidthCache::width(uint32_t codepoint, const char *utf8, uint8_t len) {
+  // Open addressing with linear probing; a full table just stops caching.
+  uint32_t slot = (codepoint * 2654435761u) & (SLOTS - 1);
+  for (int probe = 0; probe < 8; probe++) {
+    uint32_t i = (slot + probe) & (SLOTS - 1);
+    if (_keys[i] == codepoint) {
+      _hits++;
+      return _widths[i];
+    }
+    if (_keys[i] == 0) {
+      slot = i;
+      break;
+    }
+  }
+
+  _misses++;
+  char glyph[5];
+  memcpy(glyph, utf8, len);
+  glyph[len] = '\0';
+  int w = _measure != nullptr ? _measure(_ctx, glyph) : 0;
+  if (w < 0) {
+    w = 0;
+  } else if (w > 255) {
+    w = 255;
+  }
+  if (_keys[slot] == 0) {
+    _keys[slot] = codepoint;
+    _widths[slot] = w;
+  }
+  return w;
+}
+
+// Japanese line-breaking (kinsoku) rules, reduced to the characters that
+// actually show up in track titles.
+bool TextLayout::noLineStart(uint32_t cp) {
+  switch (cp) {
+  case ',':
+  case '.':
+  case '!':
+  case '?':
+  case ':':
+  case ';':
+  case ')':
+  case ']':
+  case '}':
+  case 0x2019: // ’
+  case 0x201D: // ”
+  case 0x2026: // …
+  case 0x3001: // 、
+  case 0x3002: // 。
+  case 0x3005: // 々
+  case 0x3009: // 〉
+  case 0x300B: // 》
+  case 0x300D: // 」
+  case 0x300F: // 』
+  case 0x3011: // 】
+  case 0x3015: // 〕
+  case 0x301C: // 〜
+  case 0x30FB: // ・
+  case 0x30FC: // ー
+  case 0xFF01: // ！
+  case 0xFF09: // ）
+  case 0xFF0C: // ，
+  case 0xFF0E: // ．
+  case 0xFF1A: // ：
+  case 0xFF1B: // ；
+  case 0xFF1F: // ？
+    return true;
+  }
+  // Small kana
+  switch (cp) {
+  case 0x3041: case 0x3043: case 0x3045: case 0x3047: case 0x3049:
+  case 0x3063: case 0x3083: case 0x3085: case 0x3087: case 0x308E:
+  case 0x30A1: case 0x30A3: case 0x30A5: case 0x30A7: case 0x30A9:
+  case 0x30C3: case 0x30E3: case 0x30E5: case 0x30E7: case 0x30EE:
+  case 0x30F5: case 0x30F6:
+    return true;
+  }
+  return false;
+}
+
+bool TextLayout::noLineEnd(uint32_t cp) {
+  switch (cp) {
+  case '(':
+  case '[':
+  case '{':
+  case 0x2018: // ‘
+  case 0x201C: // “
+  case 0x3008: // 〈
+  case 0x300A: // 《
+  case 0x300C: // 「
+  case 0x300E: // 『
+  case 0x3010: // 【
+  case 0x3014: // 〔
+  case 0xFF08: // （
+    return true;
+  }
+  return false;
+}
+
+// Latin-style text that should only break at spaces.
+static bool isWordGlyph(uint32_t cp) { return cp > ' ' && cp < 0x2E80; }
+
+int TextLayout::decode(const char *text, GlyphWidthCache &widths) {
+  int n = 0;
+  const uint8_t *p = (const uint8_t *)text;
+  const uint8_t *begin = p;
+
+  while (*p && n < MAX_GLYPHS) {
+    uint8_t c = *p;
+    uint8_t len = 1;
+    uint32_t cp = c;
+    if (c >= 0xF0) {
+      len = 4;
+      cp = c & 0x07;
+    } else if (c >= 0xE0) {
+      len = 3;
+      cp = c & 0x0F;
+    } else if (c >= 0xC0) {
+      len = 2;
+      cp = c & 0x1F;
+    }
+    for (uint8_t k = 1; k < len; k++) {
+      if ((p[k] & 0xC0) != 0x80) {
+        len = k; // truncated sequence; take what we have
+        break;
+      }
+      cp = (cp << 6) | (p[k] & 0x3F);
+    }
+
+    _cps[n] = cp;
+    _offsets[n] = p - begin;
+    _adv[n] = widths.width(cp, (const char *)p, len);
+    n++;
+    p += len;
+  }
+  _offsets[n] = p - begin;
+  return n;
+}
+
+int TextLayout::spanWidth(int from, int to) const {
+  int w = 0;
+  for (int i = from; i < to; i++) {
+    w += _adv[i];
+  }
+  return w;
+}
+
+void TextLayout::addLine(int from, int to, bool ellipsis, int ellipsisWidth) {
+  TextLine &l = _lines[_lineCount++];
+  l.start = _offsets[from];
+  l.length = _offsets[to] - _offsets[from];
+  l.width = spanWidth(from, to) + (ellipsis ? ellipsisWidth : 0);
+  l.ellipsis = ellipsis;
+}
+
+int TextLayout::layout(const char *text, GlyphWidthCache &widths,
+                       int maxWidth, int maxLines) {
+  _lineCount = 0;
+  if (maxLines > MAX_LINES) {
+    maxLines = MAX_LINES;
+  }
+
+  int n = decode(text, widths);
+  bool clipped = text[_offsets[n]] != '\0'; // longer than MAX_GLYPHS
+
+  int start = 0;
+  while (start < n && _lineCount < maxLines) {
+    // Continuation lines never start with a space
+    if (_lineCount > 0) {
+      while (start < n && _cps[start] == ' ') {
+        start++;
+      }
+    }
+
+    // Greedy fit
+    int end = start;
+    int w = 0;
+    while (end < n && w + _adv[end] <= maxWidth) {
+      w += _adv[end];
+      end++;
+    }
+    if (end == start && end < n) {
+      end++; // a single glyph wider than the line still has to go somewhere
+    }
+
+    bool lastLine = (_lineCount == maxLines - 1);
+    if (end == n && !(lastLine && clipped)) {
+      addLine(start, end, false, 0);
+      break;
+    }
+
+    if (lastLine) {
+      // Cut so that the text plus "…" fits, dropping trailing spaces
+      char ell[4];
+      memcpy(ell, ELLIPSIS, 4);
+      int ellW = widths.width(ELLIPSIS_CP, ell, 3);
+      while (end > start + 1 &&
+             (spanWidth(start, end) + ellW > maxWidth ||
+              _cps[end - 1] == ' ' || noLineEnd(_cps[end - 1]))) {
+        end--;
+      }
+      addLine(start, end, true, ellW);
+      break;
+    }
+
+    int brk = end;
+    // Keep Latin words whole: back up to the last space on the line
+    if (isWordGlyph(_cps[end]) && isWordGlyph(_cps[end - 1])) {
+      for (int i = end - 1; i > start; i--) {
+        if (_cps[i] == ' ') {
+          brk = i;
+          break;
+        }
+      }
+    }
+    // Kinsoku: move the break earlier while it would strand a character
+    while (brk > start + 1 &&
+           (noLineStart(_cps[brk]) || noLineEnd(_cps[brk - 1]))) {
+      brk--;
+    }
+
+    int trimmed = brk;
+    while (trimmed > start + 1 && _cps[trimmed - 1] == ' ') {
+      trimmed--;
+    }
+    addLine(start, trimmed, false, 0);
+    start = brk;
+  }
+
+  return _lineCount;
+}
+
+void TextLayout::copyLine(const char *text, int i, char *out) const {
+  const TextLine &l = _lines[i];
+  memcpy(out, text + l.start, l.length);
+  out[l.length] = '\0';
+  if (l.ellipsis) {
+    strcpy(out + l.length, ELLIPSIS);
+  }
+}
+
+const char *TextLayout::fitLine(const char *text, GlyphWidthCache &widths,
+                                int maxWidth, char *out) {
+  out[0] = '\0';
+  if (layout(text, widths, maxWidth, 1) > 0) {
+    copyLine(text, 0, out);
+  }
+  return out;
+}
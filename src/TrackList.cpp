@@ -0,0 +1,98 @@
+#include "TrackList.h"
+
+#include <stdlib.h>
+
+TrackWindow::TrackWindow() {
+  _slots = nullptr;
+  _count = 0;
+  _total = -1;
+}
+
+void TrackWindow::begin(ListPage *slots, int count) {
+  _slots = slots;
+  _count = count;
+  reset();
+}
+
+void TrackWindow::reset() {
+  for (int i = 0; i < _count; i++) {
+    _slots[i].offset = -1;
+    _slots[i].count = 0;
+  }
+  _total = -1;
+}
+
+int TrackWindow::indexOf(int offset) const {
+  for (int i = 0; i < _count; i++) {
+    if (_slots[i].offset == offset) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const ListPage *TrackWindow::find(int offset) const {
+  int i = indexOf(offset);
+  return i >= 0 ? &_slots[i] : nullptr;
+}
+
+ListPage *TrackWindow::find(int offset) {
+  int i = indexOf(offset);
+  return i >= 0 ? &_slots[i] : nullptr;
+}
+
+void TrackWindow::insert(const ListPage &page, int focus) {
+  if (_count == 0) {
+    return;
+  }
+  _total = page.total;
+  ListPage *slot = find(page.offset);
+  if (slot == nullptr) {
+    // A free slot, else the page farthest from the focus
+    int farthest = -1;
+    for (int i = 0; i < _count; i++) {
+      if (_slots[i].offset < 0) {
+        slot = &_slots[i];
+        break;
+      }
+      int distance =
+          abs(_slots[i].offset + ListPage::ROWS / 2 - focus);
+      if (distance > farthest) {
+        farthest = distance;
+        slot = &_slots[i];
+      }
+    }
+  }
+  *slot = page;
+}
+
+const ListRow *TrackWindow::row(int index) const {
+  if (index < 0) {
+    return nullptr;
+  }
+  const ListPage *page = find(index - index % ListPage::ROWS);
+  if (page == nullptr || index - page->offset >= page->count) {
+    return nullptr;
+  }
+  return &page->rows[index - page->offset];
+}
+
+int TrackWindow::wanted(int first, int last) const {
+  if (_total < 0) {
+    return find(0) == nullptr ? 0 : -1;
+  }
+  int firstPage = first - first % ListPage::ROWS;
+  int lastPage = last - last % ListPage::ROWS;
+  // Visible pages top to bottom, then one more each way
+  for (int offset = firstPage; offset <= lastPage + ListPage::ROWS;
+       offset += ListPage::ROWS) {
+    if (offset < _total && find(offset) == nullptr) {
+      return offset;
+    }
+  }
+  int above = firstPage - ListPage::ROWS;
+  if (above >= 0 && find(above) == nullptr) {
+    return above;
+  }
+  return -1;
+}
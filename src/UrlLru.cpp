@@ -0,0 +1,74 @@
+#include "UrlLru.h"
+
+#include "Fnv1a.h"
+
+UrlLru::UrlLru() {
+  _entries = nullptr;
+  _slots = 0;
+  _useClock = 0;
+}
+
+UrlLru::~UrlLru() { delete[] _entries; }
+
+bool UrlLru::begin(int slots) {
+  if (slots <= 0) {
+    return false;
+  }
+  _entries = new Entry[slots];
+  for (int i = 0; i < slots; i++) {
+    _entries[i].urlHash = 0;
+    _entries[i].lastUsed = 0;
+  }
+  _slots = slots;
+  return true;
+}
+
+// The hash only skips string compares on the lookup path.
+int UrlLru::lookup(const char *url, uint32_t hash) const {
+  for (int i = 0; i < _slots; i++) {
+    const Entry &e = _entries[i];
+    if (e.lastUsed != 0 && e.urlHash == hash && e.url == url) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int UrlLru::find(const char *url) {
+  int slot = lookup(url, fnv1aString(FNV1A_SEED, url));
+  if (slot >= 0) {
+    _entries[slot].lastUsed = ++_useClock;
+  }
+  return slot;
+}
+
+int UrlLru::peek(const char *url) const {
+  return lookup(url, fnv1aString(FNV1A_SEED, url));
+}
+
+int UrlLru::claim(const char *url, bool &evicted) {
+  evicted = false;
+  if (_slots == 0) {
+    return -1;
+  }
+  uint32_t hash = fnv1aString(FNV1A_SEED, url);
+  int slot = lookup(url, hash);
+  if (slot < 0) {
+    // Prefer a free slot, otherwise evict the least recently used one.
+    slot = 0;
+    for (int i = 0; i < _slots; i++) {
+      if (_entries[i].lastUsed == 0) {
+        slot = i;
+        break;
+      }
+      if (_entries[i].lastUsed < _entries[slot].lastUsed) {
+        slot = i;
+      }
+    }
+    evicted = _entries[slot].lastUsed != 0;
+    _entries[slot].url = url;
+    _entries[slot].urlHash = hash;
+  }
+  _entries[slot].lastUsed = ++_useClock;
+  return slot;
+}
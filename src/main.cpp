@@ -1,205 +1,743 @@
 #include <Arduino.h>
 #include <M5Unified.h>
-#include <SpotifyEsp32.h>
+#include <Preferences.h>
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
 
 #include "DisplayManager.h"
+#include "GestureDetector.h"
+#include "HttpPool.h"
+#include "LastState.h"
+#include "LibrarySync.h"
+#include "ListBrowser.h"
+#include "NetworkTask.h"
+#include "PlayerStore.h"
+#include "SearchScreen.h"
 #include "SpotifyClient.h"
+#include "Telemetry.h"
 #include "secrets.h"
 
 // Globals
-// SpotifyEsp32 handles WiFiClientSecure internally? No, constructor takes
-// client_id/secret only? Let's check constructor signature again. Spotify(const
-// char* client_id, const char * client_secret, const char* refresh_token, int
-// max_num_retry = 3); It creates its own WiFiClientSecure _client inside!! (See
-// header line 709). So we don't pass a client.
+// All HTTPS traffic shares httpPool's kept-alive connections. spotifyClient is
+// only ever called from the network task (core 0); loop() (core 1) talks to
+// it through NetworkTask.
+HttpPool httpPool;
+SpotifyClient spotifyClient(httpPool, SPOTIFY_CLIENT_ID, SPOTIFY_CLIENT_SECRET,
+                            SPOTIFY_REFRESH_TOKEN);
+ArtPrefetcher artPrefetcher(httpPool);
+NetworkTask networkTask(spotifyClient, artPrefetcher);
+DisplayManager displayMsg;
+// The queue / playlist screen; while open it has the panel and the touch.
+ListBrowser listBrowser(networkTask, artPrefetcher);
+// Saved tracks and playlists, synced by the network task, and the search
+// screen over them (which, like the list, takes the panel while open).
+LibrarySync librarySync(spotifyClient);
+SearchScreen searchScreen(librarySync);
+LastState lastState;
+// The UI task's player state: polls and optimistic commands are committed
+// here and the display redraws what changed.
+PlayerStore playerStore;
+#ifdef API_RECORD
+ApiRecorder apiRecorder; // for replay on the host, see ApiRecorder.h
+#endif
 
-Spotify spotify(SPOTIFY_CLIENT_ID, SPOTIFY_CLIENT_SECRET,
-                SPOTIFY_REFRESH_TOKEN);
+unsigned long g_LastProgressFrame = 0;
+unsigned long g_TrackShownAt = 0; // millis() when the track last changed
 
-SpotifyClient spotifyClient(spotify, SPOTIFY_REFRESH_TOKEN);
-DisplayManager displayMsg;
+// Progress is extrapolated locally between polls at this rate; the bar only
+// repaints when its fill actually moves by a pixel.
+const unsigned long PROGRESS_FRAME_MS = 33; // ~30 fps
 
-unsigned long lastUpdate = 0;
-const unsigned long UPDATE_INTERVAL = 3000; // 3 seconds
+// Touch: a horizontal drag from the progress bar seeks, a vertical drag on
+// the track text sets the volume, a swipe on the artwork skips (left/right),
+// opens the queue (up) or search (down). Drags are
+// previewed locally every frame; a seek is sent on release, the volume at
+// most every VOLUME_SEND_MS while dragging (so it can be heard) and on
+// release.
+GestureDetector g_Gestures;
+enum class DragTarget : uint8_t { None, Seek, Volume };
+DragTarget g_Drag = DragTarget::None;
+int g_DragValue = 0;       // seek position (ms) or volume (%) on screen
+int g_DragStartVolume = 0;
+int g_VolumeSent = -1;     // last volume posted during this drag
+unsigned long g_VolumeSentAt = 0;
+const int SEEK_BAND_TOP = 170;     // progress bar at y = 186..190
+const int SEEK_BAND_BOTTOM = 200;
+const int VOLUME_DRAG_PX = 150;    // drag distance for 0 -> 100%
+const unsigned long VOLUME_SEND_MS = 300;
 
-// State vars
-// State vars
-String g_Title, g_Artist, g_Album, g_ArtUrl, g_TrackId;
-String g_LastTrackId = "";
-bool g_IsPlaying = false;
-bool g_IsLiked = false;
-bool g_LikeCheckNeeded = false;
-int g_Progress = 0;
-int g_Duration = 0;
+// Loop stall telemetry: the longest single loop() iteration is reported every
+// STALL_REPORT_INTERVAL so input latency can be checked against API latency.
+const unsigned long STALL_REPORT_INTERVAL = 10000; // 10 seconds
+unsigned long g_MaxLoopUs = 0;
+unsigned long g_LoopCount = 0;
+unsigned long g_LastStallReport = 0;
 
-void setup() {
-  auto cfg = M5.config();
-  M5.begin(cfg);
+// Commands confirmed by a snapshot; when this grows, the next rendered frame
+// closes that command's press-to-screen latency.
+uint32_t g_CommandsConfirmed = 0;
+bool g_CommandShownPending = false;
+uint32_t g_CommandsFailed = 0; // PlayerSnapshot::commandsFailed last seen
 
-  displayMsg.begin();
-  displayMsg.showLoading("Connecting to WiFi...");
+// The track on screen is saved for the next boot's splash once it has stayed
+// this long, so skipping through tracks doesn't write to flash.
+const unsigned long LAST_STATE_DELAY_MS = 10000;
 
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+// Wi-Fi: status is polled at WIFI_POLL_MS. The access point joined last is
+// tried directly first (no scan), then each SSID the usual way.
+const unsigned long WIFI_POLL_MS = 50;
+const unsigned long WIFI_FAST_TIMEOUT_MS = 3000;
+const unsigned long WIFI_TIMEOUT_MS = 10000;
+const unsigned long WIFI_STATUS_INTERVAL = 5000; // "Connecting..." refresh
+
+// Saved in NVS after each successful connection
+struct WiFiCache {
+  uint8_t network; // 1: WIFI_SSID, 2: WIFI_SSID_2
+  uint8_t bssid[6];
+  uint8_t channel;
+};
+
+// Boot timing, millis() since start; logged once live data is on screen
+bool g_Splash = false; // the previous run's state is on screen
+unsigned long g_FirstFrameAt = 0;
+bool g_SnapshotApplied = false;
+bool g_BootReported = false;
+
+// Serial console ("stats", "stats reset", "store"; "rec dump", "rec clear"
+// with API_RECORD)
+char g_SerialLine[32];
+size_t g_SerialLen = 0;
 
-  int dotCount = 0;
-  int maxAttempts = 20; // 10 seconds timeout
-  while (WiFi.status() != WL_CONNECTED && dotCount < maxAttempts) {
-    delay(500);
-    dotCount++;
-    if (dotCount % 10 == 0) {
-      displayMsg.showLoading("WiFi Connecting...");
+// Boot messages are skipped (logged only) while the splash is up.
+void bootStatus(const char *message) {
+  if (g_Splash) {
+    Serial.printf("[boot] %s\n", message);
+    return;
+  }
+  displayMsg.showLoading(message);
+}
+
+bool loadWiFiCache(WiFiCache &cache) {
+  Preferences prefs;
+  if (!prefs.begin("wifi", true)) {
+    return false;
+  }
+  bool ok = prefs.getBytes("ap", &cache, sizeof(cache)) == sizeof(cache);
+  prefs.end();
+  return ok && (cache.network == 1 ||
+                (cache.network == 2 && strlen(WIFI_SSID_2) > 0));
+}
+
+void saveWiFiCache(uint8_t network) {
+  WiFiCache cache;
+  cache.network = network;
+  memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+  cache.channel = WiFi.channel();
+
+  WiFiCache saved;
+  if (loadWiFiCache(saved) && memcmp(&saved, &cache, sizeof(cache)) == 0) {
+    return; // same access point as last time: no flash write
+  }
+  Preferences prefs;
+  if (prefs.begin("wifi", false)) {
+    prefs.putBytes("ap", &cache, sizeof(cache));
+    prefs.end();
+  }
+}
+
+bool waitForWiFi(unsigned long timeoutMs, const char *message) {
+  unsigned long start = millis();
+  unsigned long lastMessage = start;
+  while (WiFi.status() != WL_CONNECTED) {
+    if (millis() - start >= timeoutMs) {
+      return false;
+    }
+    delay(WIFI_POLL_MS);
+    if (message != nullptr && millis() - lastMessage >= WIFI_STATUS_INTERVAL) {
+      bootStatus(message);
+      lastMessage = millis();
+    }
+  }
+  return true;
+}
+
+// Returns the network joined (1 or 2), or 0.
+uint8_t connectWiFi() {
+  WiFiCache cache;
+  if (loadWiFiCache(cache)) {
+    if (cache.network == 2) {
+      WiFi.begin(WIFI_SSID_2, WIFI_PASSWORD_2, cache.channel, cache.bssid);
+    } else {
+      WiFi.begin(WIFI_SSID, WIFI_PASSWORD, cache.channel, cache.bssid);
+    }
+    if (waitForWiFi(WIFI_FAST_TIMEOUT_MS, nullptr)) {
+      return cache.network;
     }
+    Serial.println("[boot] cached access point failed, scanning");
+    WiFi.disconnect();
+    delay(100);
+  }
+
+  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  if (waitForWiFi(WIFI_TIMEOUT_MS, "WiFi Connecting...")) {
+    return 1;
   }
 
   // If first WiFi failed and second WiFi is configured, try it
-  if (WiFi.status() != WL_CONNECTED && strlen(WIFI_SSID_2) > 0) {
-    displayMsg.showLoading("Trying WiFi 2...");
+  if (strlen(WIFI_SSID_2) > 0) {
+    bootStatus("Trying WiFi 2...");
     WiFi.disconnect();
     delay(100);
     WiFi.begin(WIFI_SSID_2, WIFI_PASSWORD_2);
-
-    dotCount = 0;
-    while (WiFi.status() != WL_CONNECTED && dotCount < maxAttempts) {
-      delay(500);
-      dotCount++;
-      if (dotCount % 10 == 0) {
-        displayMsg.showLoading("WiFi 2 Connecting...");
-      }
+    if (waitForWiFi(WIFI_TIMEOUT_MS, "WiFi 2 Connecting...")) {
+      return 2;
     }
   }
+  return 0;
+}
+
+// Dates the track on screen for saveLastState()
+void onTrackChanged(void *ctx, const PlayerState &state, uint16_t changed) {
+  g_TrackShownAt = millis();
+}
+
+void setup() {
+  auto cfg = M5.config();
+  M5.begin(cfg);
+  Telemetry::registerTask("loop", xTaskGetCurrentTaskHandle());
+
+  displayMsg.begin();
+  displayMsg.attach(playerStore);
+  playerStore.subscribe(PlayerStore::Track, onTrackChanged, nullptr);
+
+  // The previous run's track, on screen while the network comes up; live
+  // data for the same track then changes nothing.
+  TrackInfo last;
+  const uint16_t *lastArt = lastState.begin() ? lastState.load(last) : nullptr;
+  if (lastArt != nullptr) {
+    displayMsg.seedArt(last.artUrl.c_str(), lastArt);
+    playerStore.edit().track = last;
+    playerStore.commit(PlayerStore::Splash);
+    displayMsg.render();
+    g_Splash = true;
+    g_FirstFrameAt = millis();
+    Serial.printf("[boot] splash at %lu ms\n", g_FirstFrameAt);
+  }
+
+  bootStatus("Connecting to WiFi...");
+  WiFi.mode(WIFI_STA);
+  unsigned long wifiStart = millis();
+  uint8_t network = connectWiFi();
 
   // Check if connected
-  if (WiFi.status() != WL_CONNECTED) {
+  if (network == 0) {
     displayMsg.showError("WiFi Failed!");
     while (true) {
       delay(1000);
     }
   }
+  saveWiFiCache(network);
+  Serial.printf("[boot] WiFi %u connected in %lu ms (at %lu ms)\n", network,
+                millis() - wifiStart, millis());
+
+  bootStatus("WiFi Connected! Setup Spotify...");
+
+  // Wall-clock time only dates the saved access token; SNTP sets it in the
+  // background.
+  configTime(0, 0, "pool.ntp.org", "time.google.com");
+
+  // Reuses the access token saved by the last run while it is still valid;
+  // the network task renews it ahead of expiry.
+  httpPool.begin();
+#ifdef API_RECORD
+  if (apiRecorder.begin()) {
+    httpPool.setRecorder(&apiRecorder);
+  }
+#endif
+  spotifyClient.begin();
+
+  if (artPrefetcher.begin()) {
+    displayMsg.setPrefetcher(&artPrefetcher);
+  }
+
+  // Needs the filesystem, mounted by lastState.begin()
+  if (librarySync.begin()) {
+    networkTask.setLibrary(&librarySync);
+  }
+  if (!networkTask.begin(0)) {
+    displayMsg.showError("Network task failed!");
+    while (true) {
+      delay(1000);
+    }
+  }
+  listBrowser.begin();
+  searchScreen.begin();
+
+#ifdef TEXT_LAYOUT_BENCH
+  displayMsg.benchmarkTextLayout();
+#endif
+
+  bootStatus("Ready.");
+}
+
+void togglePlayback() {
+  PlayerState &s = playerStore.edit();
+  networkTask.post(s.isPlaying ? NetCommandType::Pause : NetCommandType::Play);
+
+  // Optimistic UI update; freeze (or restart) extrapolation from here
+  unsigned long now = millis();
+  s.progressMs = s.position(now);
+  s.progressAt = now;
+  s.isPlaying = !s.isPlaying;
+  playerStore.commit(PlayerStore::Command);
+}
+
+void skipToNext() {
+  networkTask.post(NetCommandType::Next);
+
+  // Draw the queued track immediately (its art is usually prefetched); the
+  // network task makes the same swap once the skip succeeds.
+  if (!playerStore.state().next.id.isEmpty()) {
+    PlayerState &s = playerStore.edit();
+    s.track = s.next;
+    s.progressMs = 0;
+    s.progressAt = millis();
+    s.isLiked = s.nextIsLiked;
+    s.next.clear();
+    s.nextIsLiked = false;
+    playerStore.commit(PlayerStore::Command);
+  }
+}
+
+void toggleLike() {
+  const TrackInfo &track = playerStore.state().track;
+  if (track.id.isEmpty()) {
+    return;
+  }
+  bool liked = playerStore.state().isLiked;
+  networkTask.post(liked ? NetCommandType::Unlike : NetCommandType::Like,
+                   track.id.c_str());
+
+  // Optimistic; rolled back by the next snapshot if the call fails
+  playerStore.edit().isLiked = !liked;
+  playerStore.commit(PlayerStore::Command);
+}
+
+void handleTap(int x, int y) {
+  if (y > 180) { // Bottom area on screen
+    if (x < 110) {
+      networkTask.post(NetCommandType::Previous);
+    } else if (x > 110 && x < 210) {
+      // Play/Pause
+      togglePlayback();
+    } else if (x > 210) {
+      skipToNext();
+    }
+  } else if (x < 180) {
+    // Like Button Area (Entire Artwork 180x180)
+    toggleLike();
+  }
+}
+
+int seekPosition(int x) {
+  if (x < 0) {
+    x = 0;
+  } else if (x > 320) {
+    x = 320;
+  }
+  return (int)((int64_t)playerStore.state().track.durationMs * x / 320);
+}
+
+int dragVolume(const Gesture &g) {
+  int v = g_DragStartVolume +
+          (g.startY - g.y) * 100 / VOLUME_DRAG_PX; // up is louder
+  return v < 0 ? 0 : (v > 100 ? 100 : v);
+}
+
+void startDrag(const Gesture &g) {
+  const PlayerState &state = playerStore.state();
+  if (g.axis == DragAxis::Horizontal && g.startY >= SEEK_BAND_TOP &&
+      g.startY < SEEK_BAND_BOTTOM && state.track.durationMs > 0) {
+    g_Drag = DragTarget::Seek;
+  } else if (g.axis == DragAxis::Vertical && g.startX >= 180 &&
+             g.startY < 180 && state.volumePercent >= 0) {
+    g_Drag = DragTarget::Volume;
+    g_DragStartVolume = state.volumePercent;
+    g_VolumeSent = state.volumePercent;
+  }
+}
+
+void moveDrag(const Gesture &g) {
+  if (g_Drag == DragTarget::Seek) {
+    g_DragValue = seekPosition(g.x);
+    displayMsg.previewSeek(g_DragValue);
+  } else if (g_Drag == DragTarget::Volume) {
+    g_DragValue = dragVolume(g);
+    displayMsg.showVolume(g_DragValue);
+    unsigned long now = millis();
+    if (g_DragValue != g_VolumeSent && now - g_VolumeSentAt >= VOLUME_SEND_MS &&
+        networkTask.post(NetCommandType::Volume, g_DragValue)) {
+      g_VolumeSent = g_DragValue;
+      g_VolumeSentAt = now;
+    }
+  }
+}
 
-  displayMsg.showLoading("WiFi Connected! Setup Spotify...");
+void endDrag() {
+  if (g_Drag == DragTarget::Seek) {
+    networkTask.post(NetCommandType::Seek, g_DragValue);
+    // Optimistic; the bar continues from the new position
+    PlayerState &s = playerStore.edit();
+    s.progressMs = g_DragValue;
+    s.progressAt = millis();
+    playerStore.commit(PlayerStore::Command);
+    displayMsg.endSeekPreview();
+  } else if (g_Drag == DragTarget::Volume) {
+    if (g_DragValue != g_VolumeSent) {
+      networkTask.post(NetCommandType::Volume, g_DragValue);
+    }
+    playerStore.edit().volumePercent = g_DragValue;
+    playerStore.commit(PlayerStore::Command);
+    displayMsg.hideVolume();
+  }
+  g_Drag = DragTarget::None;
+}
 
-  // SpotifyEsp32.begin() might seem to be for web server auth?
-  // Header says "start the server and begin authentication".
-  // If we have refresh token, we might not need to call begin() for
-  // *interactive* auth? But maybe for initialization? See examples if possible.
-  // Usually libraries with refresh token Just Work. However, verify if
-  // getAccessToken needs to be called.
+void openList(ListSource source) {
+  endDrag();
+  listBrowser.open(source);
+  displayMsg.setCovered(true);
+}
+
+void closeList() {
+  listBrowser.close();
+  displayMsg.setCovered(false);
+}
 
-  // We can try to just run. If methods return 401, the library should refresh.
-  // Let's call a benign method to "wake up" or check auth.
+void openSearch() {
+  endDrag();
+  searchScreen.open();
+  displayMsg.setCovered(true);
+}
 
-  displayMsg.showLoading("Ready.");
+void closeSearch() {
+  searchScreen.close();
+  displayMsg.setCovered(false);
+}
+
+// Touch while search is open: taps type or play a result, vertical drags
+// over the results scroll them, holding delete clears the query.
+void handleSearchTouch(const Gesture &g) {
+  char id[LibraryIndex::ID_LEN + 1];
+  bool playlist;
+  switch (g.type) {
+  case GestureType::Tap:
+    switch (searchScreen.tap(g.startX, g.startY, id, playlist)) {
+    case SearchScreen::Close:
+      closeSearch();
+      break;
+    case SearchScreen::Play:
+      networkTask.post(playlist ? NetCommandType::PlayPlaylist
+                                : NetCommandType::PlayTrack,
+                       id);
+      closeSearch();
+      break;
+    case SearchScreen::NoAction:
+      break;
+    }
+    break;
+  case GestureType::LongPress:
+    searchScreen.longPress(g.startX, g.startY);
+    break;
+  case GestureType::DragStart:
+  case GestureType::DragMove:
+    if (g.axis == DragAxis::Vertical) {
+      searchScreen.drag(g.y);
+    }
+    break;
+  case GestureType::Swipe:
+  case GestureType::DragEnd:
+    searchScreen.release();
+    break;
+  case GestureType::None:
+    break;
+  }
+}
+
+// Touch while the list is open: vertical drags scroll it (a swipe keeps
+// going), the header goes back or switches list, a row starts that track.
+void handleListTouch(const Gesture &g) {
+  int row;
+  switch (g.type) {
+  case GestureType::Tap:
+    switch (listBrowser.tap(g.startX, g.startY, row)) {
+    case ListBrowser::Close:
+      closeList();
+      break;
+    case ListBrowser::Switch:
+      listBrowser.open(listBrowser.source() == ListSource::Queue
+                           ? ListSource::Playlist
+                           : ListSource::Queue);
+      break;
+    case ListBrowser::Play:
+      networkTask.post(listBrowser.source() == ListSource::Queue
+                           ? NetCommandType::PlayQueued
+                           : NetCommandType::PlayInPlaylist,
+                       row);
+      closeList();
+      break;
+    case ListBrowser::NoAction:
+      break;
+    }
+    break;
+  case GestureType::DragStart:
+  case GestureType::DragMove:
+    if (g.axis == DragAxis::Vertical) {
+      listBrowser.drag(g.y);
+    }
+    break;
+  case GestureType::Swipe:
+  case GestureType::DragEnd:
+    listBrowser.release();
+    break;
+  case GestureType::LongPress:
+  case GestureType::None:
+    break;
+  }
 }
 
 void handleTouch() {
   auto t = M5.Touch.getDetail();
-  if (t.wasPressed()) {
-    int x = t.x;
-    int y = t.y;
-
-    // Only handle touch within the screen area (exclude physical button area
-    // below screen)
-    // Only handle touch within the screen area (exclude physical button area
-    // below screen)
-    if (y > 180 && y < 240) { // Bottom area on screen
-      if (x < 110) {
-        spotifyClient.previous();
-      } else if (x > 110 && x < 210) {
-        // Play/Pause
-        if (g_IsPlaying)
-          spotifyClient.pause();
-        else
-          spotifyClient.play();
-
-        g_IsPlaying = !g_IsPlaying;
-        displayMsg.updatePlaybackState(g_IsPlaying, g_Progress, g_Duration);
-        lastUpdate = millis();
-      } else if (x > 210) {
-        spotifyClient.next();
-      }
-    } else if (x < 180 && y < 180) {
-      // Like Button Area (Entire Artwork 180x180)
+  Gesture g;
+  if (!g_Gestures.update(t.isPressed(), t.x, t.y, millis(), g)) {
+    return;
+  }
+  // Only handle touch within the screen area (exclude physical button area
+  // below screen)
+  if (g.startY >= 240) {
+    return;
+  }
+  if (listBrowser.isOpen()) {
+    handleListTouch(g);
+    return;
+  }
+  if (searchScreen.isOpen()) {
+    handleSearchTouch(g);
+    return;
+  }
 
-      if (g_IsLiked) {
-        if (spotifyClient.unlikeTrack(g_TrackId.c_str())) {
-          g_IsLiked = false;
+  switch (g.type) {
+  case GestureType::Tap:
+    handleTap(g.startX, g.startY);
+    break;
+  case GestureType::LongPress:
+    networkTask.post(NetCommandType::Refresh); // re-sync now
+    break;
+  case GestureType::DragStart:
+    startDrag(g);
+    moveDrag(g);
+    break;
+  case GestureType::DragMove:
+    moveDrag(g);
+    break;
+  case GestureType::Swipe:
+    // Left for the next track, right for the previous one, up for the
+    // queue, down for search
+    if (g_Drag == DragTarget::None && g.startX < 180 && g.startY < 180) {
+      if (g.axis == DragAxis::Horizontal) {
+        if (g.direction < 0) {
+          skipToNext();
+        } else {
+          networkTask.post(NetCommandType::Previous);
         }
+      } else if (g.direction < 0) {
+        openList(ListSource::Queue);
+        break;
       } else {
-        if (spotifyClient.likeTrack(g_TrackId.c_str())) {
-          g_IsLiked = true;
-        }
+        openSearch();
+        break;
       }
-      displayMsg.updateControlState(false, "off", g_IsLiked);
     }
+    endDrag();
+    break;
+  case GestureType::DragEnd:
+    endDrag();
+    break;
+  case GestureType::None:
+    break;
   }
 }
 
 // Physical buttons
 void handlePhysicalButtons() {
   if (M5.BtnA.wasPressed()) {
-    spotifyClient.previous();
+    networkTask.post(NetCommandType::Previous);
   }
   if (M5.BtnB.wasPressed()) {
-    if (g_IsPlaying)
-      spotifyClient.pause();
-    else
-      spotifyClient.play();
-
-    // Optimistic UI update
-    g_IsPlaying = !g_IsPlaying;
-    displayMsg.updatePlaybackState(g_IsPlaying, g_Progress, g_Duration);
-    lastUpdate = millis();
+    togglePlayback();
   }
   if (M5.BtnC.wasPressed()) {
-    spotifyClient.next();
+    skipToNext();
   }
 }
 
-void loop() {
-  M5.update();
-  handleTouch();
-  handlePhysicalButtons();
+void applySnapshot() {
+  PlayerSnapshot snap;
+  if (!networkTask.poll(snap)) {
+    return;
+  }
 
-  if (millis() - lastUpdate > UPDATE_INTERVAL) {
-    lastUpdate = millis();
-
-    // Fetch Data
-    // Fetch Data
-    int status = spotifyClient.getNowPlaying(g_Title, g_Artist, g_Album,
-                                             g_ArtUrl, g_TrackId, g_IsPlaying,
-                                             g_Progress, g_Duration);
-
-    if (status == 200) {
-      if (g_TrackId != g_LastTrackId) {
-        // Track Changed
-        g_LastTrackId = g_TrackId;
-        g_LikeCheckNeeded = true;
-        // Reset Like State visually until checked
-        g_IsLiked = false;
-      }
+  // Ignore state from before our latest command (it would undo the
+  // optimistic update); the task publishes again right after executing it.
+  if (snap.commandsApplied < networkTask.commandsPosted()) {
+    return;
+  }
+  if (snap.commandsApplied > g_CommandsConfirmed) {
+    g_CommandsConfirmed = snap.commandsApplied;
+    g_CommandShownPending = true;
+  }
+  if (snap.commandsFailed > g_CommandsFailed) {
+    // Applying the snapshot below undoes the optimistic update
+    Serial.printf("[cmd] %u API calls failed, UI rolled back\n",
+                  snap.commandsFailed - g_CommandsFailed);
+    g_CommandsFailed = snap.commandsFailed;
+  }
 
-      // Perform Like Check if needed
-      if (g_LikeCheckNeeded) {
-        bool likedState = false;
-        if (spotifyClient.getLikeState(g_TrackId.c_str(), likedState)) {
-          g_IsLiked = likedState;
-          g_LikeCheckNeeded = false; // Check complete
-        } else {
-          // API Failed (e.g. rate limit, network).
-          // Keep g_LikeCheckNeeded = true to retry next loop.
-        }
-      }
+  g_SnapshotApplied = true;
 
-      displayMsg.updateNowPlaying(g_Title, g_Artist, g_Album, g_ArtUrl);
-      displayMsg.updatePlaybackState(g_IsPlaying, g_Progress, g_Duration);
-      displayMsg.updateControlState(false, "off",
-                                    g_IsLiked); // Ensure button redraw
-    } else {
-      // Debug
-      Serial.printf("Status: %d\n", status);
+  if (snap.status != 200) {
+    // Debug
+    Serial.printf("Status: %d\n", snap.status);
+    return;
+  }
+
+  // Only what differs from the screen is redrawn (usually the progress
+  // anchor, which draws nothing)
+  PlayerState &s = playerStore.edit();
+  s.track = snap.track;
+  s.isPlaying = snap.isPlaying;
+  s.isLiked = snap.isLiked;
+  s.progressMs = snap.progressMs;
+  s.progressAt = snap.fetchedAt;
+  s.volumePercent = snap.volumePercent;
+  s.next = snap.next;
+  s.nextIsLiked = snap.nextIsLiked;
+  playerStore.commit(PlayerStore::Poll);
+}
+
+// Animation frames: the progress bar and any scrolling text, or the list or
+// search screen.
+void tickFrame() {
+  unsigned long now = millis();
+  if (now - g_LastProgressFrame < PROGRESS_FRAME_MS) {
+    return;
+  }
+  g_LastProgressFrame = now;
+  if (listBrowser.isOpen()) {
+    listBrowser.tick();
+    return;
+  }
+  if (searchScreen.isOpen()) {
+    searchScreen.tick();
+    return;
+  }
+  displayMsg.tickProgress();
+  displayMsg.tickMarquee(networkTask.busy() || artPrefetcher.busy());
+}
+
+// Keeps the track on screen in flash for the next boot's splash.
+void saveLastState() {
+  lastState.step();
+  const TrackInfo &track = playerStore.state().track;
+  if (track.id.isEmpty() || track.hash == lastState.savedHash() ||
+      lastState.saving() ||
+      millis() - g_TrackShownAt < LAST_STATE_DELAY_MS) {
+    return;
+  }
+  const uint16_t *tile = displayMsg.artTile(track.artUrl.c_str());
+  if (tile != nullptr) { // else its art is still loading
+    lastState.save(track, tile);
+  }
+}
+
+// Boot-to-first-frame (splash or live) and boot-to-live-data, once.
+void reportBoot() {
+  if (g_BootReported || !g_SnapshotApplied) {
+    return;
+  }
+  g_BootReported = true;
+  unsigned long now = millis();
+  if (g_FirstFrameAt == 0) {
+    g_FirstFrameAt = now;
+  }
+  Serial.printf("[boot] first frame at %lu ms (%s), live data at %lu ms\n",
+                g_FirstFrameAt, g_Splash ? "splash" : "live", now);
+}
+
+void reportLoopStall(unsigned long loopUs) {
+  g_LoopCount++;
+  if (loopUs > g_MaxLoopUs) {
+    g_MaxLoopUs = loopUs;
+  }
+
+  unsigned long now = millis();
+  if (now - g_LastStallReport >= STALL_REPORT_INTERVAL) {
+    Serial.printf("[loop] max stall %lu us over %lu iterations\n",
+                  g_MaxLoopUs, g_LoopCount);
+    g_LastStallReport = now;
+    g_MaxLoopUs = 0;
+    g_LoopCount = 0;
+  }
+}
+
+void handleSerialCommand() {
+  while (Serial.available() > 0) {
+    char c = Serial.read();
+    if (c != '\n' && c != '\r') {
+      if (g_SerialLen < sizeof(g_SerialLine) - 1) {
+        g_SerialLine[g_SerialLen++] = c;
+      }
+      continue;
     }
+    g_SerialLine[g_SerialLen] = '\0';
+    if (strcmp(g_SerialLine, "stats") == 0) {
+      Telemetry::dump(Serial);
+    } else if (strcmp(g_SerialLine, "stats reset") == 0) {
+      Telemetry::reset();
+      Serial.println("[telemetry] reset");
+    } else if (strcmp(g_SerialLine, "store") == 0) {
+      playerStore.report(Serial);
+#ifdef API_RECORD
+    } else if (strcmp(g_SerialLine, "rec dump") == 0) {
+      apiRecorder.dump(Serial);
+    } else if (strcmp(g_SerialLine, "rec clear") == 0) {
+      apiRecorder.clear();
+#endif
+    }
+    g_SerialLen = 0;
+  }
+}
+
+void loop() {
+  unsigned long loopStart = micros();
+
+  M5.update();
+  handleTouch();
+  handlePhysicalButtons();
+  applySnapshot();
+  tickFrame();
+  displayMsg.render();
+  listBrowser.render();
+  searchScreen.render();
+  if (g_CommandShownPending) {
+    g_CommandShownPending = false;
+    Telemetry::record(Stage::CommandShown,
+                      micros() - networkTask.lastPostedAt());
   }
+  reportBoot();
+  saveLastState();
+  playerStore.maybeReport(Serial);
+  handleSerialCommand();
+
+  reportLoopStall(micros() - loopStart);
 }
@@ -0,0 +1,97 @@
+#include "Framebuffer.h"
+
+#include <string.h>
+
+SoftFramebuffer565::SoftFramebuffer565(int w, int h) : _pixels(w * h, 0) {
+  _w = w;
+  _h = h;
+  _fontSize = 16;
+  _pixelsWritten = 0;
+}
+
+void SoftFramebuffer565::fillRect(int x, int y, int w, int h,
+                                  uint16_t color) {
+  // Clip to the buffer
+  if (x < 0) {
+    w += x;
+    x = 0;
+  }
+  if (y < 0) {
+    h += y;
+    y = 0;
+  }
+  if (x + w > _w) {
+    w = _w - x;
+  }
+  if (y + h > _h) {
+    h = _h - y;
+  }
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+
+  for (int row = y; row < y + h; row++) {
+    uint16_t *p = &_pixels[row * _w + x];
+    for (int i = 0; i < w; i++) {
+      p[i] = color;
+    }
+  }
+  _pixelsWritten += w * h;
+}
+
+uint32_t SoftFramebuffer565::next(const char *&p) {
+  const uint8_t *s = (const uint8_t *)p;
+  uint32_t cp = s[0];
+  int len = 1;
+  if (cp >= 0xF0) {
+    cp &= 0x07;
+    len = 4;
+  } else if (cp >= 0xE0) {
+    cp &= 0x0F;
+    len = 3;
+  } else if (cp >= 0xC0) {
+    cp &= 0x1F;
+    len = 2;
+  }
+  for (int k = 1; k < len && s[k] != 0; k++) {
+    cp = (cp << 6) | (s[k] & 0x3F);
+  }
+  p += len;
+  return cp;
+}
+
+int SoftFramebuffer565::glyphWidth(uint32_t cp) const {
+  if (cp >= 0x2E80) {
+    return _fontSize; // full-width
+  }
+  if (cp == ' ' || (cp < 0x80 && strchr("il.,:;'|!()[]", (int)cp))) {
+    return _fontSize * 3 / 10;
+  }
+  if (cp == 'm' || cp == 'w' || (cp >= 'A' && cp <= 'Z')) {
+    return _fontSize * 7 / 10;
+  }
+  return _fontSize * 11 / 20;
+}
+
+int SoftFramebuffer565::textWidth(const char *utf8) {
+  int w = 0;
+  for (const char *p = utf8; *p != '\0';) {
+    w += glyphWidth(next(p));
+  }
+  return w;
+}
+
+void SoftFramebuffer565::drawString(const char *utf8, int x, int y,
+                                    uint16_t color) {
+  for (const char *p = utf8; *p != '\0';) {
+    int gw = glyphWidth(next(p));
+    fillRect(x + 1, y + 2, gw - 2, _fontSize, color);
+    x += gw;
+  }
+}
+
+uint32_t SoftFramebuffer565::takePixelsWritten() {
+  uint32_t n = _pixelsWritten;
+  _pixelsWritten = 0;
+  return n;
+}
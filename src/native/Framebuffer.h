@@ -0,0 +1,48 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdint.h>
+#include <vector>
+
+// Drawing surface the benchmark renders through, the subset of LovyanGFX
+// that DisplayManager's text and progress code relies on.
+class Framebuffer {
+public:
+  virtual ~Framebuffer() {}
+
+  virtual void fillRect(int x, int y, int w, int h, uint16_t color) = 0;
+  // Selects a font by nominal pixel size (16 or 20 on the device).
+  virtual void setFontSize(int px) = 0;
+  virtual int fontHeight() const = 0;
+  virtual int textWidth(const char *utf8) = 0;
+  virtual void drawString(const char *utf8, int x, int y, uint16_t color) = 0;
+};
+
+// RGB565 framebuffer in host memory. Glyphs are drawn as filled boxes with
+// metrics approximating lgfxJapanGothicP (full-width CJK, proportional
+// Latin), which is all that layout and pixel counts depend on.
+class SoftFramebuffer565 : public Framebuffer {
+public:
+  SoftFramebuffer565(int w, int h);
+
+  void fillRect(int x, int y, int w, int h, uint16_t color) override;
+  void setFontSize(int px) override { _fontSize = px; }
+  int fontHeight() const override { return _fontSize + 4; }
+  int textWidth(const char *utf8) override;
+  void drawString(const char *utf8, int x, int y, uint16_t color) override;
+
+  // Pixels written since the last call
+  uint32_t takePixelsWritten();
+  const uint16_t *pixels() const { return _pixels.data(); }
+
+private:
+  int _w, _h;
+  int _fontSize;
+  std::vector<uint16_t> _pixels;
+  uint32_t _pixelsWritten;
+
+  int glyphWidth(uint32_t cp) const;
+  static uint32_t next(const char *&p);
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef HTTP_TRANSPORT_H
+#define HTTP_TRANSPORT_H
+
+#include <string>
+
+// Minimal request interface the native benchmark drives the Spotify parsing
+// through. On the device the same role is played by HttpPool + HTTPClient.
+class HttpTransport {
+public:
+  virtual ~HttpTransport() {}
+
+  // Performs a GET on an API path (e.g. "/me/player/queue"), fills `body`
+  // and returns the HTTP status.
+  virtual int get(const char *path, std::string &body) = 0;
+};
+
+#endif
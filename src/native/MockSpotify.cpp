@@ -0,0 +1,59 @@
+#include "MockSpotify.h"
+
+#include <stdio.h>
+#include <string.h>
+
+MockSpotify::MockSpotify(const std::string &fixtureDir) {
+  _dir = fixtureDir;
+  _steps = nullptr;
+  _stepCount = 0;
+  _requests = 0;
+}
+
+bool MockSpotify::load(const Step *steps, int count) {
+  _steps = steps;
+  _stepCount = count;
+  _cursor.clear();
+
+  for (int i = 0; i < count; i++) {
+    const char *name = steps[i].fixture;
+    if (name == nullptr || _bodies.count(name) > 0) {
+      continue;
+    }
+    std::string path = _dir + "/" + name;
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+      fprintf(stderr, "[mock] cannot read %s\n", path.c_str());
+      return false;
+    }
+    std::string body;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+      body.append(buf, n);
+    }
+    fclose(f);
+    _bodies[name] = body;
+  }
+  return true;
+}
+
+int MockSpotify::get(const char *path, std::string &body) {
+  _requests++;
+  body.clear();
+
+  // Find the path's next step, searching from its cursor and wrapping
+  int &cursor = _cursor[path];
+  for (int k = 0; k < _stepCount; k++) {
+    int i = (cursor + k) % _stepCount;
+    if (strcmp(_steps[i].path, path) != 0) {
+      continue;
+    }
+    cursor = i + 1;
+    if (_steps[i].fixture != nullptr) {
+      body = _bodies[_steps[i].fixture];
+    }
+    return _steps[i].status;
+  }
+  return 404;
+}
@@ -0,0 +1,40 @@
+#ifndef MOCK_SPOTIFY_H
+#define MOCK_SPOTIFY_H
+
+#include <map>
+#include <string>
+
+#include "HttpTransport.h"
+
+// Spotify Web API stand-in that replays recorded responses.
+//
+// A script lists, per path, the replies to return in order (wrapping
+// around). Fixture files are read up front so file I/O never shows up in
+// the timings.
+class MockSpotify : public HttpTransport {
+public:
+  struct Step {
+    const char *path;
+    int status;
+    const char *fixture; // file in the fixture directory, or nullptr
+  };
+
+  explicit MockSpotify(const std::string &fixtureDir);
+
+  // Returns false if a fixture could not be read.
+  bool load(const Step *steps, int count);
+
+  int get(const char *path, std::string &body) override;
+
+  uint32_t requests() const { return _requests; }
+
+private:
+  std::string _dir;
+  const Step *_steps;
+  int _stepCount;
+  std::map<std::string, int> _cursor; // path -> index of its next step
+  std::map<std::string, std::string> _bodies;
+  uint32_t _requests;
+};
+
+#endif
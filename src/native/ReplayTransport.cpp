@@ -0,0 +1,145 @@
+#include "ReplayTransport.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char *API_PREFIX = "/v1"; // recorded paths include it
+
+ReplayTransport::ReplayTransport() {
+  _rng.seed(_faults.seed);
+  _recordCount = 0;
+  _cutCount = 0;
+  _spanMs = 0;
+  _lastLatencyMs = 0;
+  _lastRetryAfterMs = 0;
+  _faultsInjected = 0;
+}
+
+bool ReplayTransport::load(const char *file) {
+  FILE *f = fopen(file, "rb");
+  if (f == nullptr) {
+    fprintf(stderr, "[replay] cannot read %s\n", file);
+    return false;
+  }
+  std::string data;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    data.append(buf, n);
+  }
+  fclose(f);
+
+  _paths.clear();
+  _recordCount = 0;
+  _cutCount = 0;
+  unsigned long first = 0, last = 0;
+  size_t pos = 0;
+  while (pos < data.size()) {
+    size_t eol = data.find('\n', pos);
+    if (eol == std::string::npos) {
+      break;
+    }
+    std::string header = data.substr(pos, eol - pos);
+    unsigned long startedAt, latencyMs;
+    long retryAfterSec;
+    char method[8], path[256];
+    int status;
+    size_t bodyBytes;
+    int end = 0;
+    if (sscanf(header.c_str(), "REQ %lu %7s %255s %d %lu %ld %zu%n",
+               &startedAt, method, path, &status, &latencyMs, &retryAfterSec,
+               &bodyBytes, &end) != 7 ||
+        eol + 1 + bodyBytes + 1 > data.size()) {
+      fprintf(stderr, "[replay] %s: bad record at byte %zu\n", file, pos);
+      return false;
+    }
+    pos = eol + 1 + bodyBytes + 1;
+
+    if (_recordCount++ == 0) {
+      first = startedAt;
+    }
+    last = startedAt;
+    if (strcmp(method, "GET") != 0) {
+      continue; // commands are not replayed
+    }
+    if (strcmp(header.c_str() + end, " cut") == 0) {
+      _cutCount++; // would only replay as a parse error
+      continue;
+    }
+    const char *apiPath = path;
+    if (strncmp(apiPath, API_PREFIX, strlen(API_PREFIX)) == 0) {
+      apiPath += strlen(API_PREFIX);
+    }
+    Reply r;
+    r.status = status;
+    r.latencyMs = latencyMs;
+    r.retryAfterSec = retryAfterSec > 0 ? retryAfterSec : 0;
+    r.body = data.substr(eol + 1, bodyBytes);
+    _paths[apiPath].list.push_back(r);
+  }
+  _spanMs = last - first;
+  return _recordCount > 0;
+}
+
+void ReplayTransport::setFaults(const Faults &faults) {
+  _faults = faults;
+  _rng.seed(faults.seed);
+}
+
+bool ReplayTransport::chance(double p) {
+  return p > 0 && std::uniform_real_distribution<double>(0, 1)(_rng) < p;
+}
+
+uint32_t ReplayTransport::latency(uint32_t recordedMs) {
+  long ms = (long)(recordedMs * _faults.latencyScale);
+  if (_faults.jitterMs > 0) {
+    ms += std::uniform_int_distribution<long>(-(long)_faults.jitterMs,
+                                              _faults.jitterMs)(_rng);
+  }
+  if (chance(_faults.slowRate)) {
+    ms += _faults.slowMs;
+    _faultsInjected++;
+  }
+  return ms < 0 ? 0 : (uint32_t)ms;
+}
+
+int ReplayTransport::get(const char *path, std::string &body) {
+  body.clear();
+  _lastRetryAfterMs = 0;
+
+  auto it = _paths.find(path);
+  if (it == _paths.end() || it->second.list.empty()) {
+    _lastLatencyMs = latency(0);
+    return 404;
+  }
+  Replies &replies = it->second;
+  const Reply &r = replies.list[replies.next];
+  replies.next = (replies.next + 1) % replies.list.size();
+  _lastLatencyMs = latency(r.latencyMs);
+
+  // Faults replace the recorded reply
+  if (chance(_faults.timeoutRate)) {
+    _faultsInjected++;
+    _lastLatencyMs = _faults.timeoutMs;
+    return -11; // HTTPC_ERROR_READ_TIMEOUT
+  }
+  if (chance(_faults.rateLimitRate)) {
+    _faultsInjected++;
+    _lastRetryAfterMs = _faults.retryAfterSec * 1000;
+    return 429;
+  }
+  if (chance(_faults.serverErrorRate)) {
+    _faultsInjected++;
+    return 503;
+  }
+
+  body = r.body;
+  if (r.status == 200 && chance(_faults.malformedRate)) {
+    _faultsInjected++;
+    body.resize(body.size() / 2);
+  }
+  if (r.status == 429) {
+    _lastRetryAfterMs = r.retryAfterSec * 1000;
+  }
+  return r.status;
+}
@@ -0,0 +1,79 @@
+#ifndef REPLAY_TRANSPORT_H
+#define REPLAY_TRANSPORT_H
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "HttpTransport.h"
+
+// Serves a session captured on the device by ApiRecorder (see
+// include/ApiRecorder.h for the file format), with faults layered on top.
+//
+// Each path replays its recorded GET replies in order, wrapping around, so a
+// few minutes of recording cover hours of simulated listening. Nothing
+// sleeps: the latency a reply would have taken is reported through
+// lastLatencyMs() and the caller advances its own clock.
+class ReplayTransport : public HttpTransport {
+public:
+  struct Faults {
+    double latencyScale = 1.0; // applied to the recorded latency
+    uint32_t jitterMs = 0;     // +- uniformly on top
+    // Probability per request of each fault
+    double slowRate = 0;        // fresh TLS handshake: slowMs extra
+    double rateLimitRate = 0;   // 429 with Retry-After: retryAfterSec
+    double serverErrorRate = 0; // 503
+    double timeoutRate = 0;     // no reply within timeoutMs (status -11)
+    double malformedRate = 0;   // 200 with the body cut in half
+    uint32_t slowMs = 1500;
+    uint32_t retryAfterSec = 5;
+    uint32_t timeoutMs = 5000; // HTTPClient's default read timeout
+    uint32_t seed = 1;
+  };
+
+  ReplayTransport();
+
+  // Reads a recording; false if it is missing or malformed.
+  bool load(const char *file);
+  void setFaults(const Faults &faults);
+
+  int get(const char *path, std::string &body) override;
+
+  // Of the last get()
+  uint32_t lastLatencyMs() const { return _lastLatencyMs; }
+  uint32_t lastRetryAfterMs() const { return _lastRetryAfterMs; }
+
+  size_t recordCount() const { return _recordCount; }
+  // GET replies left out because the recorder cut their body
+  size_t cutCount() const { return _cutCount; }
+  uint32_t recordedSpanMs() const { return _spanMs; }
+  uint32_t faultsInjected() const { return _faultsInjected; }
+
+private:
+  struct Reply {
+    int status;
+    uint32_t latencyMs;
+    uint32_t retryAfterSec;
+    std::string body;
+  };
+  struct Replies {
+    std::vector<Reply> list;
+    size_t next = 0;
+  };
+
+  std::map<std::string, Replies> _paths;
+  Faults _faults;
+  std::mt19937 _rng;
+  size_t _recordCount;
+  size_t _cutCount;
+  uint32_t _spanMs;
+  uint32_t _lastLatencyMs;
+  uint32_t _lastRetryAfterMs;
+  uint32_t _faultsInjected;
+
+  bool chance(double p);
+  uint32_t latency(uint32_t recordedMs);
+};
+
+#endif
@@ -0,0 +1,505 @@
+// Host benchmark: replays recorded Spotify replies through the device's
+// parsing, poll scheduling and text layout code and reports, per poll cycle,
+// parse time, layout time, pixels drawn and heap allocations. Then builds a
+// LibraryIndex over a synthetic 10k-track library and reports its size,
+// build time and type-ahead latency.
+//
+// Exits 1 on a parse error, if a poll allocates once every reply in the
+// script has been seen (the device's steady state must not touch the heap),
+// or if a search misses a track it must find (kana and accent folding).
+//
+//   pio run -e native -t exec
+//   .pio/build/native/program [fixture-dir] [cycles]
+
+#include <ArduinoJson.h>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "ArenaAllocator.h"
+#include "Framebuffer.h"
+#include "LibraryIndex.h"
+#include "MockSpotify.h"
+#include "NowPlaying.h"
+#include "PollScheduler.h"
+#include "SpotifyJson.h"
+#include "TextLayout.h"
+
+// Every heap allocation in the process; JSON arena overflows are added in
+// Bench::poll()
+static uint32_t g_allocs = 0;
+static uint32_t g_allocBytes = 0;
+
+void *operator new(size_t n) {
+  g_allocs++;
+  g_allocBytes += n;
+  void *p = malloc(n > 0 ? n : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// The fixtures are currently-playing replies, i.e. /me/player without the
+// device
+static const char *NOW_PLAYING = "/me/player";
+static const char *QUEUE = "/me/player/queue";
+
+static const MockSpotify::Step SCRIPT[] = {
+    {NOW_PLAYING, 200, "currently_playing_jp.json"},
+    {NOW_PLAYING, 200, "currently_playing_jp.json"},
+    {NOW_PLAYING, 200, "currently_playing_jp_long.json"},
+    {NOW_PLAYING, 200, "currently_playing_latin.json"},
+    {NOW_PLAYING, 200, "currently_playing_paused.json"},
+    {NOW_PLAYING, 204, nullptr},
+    {NOW_PLAYING, 200, "currently_playing_episode.json"},
+    {NOW_PLAYING, 429, nullptr},
+    {QUEUE, 200, "queue.json"},
+};
+static const int SCRIPT_POLLS = 8; // NOW_PLAYING steps in SCRIPT
+static const uint32_t RETRY_AFTER_MS = 5000;
+static const size_t JSON_ARENA_BYTES = 12 * 1024; // as in SpotifyClient
+
+// Screen geometry, as in DisplayManager
+static const int SCREEN_W = 320;
+static const int SCREEN_H = 240;
+static const int TEXT_LEFT = 180;
+static const int TEXT_X = TEXT_LEFT + 6;
+static const int TEXT_MAX_WIDTH = 135;
+static const int BAR_Y = 186;
+static const int BAR_H = 4;
+static const int FRAME_MS = 33;
+static const uint16_t GREEN = 0x1DCA;
+static const uint16_t GREY = 0x7BEF;
+
+typedef std::chrono::steady_clock Clock;
+
+static unsigned long elapsedUs(Clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                               since)
+      .count();
+}
+
+static int measureGlyph(void *ctx, const char *utf8) {
+  return static_cast<Framebuffer *>(ctx)->textWidth(utf8);
+}
+
+struct Cycle {
+  int status;
+  unsigned long parseUs;
+  unsigned long layoutUs;
+  uint32_t pixels;
+  uint32_t allocs;
+  uint32_t allocBytes;
+};
+
+class Bench {
+public:
+  Bench(MockSpotify &api)
+      : _fb(SCREEN_W, SCREEN_H), _jsonArena(_jsonArenaBuf, JSON_ARENA_BYTES) {
+    _api = &api;
+    _drawnFillW = -1;
+    _progress = 0;
+    _duration = 0;
+    _isPlaying = false;
+    _volume = -1;
+    _parseErrors = 0;
+    buildNowPlayingFilter(_nowPlayingFilter);
+    buildQueueFilter(_queueFilter);
+    _titleWidths.begin(measureGlyph, &_fb);
+    _artistWidths.begin(measureGlyph, &_fb);
+  }
+
+  Cycle poll();
+  uint32_t parseErrors() const { return _parseErrors; }
+  size_t arenaHighWater() const { return _jsonArena.highWater(); }
+
+private:
+  MockSpotify *_api;
+  SoftFramebuffer565 _fb;
+  alignas(8) uint8_t _jsonArenaBuf[JSON_ARENA_BYTES];
+  ArenaAllocator _jsonArena;
+  JsonDocument _nowPlayingFilter;
+  JsonDocument _queueFilter;
+  PollScheduler _scheduler;
+  GlyphWidthCache _titleWidths;
+  GlyphWidthCache _artistWidths;
+  TextLayout _layout;
+  std::string _body;
+  std::string _queueBody;
+
+  TrackInfo _track;
+  TrackInfo _next;
+  FixedString<TrackInfo::ID_SIZE> _lastTrackId;
+  int _drawnFillW;
+  int _progress;
+  int _duration;
+  bool _isPlaying;
+  int _volume;
+  uint32_t _parseErrors;
+
+  void drawText(const TrackInfo &track);
+  int drawLines(const char *text, int y);
+  void updateProgress(int progress, int duration);
+};
+
+Cycle Bench::poll() {
+  Cycle c = {};
+  c.status = _api->get(NOW_PLAYING, _body);
+  // Count from here: the mock's copy of the body stands in for the socket
+  uint32_t allocs0 = g_allocs;
+  uint32_t bytes0 = g_allocBytes;
+  uint32_t fallbacks0 = _jsonArena.fallbacks();
+
+  Clock::time_point t0 = Clock::now();
+  bool haveTrack = false;
+  {
+    JsonDocument doc(&_jsonArena);
+    if (c.status == 200) {
+      if (deserializeJson(doc, _body,
+                          DeserializationOption::Filter(_nowPlayingFilter))) {
+        _parseErrors++;
+      } else {
+        haveTrack = isTrack(doc["item"]);
+        if (haveTrack) {
+          readTrack(doc["item"], _track);
+        }
+        _isPlaying = doc["is_playing"];
+        _progress = doc["progress_ms"];
+        _volume = readVolume(doc["device"]);
+      }
+    } else {
+      _isPlaying = false;
+    }
+  }
+  bool trackChanged = haveTrack && _track.id != _lastTrackId;
+  c.parseUs = elapsedUs(t0);
+
+  // A new track also refreshes the queue (NetworkTask::refreshQueue()); the
+  // mock's own allocations are not counted, as above
+  int queueStatus = 0;
+  if (trackChanged) {
+    uint32_t mockAllocs = g_allocs;
+    uint32_t mockBytes = g_allocBytes;
+    queueStatus = _api->get(QUEUE, _queueBody);
+    allocs0 += g_allocs - mockAllocs;
+    bytes0 += g_allocBytes - mockBytes;
+  }
+  if (queueStatus == 200) {
+    t0 = Clock::now();
+    JsonDocument queue(&_jsonArena);
+    if (deserializeJson(queue, _queueBody,
+                        DeserializationOption::Filter(_queueFilter))) {
+      _parseErrors++;
+    } else if (isTrack(queue["queue"][0])) {
+      readTrack(queue["queue"][0], _next);
+    }
+    c.parseUs += elapsedUs(t0);
+  }
+
+  uint32_t delayMs = _scheduler.onPoll(
+      c.status, _isPlaying, _progress, haveTrack ? _track.durationMs : 0,
+      c.status == 429 ? RETRY_AFTER_MS : 0);
+
+  if (trackChanged) {
+    t0 = Clock::now();
+    drawText(_track);
+    c.layoutUs = elapsedUs(t0);
+    _lastTrackId = _track.id;
+  }
+  if (haveTrack) {
+    _duration = _track.durationMs;
+  }
+
+  // The UI frames until the next poll, extrapolating progress while playing
+  // (main.cpp tickFrame())
+  for (uint32_t t = 0; t < delayMs; t += FRAME_MS) {
+    int progress = _progress + (_isPlaying ? (int)t : 0);
+    updateProgress(progress, _duration);
+  }
+
+  c.pixels = _fb.takePixelsWritten();
+  c.allocs = g_allocs - allocs0 + (_jsonArena.fallbacks() - fallbacks0);
+  c.allocBytes = g_allocBytes - bytes0;
+  return c;
+}
+
+// Mirrors DisplayManager::drawTextInfo()
+void Bench::drawText(const TrackInfo &track) {
+  _fb.fillRect(TEXT_LEFT, 0, SCREEN_W - TEXT_LEFT, 180, 0);
+
+  _fb.setFontSize(20);
+  const char *title = track.title.c_str();
+  int lines = _layout.layout(title, _titleWidths, TEXT_MAX_WIDTH, 2);
+  int y = 64 - 12 * (lines > 1 ? lines - 1 : 0);
+  y = drawLines(title, y);
+
+  y += 8;
+  _fb.setFontSize(16);
+  const char *artist = track.artist.c_str();
+  _layout.layout(artist, _artistWidths, TEXT_MAX_WIDTH, 2);
+  drawLines(artist, y);
+}
+
+int Bench::drawLines(const char *text, int y) {
+  char buf[TextLayout::LINE_BYTES];
+  for (int i = 0; i < _layout.lineCount(); i++) {
+    _layout.copyLine(text, i, buf);
+    _fb.drawString(buf, TEXT_X, y, 0xFFFF);
+    y += _fb.fontHeight();
+  }
+  return y;
+}
+
+// Mirrors DisplayManager::updateProgress()
+void Bench::updateProgress(int progress, int duration) {
+  int fillW = 0;
+  if (duration > 0 && progress > 0) {
+    fillW = progress >= duration
+                ? SCREEN_W
+                : (int)((int64_t)SCREEN_W * progress / duration);
+  }
+
+  if (_drawnFillW < 0) {
+    _fb.fillRect(0, BAR_Y, SCREEN_W, BAR_H, GREY);
+    _fb.fillRect(0, BAR_Y, fillW, BAR_H, GREEN);
+  } else if (fillW > _drawnFillW) {
+    _fb.fillRect(_drawnFillW, BAR_Y, fillW - _drawnFillW, BAR_H, GREEN);
+  } else if (fillW < _drawnFillW) {
+    _fb.fillRect(fillW, BAR_Y, _drawnFillW - fillW, BAR_H, GREY);
+  }
+  _drawnFillW = fillW;
+}
+
+// Synthetic library: about 60% Latin titles from a small vocabulary (many
+// shared words, the slow case for a search), the rest kana and kanji.
+static uint32_t g_seed = 1;
+
+static uint32_t nextRandom() {
+  g_seed = g_seed * 1664525u + 1013904223u;
+  return g_seed >> 8;
+}
+
+static void appendUtf8(std::string &s, uint32_t cp) {
+  if (cp < 0x80) {
+    s += (char)cp;
+  } else if (cp < 0x800) {
+    s += (char)(0xC0 | cp >> 6);
+    s += (char)(0x80 | (cp & 0x3F));
+  } else {
+    s += (char)(0xE0 | cp >> 12);
+    s += (char)(0x80 | ((cp >> 6) & 0x3F));
+    s += (char)(0x80 | (cp & 0x3F));
+  }
+}
+
+static std::string syntheticTitle() {
+  static const char *WORDS[] = {
+      "love",  "night",  "blue",    "dream", "heart", "summer", "rain",
+      "light", "song",   "world",   "time",  "fire",  "moon",   "star",
+      "city",  "road",   "home",    "girl",  "boy",   "dance",  "forever",
+      "baby",  "sky",    "ocean",   "river", "gold",  "wild",   "free",
+      "run",   "shadow"};
+  std::string s;
+  if (nextRandom() % 10 < 6) {
+    int words = 1 + nextRandom() % 4;
+    for (int i = 0; i < words; i++) {
+      std::string w = WORDS[nextRandom() % (sizeof(WORDS) / sizeof(*WORDS))];
+      if (i == 0) {
+        w[0] -= 'a' - 'A';
+      } else {
+        s += ' ';
+      }
+      s += w;
+    }
+    return s;
+  }
+  int chars = 3 + nextRandom() % 9;
+  for (int i = 0; i < chars; i++) {
+    switch (nextRandom() % 3) {
+    case 0:
+      appendUtf8(s, 0x3042 + nextRandom() % 80); // hiragana
+      break;
+    case 1:
+      appendUtf8(s, 0x30A2 + nextRandom() % 80); // katakana
+      break;
+    default:
+      appendUtf8(s, 0x4E00 + nextRandom() % 2000); // kanji
+      break;
+    }
+  }
+  return s;
+}
+
+// Returns false if a query misses the entry it must find.
+static bool benchLibrary(int tracks) {
+  std::vector<std::string> artists;
+  for (int i = 0; i < 800; i++) {
+    artists.push_back(syntheticTitle());
+  }
+  std::vector<uint8_t> records((tracks + 8) * LibraryIndex::RECORD_MAX);
+  size_t bytes = 0;
+  bytes += LibraryIndex::encode(&records[bytes], LibraryIndex::Playlist,
+                                "37i9dQZF1DXcBWIGoYBM5M", "Café Jazz", "me");
+  // Entries 1 and 2: what the folding checks below must find
+  bytes += LibraryIndex::encode(&records[bytes], LibraryIndex::Track,
+                                "4uLU6hMCjMI75M1A2tKUQC", "ﾛﾋﾞﾝｿﾝ", "ｽﾋﾟｯﾂ");
+  bytes += LibraryIndex::encode(&records[bytes], LibraryIndex::Track,
+                                "7hQJA50XrCWABAu5v6QZ4i", "Don't Stop Me Now",
+                                "Queen");
+  std::vector<std::string> titles;
+  for (int i = 0; i < tracks; i++) {
+    titles.push_back(syntheticTitle());
+    bytes += LibraryIndex::encode(
+        &records[bytes], LibraryIndex::Track, "0000000000000000000000",
+        titles.back().c_str(), artists[nextRandom() % artists.size()].c_str());
+  }
+
+  std::vector<uint8_t> scratch(LibraryIndex::SCRATCH_BYTES);
+  LibraryIndex::Header header;
+  Clock::time_point t0 = Clock::now();
+  size_t tableBytes =
+      LibraryIndex::tableBytes(records.data(), bytes, header, scratch.data());
+  std::vector<uint8_t> tables(tableBytes);
+  LibraryIndex::buildTables(records.data(), header, tables.data(),
+                            scratch.data());
+  unsigned long buildUs = elapsedUs(t0);
+  LibraryIndex index;
+  index.attach(header, records.data(), tables.data());
+  printf("[bench] library: %u entries, records %zu KB + tables %zu KB, "
+         "built in %lu us\n",
+         header.entries, bytes / 1024, tableBytes / 1024, buildUs);
+
+  struct Check {
+    const char *query;
+    int entry;
+  };
+  static const Check CHECKS[] = {
+      {"cafe", 0},       {"CAFÉ", 0},     {"ｶﾌｪ", -1},  {"すぴっつ", 1},
+      {"スピッツ", 1},   {"ろびんそん", 1}, {"robinson", -1}, {"dont", 2},
+      {"don't stop", 2}, {"ＱＵＥＥＮ", 2}, {"que", 2},
+  };
+  bool ok = true;
+  for (const Check &c : CHECKS) {
+    uint16_t results[8];
+    int n = index.search(c.query, results, 8);
+    bool found = false;
+    for (int i = 0; i < n; i++) {
+      found = found || results[i] == c.entry;
+    }
+    // entry -1: must not match the fixed entries
+    bool pass = c.entry >= 0 ? found : n == 0 || results[0] > 2;
+    if (!pass) {
+      printf("[bench] library: \"%s\" %s\n", c.query,
+             c.entry >= 0 ? "missed its entry" : "matched wrongly");
+      ok = false;
+    }
+  }
+
+  // Type-ahead: every prefix of random titles, as typed
+  unsigned long totalNs = 0, maxNs = 0;
+  uint64_t checked = 0;
+  int queries = 0;
+  for (int i = 0; i < 500; i++) {
+    const std::string &title = titles[nextRandom() % titles.size()];
+    for (size_t cut = 1; cut <= title.size(); cut++) {
+      if (cut < title.size() && ((uint8_t)title[cut] & 0xC0) == 0x80) {
+        continue; // mid-character
+      }
+      std::string query = title.substr(0, cut);
+      uint16_t results[60];
+      uint32_t n;
+      Clock::time_point start = Clock::now();
+      index.search(query.c_str(), results, 60, &n);
+      unsigned long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             Clock::now() - start)
+                             .count();
+      totalNs += ns;
+      if (ns > maxNs) {
+        maxNs = ns;
+      }
+      checked += n;
+      queries++;
+    }
+  }
+  printf("[bench] library: %d type-ahead queries, avg %.1f us (max %.1f), "
+         "%.1f entries checked per query\n",
+         queries, totalNs / 1000.0 / queries, maxNs / 1000.0,
+         (double)checked / queries);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  const char *dir = argc > 1 ? argv[1] : "src/native/fixtures";
+  int cycles = argc > 2 ? atoi(argv[2]) : 800;
+
+  MockSpotify api(dir);
+  if (!api.load(SCRIPT, sizeof(SCRIPT) / sizeof(SCRIPT[0]))) {
+    return 2;
+  }
+  Bench bench(api);
+
+  unsigned long parseTotal = 0, parseMax = 0;
+  unsigned long layoutTotal = 0, layoutMax = 0;
+  uint64_t pixelsTotal = 0, allocsTotal = 0, bytesTotal = 0;
+  uint32_t allocsMax = 0;
+  uint32_t steadyAllocs = 0; // after the first pass through the script
+
+  for (int i = 0; i < cycles; i++) {
+    Cycle c = bench.poll();
+    if (i < SCRIPT_POLLS) {
+      // First pass through the script: cold caches, one line per reply
+      printf("[bench] poll %d: status %d, parse %lu us, layout %lu us, "
+             "%u px, %u allocs (%u B)\n",
+             i, c.status, c.parseUs, c.layoutUs, c.pixels, c.allocs,
+             c.allocBytes);
+    }
+    parseTotal += c.parseUs;
+    layoutTotal += c.layoutUs;
+    pixelsTotal += c.pixels;
+    allocsTotal += c.allocs;
+    bytesTotal += c.allocBytes;
+    if (c.parseUs > parseMax) {
+      parseMax = c.parseUs;
+    }
+    if (c.layoutUs > layoutMax) {
+      layoutMax = c.layoutUs;
+    }
+    if (c.allocs > allocsMax) {
+      allocsMax = c.allocs;
+    }
+    if (i >= SCRIPT_POLLS) {
+      steadyAllocs += c.allocs;
+    }
+  }
+
+  if (cycles > 0) {
+    printf("[bench] %d polls: parse avg %lu us (max %lu), layout avg %lu us "
+           "(max %lu), %llu px/poll, %llu allocs/poll (max %u, %llu B/poll)\n",
+           cycles, parseTotal / cycles, parseMax, layoutTotal / cycles,
+           layoutMax, (unsigned long long)(pixelsTotal / cycles),
+           (unsigned long long)(allocsTotal / cycles), allocsMax,
+           (unsigned long long)(bytesTotal / cycles));
+    printf("[bench] JSON arena peak %zu of %zu B\n", bench.arenaHighWater(),
+           JSON_ARENA_BYTES);
+  }
+  if (bench.parseErrors() > 0) {
+    printf("[bench] %u parse errors\n", bench.parseErrors());
+    return 1;
+  }
+  if (steadyAllocs > 0) {
+    printf("[bench] %u allocations after warm-up, expected none\n",
+           steadyAllocs);
+    return 1;
+  }
+  if (!benchLibrary(10000)) {
+    return 1;
+  }
+  return 0;
+}
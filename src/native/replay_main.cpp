@@ -0,0 +1,386 @@
+// Host simulation: replays a session recorded on the device (ApiRecorder)
+// through the device's parsing and poll scheduling on a virtual clock, with
+// optional latency and faults on top, and reports what the device would have
+// done: API calls, redraws and the worst stalls.
+//
+// Mirrors NetworkTask (poll, queue refresh on a track change, Retry-After)
+// and the UI's progress frames; like lookups and commands are not replayed.
+//
+//   pio run -e replay -t exec
+//   .pio/build/replay/program [recording] [options]
+//     --hours H           simulated listening time (default 8)
+//     --speed X           X simulated seconds per real second (default 0:
+//                         as fast as possible)
+//     --latency-scale S   --jitter MS   --seed N
+//     --slow P  --429 P  --5xx P  --timeout P  --malformed P
+//                         fault probability per request
+
+#include <ArduinoJson.h>
+#include <chrono>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+
+#include "ArenaAllocator.h"
+#include "NowPlaying.h"
+#include "PollScheduler.h"
+#include "ReplayTransport.h"
+#include "SpotifyJson.h"
+
+static const char *NOW_PLAYING = "/me/player";
+static const char *QUEUE = "/me/player/queue";
+static const int STATUS_PARSE_ERROR = -100; // as in SpotifyClient
+static const size_t JSON_ARENA_BYTES = 12 * 1024;
+static const uint32_t FRAME_MS = 33; // main.cpp PROGRESS_FRAME_MS
+static const int BAR_W = 320;
+static const uint64_t HOUR_MS = 3600 * 1000ULL;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Stats {
+  std::map<std::string, uint32_t> calls; // per path
+  std::map<int, uint32_t> statuses;      // now-playing polls
+  uint32_t refusedLocally = 0;           // during Retry-After
+  uint32_t parseErrors = 0;
+  uint32_t textRedraws = 0;    // track changes drawn
+  uint32_t controlRedraws = 0; // play/pause icon changes
+  uint32_t barRepaints = 0;    // frames whose progress fill moved
+  uint32_t maxLatencyMs = 0;   // longest single request
+  uint64_t maxStaleMs = 0;     // longest gap between successful polls
+  uint64_t rateLimitedMs = 0;
+  unsigned long parseUsTotal = 0;
+  unsigned long parseUsMax = 0;
+  uint32_t parses = 0;
+  uint32_t parsesSkipped = 0; // reply digested like the last one parsed
+  unsigned long digestUsTotal = 0;
+};
+
+class Simulator {
+public:
+  Simulator(ReplayTransport &api) : _jsonArena(_jsonArenaBuf, JSON_ARENA_BYTES) {
+    _api = &api;
+    _now = 0;
+    _fetchedAt = 0;
+    _freshAt = 0;
+    _rateLimitedUntil = 0;
+    _isPlaying = false;
+    _drawnPlaying = -1;
+    _progress = 0;
+    _volume = -1;
+    _drawnFillW = -1;
+    _queueCheckNeeded = false;
+    buildNowPlayingFilter(_nowPlayingFilter);
+    buildQueueFilter(_queueFilter);
+  }
+
+  // One network task cycle plus the UI frames until the next one. Returns
+  // the simulated ms it took.
+  uint64_t step();
+
+  uint64_t now() const { return _now; }
+  const Stats &stats() const { return _stats; }
+
+private:
+  ReplayTransport *_api;
+  alignas(8) uint8_t _jsonArenaBuf[JSON_ARENA_BYTES];
+  ArenaAllocator _jsonArena;
+  JsonDocument _nowPlayingFilter;
+  JsonDocument _queueFilter;
+  PollScheduler _scheduler;
+  std::string _body;
+  Stats _stats;
+
+  uint64_t _now;       // virtual ms
+  uint64_t _fetchedAt; // of the progress value
+  uint64_t _freshAt;   // last successful poll
+  uint64_t _rateLimitedUntil;
+  TrackInfo _track;
+  TrackInfo _next;
+  FixedString<TrackInfo::ID_SIZE> _lastTrackId;
+  bool _isPlaying;
+  int8_t _drawnPlaying;
+  int _progress;
+  int _volume;
+  int _drawnFillW;
+  bool _queueCheckNeeded;
+  PlayerDigest _digest;
+
+  int request(const char *path);
+  int pollNowPlaying();
+  void refreshQueue();
+  void frames(uint64_t until);
+};
+
+// SpotifyClient::apiRequest(): refused locally while rate limited
+int Simulator::request(const char *path) {
+  if (_now < _rateLimitedUntil) {
+    _stats.refusedLocally++;
+    return 429;
+  }
+  int status = _api->get(path, _body);
+  uint32_t latency = _api->lastLatencyMs();
+  _now += latency;
+  _stats.calls[path]++;
+  if (latency > _stats.maxLatencyMs) {
+    _stats.maxLatencyMs = latency;
+  }
+  if (status == 429) {
+    uint32_t retryAfter = _api->lastRetryAfterMs();
+    _rateLimitedUntil = _now + (retryAfter < 1000 ? 1000 : retryAfter);
+  }
+  return status;
+}
+
+// SpotifyClient::getNowPlaying() + NetworkTask::refreshNowPlaying()
+int Simulator::pollNowPlaying() {
+  int status = request(NOW_PLAYING);
+  _stats.statuses[status]++;
+  if (status != 200) {
+    return status;
+  }
+
+  // Only the position moved: the last parse still holds
+  Clock::time_point t0 = Clock::now();
+  _digest.reset();
+  _digest.update(_body.data(), _body.size());
+  _stats.digestUsTotal += std::chrono::duration_cast<
+                              std::chrono::microseconds>(Clock::now() - t0)
+                              .count();
+  if (_digest.unchanged()) {
+    _progress = _digest.progressMs();
+    _fetchedAt = _now;
+    _stats.parsesSkipped++;
+    return status;
+  }
+
+  t0 = Clock::now();
+  JsonDocument doc(&_jsonArena);
+  if (deserializeJson(doc, _body,
+                      DeserializationOption::Filter(_nowPlayingFilter))) {
+    _digest.parsed(false);
+    _stats.parseErrors++;
+    return STATUS_PARSE_ERROR;
+  }
+  if (doc["item"].is<JsonObject>()) {
+    readTrack(doc["item"], _track);
+  }
+  _isPlaying = doc["is_playing"];
+  _progress = doc["progress_ms"];
+  _volume = readVolume(doc["device"]);
+  _fetchedAt = _now;
+  _digest.parsed(true);
+  unsigned long us = std::chrono::duration_cast<std::chrono::microseconds>(
+                         Clock::now() - t0)
+                         .count();
+  _stats.parses++;
+  _stats.parseUsTotal += us;
+  if (us > _stats.parseUsMax) {
+    _stats.parseUsMax = us;
+  }
+
+  if (_lastTrackId != _track.id) {
+    _lastTrackId = _track.id;
+    _queueCheckNeeded = true;
+    _next.clear();
+    _stats.textRedraws++;
+  }
+  if ((int8_t)_isPlaying != _drawnPlaying) {
+    _drawnPlaying = _isPlaying;
+    _stats.controlRedraws++;
+  }
+  return status;
+}
+
+void Simulator::refreshQueue() {
+  int status = request(QUEUE);
+  if (status != 200 && status != 204) {
+    return; // retried on the next poll
+  }
+  _queueCheckNeeded = false;
+  if (status == 204) {
+    return;
+  }
+  JsonDocument queue(&_jsonArena);
+  if (deserializeJson(queue, _body,
+                      DeserializationOption::Filter(_queueFilter))) {
+    _stats.parseErrors++;
+  } else if (isTrack(queue["queue"][0])) {
+    readTrack(queue["queue"][0], _next);
+  }
+}
+
+// main.cpp tickFrame() -> DisplayManager::updateProgress()
+void Simulator::frames(uint64_t until) {
+  for (; _now < until; _now += FRAME_MS) {
+    int duration = _track.durationMs;
+    long progress = _progress;
+    if (_isPlaying) {
+      progress += (long)(_now - _fetchedAt);
+    }
+    int fillW = 0;
+    if (duration > 0 && progress > 0) {
+      fillW = progress >= duration ? BAR_W
+                                   : (int)((int64_t)BAR_W * progress / duration);
+    }
+    if (fillW != _drawnFillW) {
+      _drawnFillW = fillW;
+      _stats.barRepaints++;
+    }
+  }
+}
+
+uint64_t Simulator::step() {
+  uint64_t start = _now;
+  int status = pollNowPlaying();
+  if (status == 200 || status == 204) {
+    uint64_t stale = _now - _freshAt;
+    if (stale > _stats.maxStaleMs) {
+      _stats.maxStaleMs = stale;
+    }
+    _freshAt = _now;
+  }
+  if (status == 200 && _queueCheckNeeded) {
+    refreshQueue();
+  }
+
+  uint32_t retryAfter =
+      _now < _rateLimitedUntil ? (uint32_t)(_rateLimitedUntil - _now) : 0;
+  if (retryAfter > 0) {
+    _stats.rateLimitedMs += retryAfter;
+  }
+  uint32_t delayMs = _scheduler.onPoll(status, _isPlaying, _progress,
+                                       _track.durationMs, retryAfter);
+  frames(_now + delayMs);
+  return _now - start;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: program [recording] [--hours H] [--speed X] "
+          "[--latency-scale S] [--jitter MS] [--seed N] [--slow P] "
+          "[--429 P] [--5xx P] [--timeout P] [--malformed P]\n");
+}
+
+int main(int argc, char **argv) {
+  const char *file = "src/native/fixtures/session.rec";
+  double hours = 8;
+  double speed = 0;
+  ReplayTransport::Faults faults;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (arg[0] != '-') {
+      file = arg;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      usage();
+      return 2;
+    }
+    double v = atof(argv[++i]);
+    if (strcmp(arg, "--hours") == 0) {
+      hours = v;
+    } else if (strcmp(arg, "--speed") == 0) {
+      speed = v;
+    } else if (strcmp(arg, "--latency-scale") == 0) {
+      faults.latencyScale = v;
+    } else if (strcmp(arg, "--jitter") == 0) {
+      faults.jitterMs = (uint32_t)v;
+    } else if (strcmp(arg, "--seed") == 0) {
+      faults.seed = (uint32_t)v;
+    } else if (strcmp(arg, "--slow") == 0) {
+      faults.slowRate = v;
+    } else if (strcmp(arg, "--429") == 0) {
+      faults.rateLimitRate = v;
+    } else if (strcmp(arg, "--5xx") == 0) {
+      faults.serverErrorRate = v;
+    } else if (strcmp(arg, "--timeout") == 0) {
+      faults.timeoutRate = v;
+    } else if (strcmp(arg, "--malformed") == 0) {
+      faults.malformedRate = v;
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  ReplayTransport api;
+  if (!api.load(file)) {
+    return 2;
+  }
+  api.setFaults(faults);
+  printf("[replay] %s: %zu requests over %.1f s, simulating %.1f h\n", file,
+         api.recordCount(), api.recordedSpanMs() / 1000.0, hours);
+  if (api.cutCount() > 0) {
+    printf("[replay] %zu replies left out: body cut by the recorder\n",
+           api.cutCount());
+  }
+
+  Simulator sim(api);
+  uint64_t end = (uint64_t)(hours * HOUR_MS);
+  uint64_t nextReport = HOUR_MS;
+  Clock::time_point realStart = Clock::now();
+  while (sim.now() < end) {
+    uint64_t ms = sim.step();
+    if (speed > 0) {
+      std::this_thread::sleep_for(
+          std::chrono::microseconds((uint64_t)(ms * 1000 / speed)));
+    }
+    if (sim.now() >= nextReport) {
+      uint32_t calls = 0;
+      for (const auto &c : sim.stats().calls) {
+        calls += c.second;
+      }
+      printf("[replay] %llu h: %u API calls\n",
+             (unsigned long long)(nextReport / HOUR_MS), calls);
+      nextReport += HOUR_MS;
+    }
+  }
+  unsigned long realMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             Clock::now() - realStart)
+                             .count();
+
+  const Stats &s = sim.stats();
+  double simHours = sim.now() / (double)HOUR_MS;
+  uint32_t calls = 0;
+  for (const auto &c : s.calls) {
+    calls += c.second;
+    printf("[replay] %-20s %u calls (%.0f/h)\n", c.first.c_str(), c.second,
+           c.second / simHours);
+  }
+  printf("[replay] now-playing status:");
+  for (const auto &st : s.statuses) {
+    printf(" %d x%u", st.first, st.second);
+  }
+  printf(", %u refused locally (Retry-After)\n", s.refusedLocally);
+  printf("[replay] %u API calls (%.0f/h), %u faults injected, "
+         "%u parse errors, rate limited %.1f%% of the time\n",
+         calls, calls / simHours, api.faultsInjected(), s.parseErrors,
+         100.0 * s.rateLimitedMs / sim.now());
+  printf("[replay] redraws: %u text, %u controls, %u progress frames "
+         "(%.0f/h)\n",
+         s.textRedraws, s.controlRedraws, s.barRepaints,
+         s.barRepaints / simHours);
+  printf("[replay] worst request %u ms, worst staleness %.1f s, "
+         "parse avg %lu us (max %lu)\n",
+         s.maxLatencyMs, s.maxStaleMs / 1000.0,
+         s.parses ? s.parseUsTotal / s.parses : 0, s.parseUsMax);
+  uint32_t digested = s.parses + s.parsesSkipped;
+  unsigned long parseAvgUs = s.parses ? s.parseUsTotal / s.parses : 0;
+  printf("[replay] %u of %u replies unchanged, parse skipped (%.1f%%): "
+         "digest avg %lu us, ~%lu ms CPU saved\n",
+         s.parsesSkipped, digested,
+         digested ? 100.0 * s.parsesSkipped / digested : 0.0,
+         digested ? s.digestUsTotal / digested : 0,
+         s.parsesSkipped * parseAvgUs / 1000);
+  printf("[replay] %.1f h simulated in %.1f s\n", simHours, realMs / 1000.0);
+
+  // Parse errors are only expected when they were injected
+  if (s.parseErrors > 0 && faults.malformedRate == 0) {
+    return 1;
+  }
+  return 0;
+}